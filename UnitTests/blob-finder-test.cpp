@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Blobs of bit masks: run with ctest.
+#include "bit-mask.hpp"
+
+// Library's
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint32_t failures{0};
+
+void check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+void set(BitMask &mask, int x, int y)
+{
+    mask.data()[static_cast<size_t>(y) * mask.wordsPerRow() + static_cast<size_t>(x / 64)] |= 1ULL << (x % 64);
+}
+
+// Mask of width x rows.size() with a pixel set for every '#'.
+BitMask maskOf(int width, const std::vector<std::string> &rows)
+{
+    BitMask mask{width, static_cast<int>(rows.size())};
+    for (size_t y = 0; y < rows.size(); y++) {
+        for (size_t x = 0; x < rows[y].size(); x++) {
+            if ('#' == rows[y][x]) {
+                set(mask, static_cast<int>(x), static_cast<int>(y));
+            }
+        }
+    }
+    return mask;
+}
+
+bool sameBox(const Blob &blob, int x, int y, int width, int height)
+{
+    return (x == blob.box.x) && (y == blob.box.y) && (width == blob.box.width) && (height == blob.box.height);
+}
+
+void testDiagonals(BlobFinder &finder)
+{
+    BlobList blobs;
+    finder.find(maskOf(8, {"#.......",
+                           ".#......",
+                           "..#....."}), blobs);
+    check((1 == blobs.count) && (3 == blobs.blobs[0].area) && sameBox(blobs.blobs[0], 0, 0, 3, 3), "falling diagonal is one blob");
+
+    finder.find(maskOf(8, {"..#.....",
+                           ".#......",
+                           "#......."}), blobs);
+    check((1 == blobs.count) && (3 == blobs.blobs[0].area) && sameBox(blobs.blobs[0], 0, 0, 3, 3), "rising diagonal is one blob");
+
+    finder.find(maskOf(8, {"#.......",
+                           "..#.....",
+                           "....#..."}), blobs);
+    check(3 == blobs.count, "pixels a column apart are separate blobs");
+
+    // Diagonals across the words of a row.
+    BitMask wide{130, 3};
+    set(wide, 63, 0);
+    set(wide, 64, 1);
+    set(wide, 128, 0);
+    set(wide, 127, 1);
+    set(wide, 126, 2);
+    finder.find(wide, blobs);
+    check((2 == blobs.count) && sameBox(blobs.blobs[0], 63, 0, 2, 2) && sameBox(blobs.blobs[1], 126, 0, 3, 3), "diagonals across 64 bit words");
+
+    // A run up to the end of the words of a row 64 pixels wide.
+    BitMask full{64, 2};
+    full.data()[0] = ~0ULL;
+    set(full, 0, 1);
+    finder.find(full, blobs);
+    check((1 == blobs.count) && (65 == blobs.blobs[0].area) && sameBox(blobs.blobs[0], 0, 0, 64, 2), "run up to the end of the row");
+}
+
+void testMergingArms(BlobFinder &finder)
+{
+    // The arms of a U are separate blobs until the bottom row joins them.
+    BlobList blobs;
+    finder.find(maskOf(12, {"...#..#.....",
+                            "#.....#.....",
+                            "#.....#.....",
+                            "#.....#...#.",
+                            "#######....."}), blobs);
+    check(3 == blobs.count, "U: three blobs, got " + std::to_string(blobs.count));
+    // In the order of the first pixel: the dot, the U starting with its right arm, the dot on the right.
+    check((1 == blobs.blobs[0].area) && sameBox(blobs.blobs[0], 3, 0, 1, 1), "U: the dot left of its right arm comes first");
+    check((14 == blobs.blobs[1].area) && sameBox(blobs.blobs[1], 0, 0, 7, 5), "U: both arms joined");
+    check((1 == blobs.blobs[2].area) && sameBox(blobs.blobs[2], 10, 3, 1, 1), "U: dot next to it last");
+
+    // Three arms joined by diagonals and a bar that reaches the leftmost one only in the last row.
+    finder.find(maskOf(12, {"#...#...#...",
+                            "#...#...#...",
+                            "#....#.#....",
+                            "#.....#.....",
+                            ".######....."}), blobs);
+    check((1 == blobs.count) && (17 == blobs.blobs[0].area) && sameBox(blobs.blobs[0], 0, 0, 9, 5), "W: one blob");
+
+    // Centroid of a U that is symmetric about x = 3.
+    finder.find(maskOf(7, {"#.....#",
+                           "#.....#",
+                           "#######"}), blobs);
+    check((1 == blobs.count) && (std::fabs(blobs.blobs[0].cx - 3.0f) < 1e-5f), "U: centroid on the axis");
+    check(std::fabs(blobs.blobs[0].cy - 16.0f / 11.0f) < 1e-5f, "U: centroid weighted by the pixels of the rows");
+}
+
+void testCapacity(BlobFinder &finder)
+{
+    // Single pixels on every other column of every other row.
+    BitMask specks{40, 8};
+    uint32_t count{0};
+    for (int y = 0; y < 8; y += 2) {
+        for (int x = 0; x < 40; x += 2, count++) {
+            set(specks, x, y);
+        }
+    }
+    BlobList blobs;
+    finder.find(specks, blobs);
+    check((BlobList::CAPACITY == blobs.count) && (count - BlobList::CAPACITY == blobs.dropped) && (0 == blobs.small),
+          "full list: " + std::to_string(blobs.count) + " blobs, " + std::to_string(blobs.dropped) + " dropped");
+    // The first ones in the order of their first pixel are kept.
+    const Blob &last{blobs.blobs[BlobList::CAPACITY - 1]};
+    check(sameBox(last, 2 * static_cast<int>((BlobList::CAPACITY - 1) % 20), 2 * static_cast<int>((BlobList::CAPACITY - 1) / 20), 1, 1),
+          "full list: the first blobs are kept");
+}
+
+void testSmallBlobs(BlobFinder &finder)
+{
+    // Specks all over the mask and three cones below them.
+    BitMask mask{40, 20};
+    uint32_t specks{0};
+    for (int y = 0; y < 8; y += 2) {
+        for (int x = 0; x < 40; x += 2, specks++) {
+            set(mask, x, y);
+        }
+    }
+    for (int cone = 0; cone < 3; cone++) {
+        for (int y = 12; y < 16; y++) {
+            for (int x = 10 * cone; x < 10 * cone + 3; x++) {
+                set(mask, x, y);
+            }
+        }
+    }
+    BlobList blobs;
+    finder.find(mask, blobs, 4);
+    check((3 == blobs.count) && (specks == blobs.small) && (0 == blobs.dropped), "specks do not push the cones out of the list");
+    check(sameBox(blobs.blobs[2], 20, 12, 3, 4) && (12 == blobs.blobs[2].area), "cones are kept whole");
+
+    // Without a minimum area the specks fill the list.
+    finder.find(mask, blobs);
+    check((BlobList::CAPACITY == blobs.count) && (specks + 3 - BlobList::CAPACITY == blobs.dropped) && (0 == blobs.small), "specks fill the list");
+
+    // The bounding box counts, not the pixels: a diagonal of 3 pixels covers 9.
+    const BitMask diagonal{maskOf(8, {"#.......",
+                                      ".#......",
+                                      "..#....."})};
+    finder.find(diagonal, blobs, 8);
+    check((1 == blobs.count) && (0 == blobs.small), "box larger than the minimum area is kept");
+    finder.find(diagonal, blobs, 9);
+    check((0 == blobs.count) && (1 == blobs.small), "box of the minimum area is small");
+}
+
+} // namespace
+
+int32_t main()
+{
+    BlobFinder finder{130, 20};
+    testDiagonals(finder);
+    testMergingArms(finder);
+    testCapacity(finder);
+    testSmallBlobs(finder);
+    if (0 != failures) {
+        std::cerr << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}
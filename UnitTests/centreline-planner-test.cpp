@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Centrelines planned through cones placed on the ground: run with ctest.
+#include "centreline-planner.hpp"
+#include "cone-detection.hpp"
+#include "ground-projection.hpp"
+
+// Library's
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace {
+
+uint32_t failures{0};
+
+void check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+bool near(float value, float expected, float tolerance)
+{
+    return std::fabs(value - expected) <= tolerance;
+}
+
+// Wide-angle camera 0.3 m above the ground tilted 30 degrees down, mapping all of a 1280x960 frame:
+// all cones are in view and a pixel is about 1 cm on the ground up to 1.5 m ahead.
+const cv::Rect ROI{0, 0, 1280, 960};
+const float TRACK_WIDTH{0.4f};
+
+// Planner settings of the microservice.
+const float WHEELBASE{0.12f};
+const float LOOK_AHEAD{0.6f};
+const float PREVIEW{1.0f};
+const float MIN_GATE_WIDTH{0.2f};
+const float MAX_GATE_WIDTH{1.5f};
+
+// Adds a cone whose box touches the ground at the pixel closest to (x, y).
+void place(const GroundProjection &ground, float x, float y, ConeList &cones)
+{
+    float closest{1e9f};
+    cv::Point foot;
+    for (int32_t v = 0; v < ROI.height; v++) {
+        for (int32_t u = 0; u < ROI.width; u++) {
+            const GroundPoint &point{ground.at(u, v)};
+            const float squared{(point.x - x) * (point.x - x) + (point.y - y) * (point.y - y)};
+            if ((0.0f < point.distance) && (squared < closest)) {
+                closest = squared;
+                foot = cv::Point(u, v);
+            }
+        }
+    }
+    cones.boxes[cones.count++] = cv::Rect(foot.x - 4, foot.y - 9, 9, 10);
+}
+
+// Places gates across y = c1 x + c2 x^2 at x = 0.3, 0.5, ... with the blue cones on the left and the yellow ones on the right.
+void placeTrack(const GroundProjection &ground, float c1, float c2, uint32_t blueCount, uint32_t yellowCount, ConeList &blue, ConeList &yellow)
+{
+    blue.count = yellow.count = 0;
+    for (uint32_t i = 0; (i < blueCount) || (i < yellowCount); i++) {
+        const float x{0.3f + 0.2f * static_cast<float>(i)};
+        const float y{(c1 + c2 * x) * x};
+        // Half the track width along the normal of the centreline.
+        const float slope{c1 + 2.0f * c2 * x};
+        const float scale{TRACK_WIDTH / 2.0f / std::sqrt(1.0f + slope * slope)};
+        if (i < blueCount) {
+            place(ground, x - slope * scale, y + scale, blue);
+        }
+        if (i < yellowCount) {
+            place(ground, x + slope * scale, y - scale, yellow);
+        }
+    }
+}
+
+void testCurve(const GroundProjection &ground)
+{
+    ConeList blue, yellow;
+    placeTrack(ground, 0.1f, 0.3f, 6, 6, blue, yellow);
+    CentrelinePlanner planner{WHEELBASE, LOOK_AHEAD, PREVIEW, MIN_GATE_WIDTH, MAX_GATE_WIDTH, static_cast<float>(MAX_ANGLE)};
+    const PlannedPath &path{planner.plan(ground, blue, yellow)};
+    check(path.valid && (6 == path.gates), "curve: 6 gates");
+    check(near(path.c0, 0.0f, 0.01f) && near(path.c1, 0.1f, 0.03f) && near(path.c2, 0.3f, 0.03f),
+          "curve: fitted y = " + std::to_string(path.c0) + " + " + std::to_string(path.c1) + " x + " + std::to_string(path.c2) + " x^2");
+    check(near(path.aim.distance, 0.6f, 0.001f) && near(path.aim.y, (0.1f + 0.3f * path.aim.x) * path.aim.x, 0.01f), "curve: aim point on the centreline");
+    check(near(path.preview.distance, 1.0f, 0.001f), "curve: preview point");
+    check(0.0f < path.steeringAngle, "curve: steers to the left");
+    const float left{path.steeringAngle};
+
+    // The same curve mirrored.
+    placeTrack(ground, -0.1f, -0.3f, 6, 6, yellow, blue);
+    const PlannedPath &mirrored{planner.plan(ground, blue, yellow)};
+    check(near(mirrored.c2, -0.3f, 0.03f) && near(mirrored.steeringAngle, -left, 0.01f), "mirrored curve: steers to the right");
+}
+
+void testUnevenSides(const GroundProjection &ground)
+{
+    // Cones beyond the last yellow one have nobody to pair with.
+    ConeList blue, yellow;
+    placeTrack(ground, 0.1f, 0.3f, 6, 4, blue, yellow);
+    CentrelinePlanner planner{WHEELBASE, LOOK_AHEAD, PREVIEW, MIN_GATE_WIDTH, MAX_GATE_WIDTH, static_cast<float>(MAX_ANGLE)};
+    const PlannedPath &path{planner.plan(ground, blue, yellow)};
+    check(path.valid && (4 == path.gates), "more blue cones: 4 gates");
+    check(near(path.c2, 0.3f, 0.05f), "more blue cones: curve kept, c2 = " + std::to_string(path.c2));
+
+    placeTrack(ground, 0.1f, 0.3f, 3, 6, blue, yellow);
+    const PlannedPath &fewer{planner.plan(ground, blue, yellow)};
+    check(fewer.valid && (3 == fewer.gates), "more yellow cones: 3 gates");
+}
+
+void testOneColour(const GroundProjection &ground)
+{
+    ConeList blue, yellow, none;
+    placeTrack(ground, 0.0f, 0.0f, 4, 4, blue, yellow);
+
+    // Without a frame with gates the sides of the colours are unknown.
+    CentrelinePlanner fresh{WHEELBASE, LOOK_AHEAD, PREVIEW, MIN_GATE_WIDTH, MAX_GATE_WIDTH, static_cast<float>(MAX_ANGLE)};
+    const PlannedPath &unknown{fresh.plan(ground, blue, none)};
+    check(!unknown.valid && near(unknown.steeringAngle, 0.0f, 0.0f), "one colour without gates before: no path");
+
+    // Cones of one colour are shifted by half the track width of the last gates.
+    CentrelinePlanner planner{WHEELBASE, LOOK_AHEAD, PREVIEW, MIN_GATE_WIDTH, MAX_GATE_WIDTH, static_cast<float>(MAX_ANGLE)};
+    check(4 == planner.plan(ground, blue, yellow).gates, "one colour: gates first");
+    const PlannedPath &blueOnly{planner.plan(ground, blue, none)};
+    check(blueOnly.valid && (0 == blueOnly.gates), "blue only: path without gates");
+    check(near(blueOnly.c0, 0.0f, 0.01f) && near(blueOnly.c1, 0.0f, 0.02f) && near(blueOnly.steeringAngle, 0.0f, 0.01f),
+          "blue only: centreline between the cones, offset " + std::to_string(blueOnly.c0));
+    const PlannedPath &yellowOnly{planner.plan(ground, none, yellow)};
+    check(yellowOnly.valid && near(yellowOnly.c0, 0.0f, 0.01f) && near(yellowOnly.steeringAngle, 0.0f, 0.01f),
+          "yellow only: centreline between the cones, offset " + std::to_string(yellowOnly.c0));
+
+    // Yellow on the left after gates the other way round.
+    placeTrack(ground, 0.0f, 0.0f, 4, 4, yellow, blue);
+    planner.plan(ground, blue, yellow);
+    const PlannedPath &swapped{planner.plan(ground, none, yellow)};
+    check(swapped.valid && near(swapped.c0, 0.0f, 0.01f), "yellow on the left only: centreline between the cones");
+
+    const PlannedPath &nothing{planner.plan(ground, none, none)};
+    check(!nothing.valid && near(nothing.steeringAngle, 0.0f, 0.0f), "no cones: no path");
+}
+
+void testStraight(const GroundProjection &ground)
+{
+    ConeList blue, yellow;
+    placeTrack(ground, 0.0f, 0.0f, 6, 6, blue, yellow);
+    CentrelinePlanner planner{WHEELBASE, LOOK_AHEAD, PREVIEW, MIN_GATE_WIDTH, MAX_GATE_WIDTH, static_cast<float>(MAX_ANGLE)};
+    const PlannedPath &path{planner.plan(ground, blue, yellow)};
+    check(path.valid && (6 == path.gates), "straight: 6 gates");
+    check(near(path.c0, 0.0f, 0.005f) && near(path.c1, 0.0f, 0.01f) && near(path.c2, 0.0f, 0.01f), "straight: straight centreline");
+    check(near(path.aim.y, 0.0f, 0.005f) && near(path.steeringAngle, 0.0f, 0.005f), "straight: steering angle " + std::to_string(path.steeringAngle));
+
+    // Only two centres: a straight line through the vehicle and the gate.
+    placeTrack(ground, 0.0f, 0.0f, 1, 1, blue, yellow);
+    const PlannedPath &single{planner.plan(ground, blue, yellow)};
+    check(single.valid && (1 == single.gates) && near(single.c2, 0.0f, 0.0f) && near(single.steeringAngle, 0.0f, 0.005f), "single gate: straight ahead");
+}
+
+} // namespace
+
+int32_t main()
+{
+    const GroundProjection ground{intrinsicsFromFieldOfView(1280, 960, 90.0f), ROI, 0.3f, 30.0f};
+    testCurve(ground);
+    testUnevenSides(ground);
+    testOneColour(ground);
+    testStraight(ground);
+    if (0 != failures) {
+        std::cerr << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}
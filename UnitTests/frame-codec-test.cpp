@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Round trips through the LZ4 block codec of the recorder: run with ctest.
+#include "frame-codec.hpp"
+
+// Library's
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint32_t failures{0};
+
+void check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+{
+    std::mt19937 generator{seed};
+    std::vector<uint8_t> bytes(size);
+    for (auto &byte : bytes) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    return bytes;
+}
+
+// Compresses source, checks that it decompresses to the same bytes and returns the block.
+std::vector<uint8_t> roundTrip(const std::vector<uint8_t> &source, const std::string &what)
+{
+    std::vector<uint8_t> compressed;
+    // Keep the pointers valid for empty inputs.
+    const uint8_t empty{0};
+    lz4Compress(source.empty() ? &empty : source.data(), source.size(), compressed);
+    std::vector<uint8_t> decompressed(source.size() + 1, 0xAA);
+    check(lz4Decompress(compressed.data(), compressed.size(), decompressed.data(), source.size()), what + ": decompresses");
+    check(source.empty() || (0 == std::memcmp(decompressed.data(), source.data(), source.size())), what + ": same bytes");
+    check(0xAA == decompressed[source.size()], what + ": nothing written past the end");
+    return compressed;
+}
+
+void testShortInputs()
+{
+    const std::vector<uint8_t> compressed{roundTrip({}, "empty input")};
+    check((1 == compressed.size()) && (0 == compressed[0]), "empty input is a single token without literals");
+    // Up to 12 bytes are never searched for matches.
+    for (size_t size = 1; size <= 12; size++) {
+        roundTrip(randomBytes(size, static_cast<uint32_t>(size)), std::to_string(size) + " random bytes");
+        roundTrip(std::vector<uint8_t>(size, 7), std::to_string(size) + " equal bytes");
+    }
+}
+
+void testOverlappingMatches()
+{
+    // All-equal input compresses into matches at offset 1 that overlap what they copy.
+    for (const size_t size : {13, 19, 20, 100, 270, 4096, 100000}) {
+        const std::vector<uint8_t> compressed{roundTrip(std::vector<uint8_t>(size, 0x42), std::to_string(size) + " equal bytes")};
+        check(compressed.size() < size / 2 + 16, std::to_string(size) + " equal bytes compress");
+    }
+    // A short pattern repeats at an offset shorter than the matches.
+    std::vector<uint8_t> pattern(5000);
+    for (size_t i = 0; i < pattern.size(); i++) {
+        pattern[i] = static_cast<uint8_t>("abc"[i % 3]);
+    }
+    roundTrip(pattern, "repeated 3 byte pattern");
+}
+
+void testLiterals()
+{
+    // Random data does not compress: one sequence of literals whose length needs extra bytes.
+    for (const size_t size : {13, 100, 1000, 65536, 300000}) {
+        const std::vector<uint8_t> compressed{roundTrip(randomBytes(size, 1000 + static_cast<uint32_t>(size)), std::to_string(size) + " random bytes")};
+        check(compressed.size() <= size + size / 255 + 16, std::to_string(size) + " random bytes stay within the worst case");
+    }
+
+    // 15 literals take all 4 bits of the token and a 0 after it.
+    const std::vector<uint8_t> fifteen{roundTrip(randomBytes(15, 15), "15 literals")};
+    check((0xF0 == fifteen[0]) && (0 == fifteen[1]) && (17 == fifteen.size()), "15 literals are encoded as 15 + 0");
+
+    // 270 literals need a 255 and a 0 after the token.
+    const std::vector<uint8_t> long270{roundTrip(randomBytes(270, 270), "270 literals")};
+    check((0xF0 == long270[0]) && (255 == long270[1]) && (0 == long270[2]) && (273 == long270.size()), "270 literals are encoded as 15 + 255 + 0");
+    roundTrip(randomBytes(271, 271), "271 literals");
+    roundTrip(randomBytes(15 + 255 * 3, 3), "15 + 3 * 255 literals");
+
+    // Long literal runs before and between matches.
+    for (const size_t literals : {15, 270, 1000}) {
+        std::vector<uint8_t> mixed{randomBytes(literals, 7)};
+        mixed.insert(mixed.end(), 300, 0);
+        const std::vector<uint8_t> more{randomBytes(literals, 8)};
+        mixed.insert(mixed.end(), more.begin(), more.end());
+        mixed.insert(mixed.end(), mixed.begin(), mixed.begin() + 500);
+        roundTrip(mixed, std::to_string(literals) + " literals around matches");
+    }
+}
+
+void testCorruptStreams()
+{
+    std::vector<uint8_t> source{randomBytes(600, 42)};
+    source.insert(source.end(), 600, 9);
+    source.insert(source.end(), source.begin(), source.begin() + 300);
+    std::vector<uint8_t> compressed;
+    lz4Compress(source.data(), source.size(), compressed);
+    std::vector<uint8_t> decompressed(source.size());
+
+    // Every truncation ends in the middle of a sequence or expands to too few bytes.
+    for (size_t size = 0; size < compressed.size(); size++) {
+        check(!lz4Decompress(compressed.data(), size, decompressed.data(), decompressed.size()),
+              "stream truncated to " + std::to_string(size) + " bytes fails");
+    }
+    // The size must match exactly.
+    check(!lz4Decompress(compressed.data(), compressed.size(), decompressed.data(), source.size() - 1), "destination too small fails");
+    decompressed.resize(source.size() + 1);
+    check(!lz4Decompress(compressed.data(), compressed.size(), decompressed.data(), source.size() + 1), "destination too large fails");
+
+    // A match at offset 0 or before the start of the output.
+    const uint8_t offsetZero[] = {0x10, 'a', 0x00, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f'};
+    check(!lz4Decompress(offsetZero, sizeof(offsetZero), decompressed.data(), 10), "match at offset 0 fails");
+    const uint8_t offsetBeyond[] = {0x10, 'a', 0x02, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f'};
+    check(!lz4Decompress(offsetBeyond, sizeof(offsetBeyond), decompressed.data(), 10), "match before the start fails");
+    // Literal and match lengths that run past the input or the output.
+    const uint8_t literalsBeyond[] = {0xF0, 255, 255, 'a'};
+    check(!lz4Decompress(literalsBeyond, sizeof(literalsBeyond), decompressed.data(), decompressed.size()), "literals past the input fail");
+    const uint8_t lengthMissing[] = {0xF0};
+    check(!lz4Decompress(lengthMissing, sizeof(lengthMissing), decompressed.data(), decompressed.size()), "missing length byte fails");
+    const uint8_t matchBeyond[] = {0x1F, 'a', 0x01, 0x00, 255, 255, 255, 255, 0x00};
+    check(!lz4Decompress(matchBeyond, sizeof(matchBeyond), decompressed.data(), 64), "match past the output fails");
+
+    // Random garbage is rejected without writing past the destination; none
+    // of these seeds happens to expand into exactly 256 bytes.
+    for (uint32_t seed = 0; seed < 2000; seed++) {
+        const std::vector<uint8_t> garbage{randomBytes(1 + seed % 64, seed)};
+        std::vector<uint8_t> output(256 + 16, 0xAA);
+        check(!lz4Decompress(garbage.data(), garbage.size(), output.data(), 256), "garbage with seed " + std::to_string(seed) + " fails");
+        check(std::vector<uint8_t>(16, 0xAA) == std::vector<uint8_t>(output.begin() + 256, output.end()),
+              "garbage with seed " + std::to_string(seed) + " writes nothing past the end");
+    }
+}
+
+} // namespace
+
+int32_t main()
+{
+    testShortInputs();
+    testOverlappingMatches();
+    testLiterals();
+    testCorruptStreams();
+    if (0 != failures) {
+        std::cerr << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All LZ4 round trips passed." << std::endl;
+    return 0;
+}
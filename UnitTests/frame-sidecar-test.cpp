@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Frame metadata published by one thread and read by another: run with ctest.
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "frame-sidecar.hpp"
+
+// Library's
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+uint32_t failures{0};
+
+void check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+constexpr uint64_t FRAMES{200000};
+
+// Every field of the metadata of frame n follows from n, so that a torn read shows.
+opendlv::proxy::ImageReadingShared imageOf(uint64_t frame)
+{
+    const uint32_t width{static_cast<uint32_t>(frame % 1000) + 1};
+    opendlv::proxy::ImageReadingShared image;
+    image.width(width).height(width + 1).bytesPerPixel(4).size(width * (width + 1) * 4);
+    return image;
+}
+
+bool consistent(const FrameMetadata &metadata)
+{
+    const opendlv::proxy::ImageReadingShared image{imageOf(metadata.frame)};
+    return (static_cast<int64_t>(metadata.frame) * 33333 == metadata.sampleTimeStamp) && (image.width() == metadata.width) &&
+           (image.height() == metadata.height) && (image.bytesPerPixel() == metadata.bytesPerPixel) && (image.size() == metadata.size) &&
+           (0 < metadata.completed);
+}
+
+void testMissingArea(const std::string &name)
+{
+    FrameSidecar consumer{name, false};
+    check(!consumer.valid(), "a consumer without producer has no metadata");
+    FrameMetadata metadata;
+    check(!consumer.read(metadata), "nothing to read without producer");
+}
+
+void testConcurrentReader(const std::string &name)
+{
+    FrameSidecar producer{name, true};
+    FrameSidecar consumer{name, false};
+    check(producer.valid() && consumer.valid(), "producer and consumer open the area");
+    FrameMetadata metadata;
+    check(!consumer.read(metadata), "nothing to read before the first frame");
+
+    std::atomic<bool> reading{false};
+    std::atomic<bool> writing{true};
+    uint64_t reads{0}, readsWhileWriting{0}, torn{0}, backwards{0}, last{0};
+    std::thread reader([&]() {
+        FrameMetadata seen;
+        reading.store(true);
+        // Reads until the writer is done and once more afterwards.
+        bool more{true};
+        for (uint64_t i = 1; more; i++) {
+            more = writing.load();
+            if (0 == i % 16) {
+                std::this_thread::yield();
+            }
+            if (consumer.read(seen)) {
+                reads++;
+                readsWhileWriting += (seen.frame < FRAMES) ? 1 : 0;
+                torn += consistent(seen) ? 0 : 1;
+                backwards += (seen.frame < last) ? 1 : 0;
+                last = seen.frame;
+            }
+        }
+    });
+    while (!reading.load()) {
+        std::this_thread::yield();
+    }
+    for (uint64_t frame = 1; frame <= FRAMES; frame++) {
+        producer.publish(imageOf(frame), static_cast<int64_t>(frame) * 33333);
+        // Both threads yield now and then so that they interleave on a single core, too.
+        if (0 == frame % 16) {
+            std::this_thread::yield();
+        }
+    }
+    writing.store(false);
+    reader.join();
+
+    check(0 < readsWhileWriting, "the reader read metadata while the writer published");
+    check(0 == torn, std::to_string(torn) + " of " + std::to_string(reads) + " reads saw torn metadata");
+    check(0 == backwards, std::to_string(backwards) + " of " + std::to_string(reads) + " reads went back to an older frame");
+    check(FRAMES == last, "the reader ends with the last frame, got " + std::to_string(last));
+    check(consumer.read(metadata) && (FRAMES == metadata.frame) && consistent(metadata), "the last frame stays readable");
+}
+
+} // namespace
+
+int32_t main()
+{
+    const std::string name{"steering-frame-sidecar-test-" + std::to_string(::getpid())};
+    testMissingArea(name);
+    testConcurrentReader(name);
+    if (0 != failures) {
+        std::cerr << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Messages and Envelopes encoded and decoded without copies against libcluon: run with ctest.
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "envelope-view.hpp"
+#include "proto-view.hpp"
+
+// Library's
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+uint32_t failures{0};
+
+void check(bool condition, const std::string &what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+std::string randomBytes(size_t size, uint32_t seed)
+{
+    std::mt19937 generator{seed};
+    std::string bytes(size, '\0');
+    for (auto &byte : bytes) {
+        byte = static_cast<char>(generator());
+    }
+    return bytes;
+}
+
+template <typename T>
+std::string toProto(T &message)
+{
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    return encoder.encodedData();
+}
+
+template <typename T>
+T fromProto(const std::string &data)
+{
+    std::stringstream sstr{data};
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(sstr);
+    T message;
+    message.accept(decoder);
+    return message;
+}
+
+template <typename T>
+bool decodeView(const std::string &data, T &message)
+{
+    ProtoViewDecoder decoder;
+    return decoder.decode(data.data(), data.size(), message);
+}
+
+// Floating point fields must arrive bit for bit.
+template <typename T>
+bool sameBits(T a, T b)
+{
+    return 0 == std::memcmp(&a, &b, sizeof(T));
+}
+
+int64_t toMicroseconds(const cluon::data::TimeStamp &stamp)
+{
+    return static_cast<int64_t>(stamp.seconds()) * 1000 * 1000 + stamp.microseconds();
+}
+
+cluon::data::TimeStamp makeTimeStamp(int32_t seconds, int32_t microseconds)
+{
+    cluon::data::TimeStamp stamp;
+    stamp.seconds(seconds).microseconds(microseconds);
+    return stamp;
+}
+
+// Appends a field of every wire type with an identifier that no message uses.
+void appendUnknownFields(std::string &data)
+{
+    const char unknown[] = {
+        static_cast<char>(0xB8), 0x01, static_cast<char>(0x96), 0x01,  // 23: varint 150
+        static_cast<char>(0xC1), 0x01, 1, 2, 3, 4, 5, 6, 7, 8,  // 24: 8 bytes
+        static_cast<char>(0xCA), 0x01, 3, 'a', 'b', 'c',  // 25: 3 bytes long
+        static_cast<char>(0xD5), 0x01, 1, 2, 3, 4};  // 26: 4 bytes
+    data.append(unknown, sizeof(unknown));
+}
+
+void testMessages()
+{
+    for (const float steering : {0.0f, -0.25f, 0.6f}) {
+        opendlv::proxy::GroundSteeringRequest request;
+        request.groundSteering(steering);
+        const std::string data{toProto(request)};
+        opendlv::proxy::GroundSteeringRequest view;
+        check(decodeView(data, view), "GroundSteeringRequest decodes");
+        check(sameBits(fromProto<opendlv::proxy::GroundSteeringRequest>(data).groundSteering(), view.groundSteering()),
+              "GroundSteeringRequest " + std::to_string(steering) + ": groundSteering");
+    }
+
+    for (const size_t size : {0, 1, 127, 128, 300, 40000}) {
+        opendlv::proxy::ImageReading image;
+        image.fourcc("LZ4F").width(640).height(210).data(randomBytes(size, static_cast<uint32_t>(size)));
+        const std::string data{toProto(image)};
+        const opendlv::proxy::ImageReading reference{fromProto<opendlv::proxy::ImageReading>(data)};
+        opendlv::proxy::ImageReading view;
+        const std::string what{"ImageReading with " + std::to_string(size) + " bytes"};
+        check(decodeView(data, view), what + " decodes");
+        check(reference.fourcc() == view.fourcc(), what + ": fourcc");
+        check(reference.width() == view.width(), what + ": width");
+        check(reference.height() == view.height(), what + ": height");
+        check(reference.data() == view.data(), what + ": data");
+    }
+
+    // Signed fields are zig-zag encoded; negative values of all sizes.
+    for (const int32_t seconds : {0, -1, 1, -2147483647 - 1, 2147483647}) {
+        cluon::data::TimeStamp stamp{makeTimeStamp(seconds, -999999)};
+        const std::string data{toProto(stamp)};
+        const cluon::data::TimeStamp reference{fromProto<cluon::data::TimeStamp>(data)};
+        cluon::data::TimeStamp view;
+        const std::string what{"TimeStamp " + std::to_string(seconds)};
+        check(decodeView(data, view), what + " decodes");
+        check(reference.seconds() == view.seconds(), what + ": seconds");
+        check(reference.microseconds() == view.microseconds(), what + ": microseconds");
+    }
+    for (const int16_t state : {-32768, -1, 0, 1, 32767}) {
+        opendlv::proxy::SwitchStateReading reading;
+        reading.state(state);
+        const std::string data{toProto(reading)};
+        opendlv::proxy::SwitchStateReading view;
+        check(decodeView(data, view), "SwitchStateReading decodes");
+        check(fromProto<opendlv::proxy::SwitchStateReading>(data).state() == view.state(), "SwitchStateReading " + std::to_string(state) + ": state");
+    }
+
+    opendlv::proxy::GeodeticWgs84Reading position;
+    position.latitude(57.70887).longitude(-11.97456);
+    std::string data{toProto(position)};
+    opendlv::proxy::GeodeticWgs84Reading view;
+    check(decodeView(data, view), "GeodeticWgs84Reading decodes");
+    check(sameBits(fromProto<opendlv::proxy::GeodeticWgs84Reading>(data).latitude(), view.latitude()), "GeodeticWgs84Reading: latitude");
+    check(sameBits(fromProto<opendlv::proxy::GeodeticWgs84Reading>(data).longitude(), view.longitude()), "GeodeticWgs84Reading: longitude");
+
+    // Unknown fields are skipped.
+    appendUnknownFields(data);
+    opendlv::proxy::GeodeticWgs84Reading skipped;
+    check(decodeView(data, skipped), "GeodeticWgs84Reading with unknown fields decodes");
+    check(sameBits(view.latitude(), skipped.latitude()) && sameBits(view.longitude(), skipped.longitude()), "unknown fields leave the message alone");
+
+    // Truncated and malformed buffers.
+    for (size_t size = 1; size < data.size(); size++) {
+        opendlv::proxy::GeodeticWgs84Reading truncated;
+        ProtoViewDecoder decoder;
+        const bool decoded{decoder.decode(data.data(), size, truncated)};
+        // Cuts between two fields are valid messages with fewer fields.
+        check(!decoded || (9 == size) || (18 == size) || (22 == size) || (32 == size) || (38 == size),
+              "message truncated to " + std::to_string(size) + " bytes fails");
+    }
+    const std::string wireType7{static_cast<char>(0x0F), 0};
+    check(!decodeView(wireType7, view), "unknown wire type fails");
+    const std::string longVarInt(11, static_cast<char>(0x80));
+    check(!decodeView(longVarInt, view), "varint without end fails");
+}
+
+void testEnvelopes()
+{
+    struct {
+        int32_t sentSeconds, sentMicroseconds, sampleSeconds, sampleMicroseconds;
+        uint32_t senderStamp;
+        size_t payload;
+    } cases[] = {
+        {1600000000, 123456, 1600000000, 100000, 0, 0},
+        {1600000000, 999999, 1599999999, 0, 7, 300},
+        // Negative time stamps, e.g. before the start of a replayed recording.
+        {-1, -500000, -3, 250000, 4294967295u, 40000},
+        {0, -1, -2147483647 - 1, -999999, 1, 120},
+    };
+    for (const auto &c : cases) {
+        opendlv::proxy::ImageReading image;
+        image.fourcc("LZ4F").width(640).height(210).data(randomBytes(c.payload, c.senderStamp));
+        cluon::data::Envelope envelope;
+        envelope.dataType(opendlv::proxy::ImageReading::ID())
+            .serializedData(toProto(image))
+            .sent(makeTimeStamp(c.sentSeconds, c.sentMicroseconds))
+            .received(makeTimeStamp(c.sentSeconds, 1))
+            .sampleTimeStamp(makeTimeStamp(c.sampleSeconds, c.sampleMicroseconds))
+            .senderStamp(c.senderStamp);
+        const std::string data{cluon::serializeEnvelope(std::move(envelope))};
+        std::stringstream sstr{data};
+        const auto extracted = cluon::extractEnvelope(sstr);
+        const cluon::data::Envelope &reference{extracted.second};
+        const std::string what{"Envelope sent at " + std::to_string(c.sentSeconds) + " s with " + std::to_string(c.payload) + " bytes"};
+        check(extracted.first, what + ": libcluon extracts it");
+
+        uint32_t length{0};
+        check(decodeOD4Header(data.data(), length), what + ": OD4 header");
+        check(OD4_HEADER_SIZE + length == data.size(), what + ": length");
+        EnvelopeView view;
+        check(decodeEnvelopeView(data.data() + OD4_HEADER_SIZE, length, view), what + ": decodes");
+        check(reference.dataType() == view.dataType, what + ": dataType");
+        check(reference.senderStamp() == view.senderStamp, what + ": senderStamp");
+        check(toMicroseconds(reference.sent()) == view.sent, what + ": sent");
+        check(toMicroseconds(reference.received()) == view.received, what + ": received");
+        check(toMicroseconds(reference.sampleTimeStamp()) == view.sampleTimeStamp, what + ": sampleTimeStamp");
+        check(reference.serializedData() == std::string(view.serializedData, view.serializedDataSize), what + ": serializedData");
+
+        opendlv::proxy::ImageReading decoded;
+        check(decodeMessage(view, decoded), what + ": payload decodes");
+        check(image.data() == decoded.data(), what + ": payload data");
+        opendlv::proxy::GroundSteeringRequest other;
+        check(!decodeMessage(view, other), what + ": payload of another type is rejected");
+
+        // Unknown fields in the Envelope are skipped.
+        std::string extended{data.substr(OD4_HEADER_SIZE)};
+        appendUnknownFields(extended);
+        EnvelopeView skipped;
+        check(decodeEnvelopeView(extended.data(), extended.size(), skipped), what + ": decodes with unknown fields");
+        check((view.dataType == skipped.dataType) && (view.senderStamp == skipped.senderStamp) && (view.sent == skipped.sent) &&
+                  (view.sampleTimeStamp == skipped.sampleTimeStamp) && (view.serializedDataSize == skipped.serializedDataSize),
+              what + ": unknown fields leave the Envelope alone");
+
+        // The Envelope cut in the middle of the payload.
+        const size_t cut{static_cast<size_t>(view.serializedData - data.data()) - OD4_HEADER_SIZE + view.serializedDataSize - 1};
+        check(!decodeEnvelopeView(data.data() + OD4_HEADER_SIZE, cut, skipped), what + ": truncated Envelope fails");
+    }
+
+    const char notOD4[OD4_HEADER_SIZE] = {0x0D, 0x0A, 0, 0, 0};
+    uint32_t length{0};
+    check(!decodeOD4Header(notOD4, length), "header without 0x0D 0xA4 fails");
+}
+
+// Encodes message with ProtoViewEncoder into a buffer of capacity bytes.
+template <typename T>
+std::string encodeView(T &message, size_t capacity, bool &valid)
+{
+    std::vector<char> buffer(capacity + 1, '\0');
+    ProtoViewEncoder encoder{buffer.data(), capacity};
+    encoder.encodeFields(message);
+    valid = encoder.valid();
+    return std::string(buffer.data(), encoder.position());
+}
+
+// Encodes message as Envelope with both encoders and compares the bytes.
+template <typename T>
+void checkEnvelope(T &message, int64_t sent, int64_t sampleTimeStamp, uint32_t senderStamp, const std::string &what)
+{
+    cluon::data::Envelope envelope;
+    envelope.dataType(T::ID())
+        .serializedData(toProto(message))
+        .sent(cluon::time::fromMicroseconds(sent))
+        .sampleTimeStamp(cluon::time::fromMicroseconds(sampleTimeStamp))
+        .senderStamp(senderStamp);
+    const std::string reference{cluon::serializeEnvelope(std::move(envelope))};
+
+    std::vector<char> buffer(reference.size() + 64);
+    const size_t size{encodeEnvelope(buffer.data(), buffer.size(), message, sent, sampleTimeStamp, senderStamp)};
+    check(reference == std::string(buffer.data(), size), what + ": Envelope is byte for byte the one of libcluon");
+    check(reference.size() == encodeEnvelope(buffer.data(), reference.size(), message, sent, sampleTimeStamp, senderStamp),
+          what + ": Envelope fits into a buffer of its size");
+    check(0 == encodeEnvelope(buffer.data(), reference.size() - 1, message, sent, sampleTimeStamp, senderStamp),
+          what + ": Envelope does not fit into a buffer one byte shorter");
+}
+
+void testEncoder()
+{
+    for (const float steering : {0.0f, -0.25f, 0.6f}) {
+        opendlv::proxy::GroundSteeringRequest request;
+        request.groundSteering(steering);
+        const std::string what{"GroundSteeringRequest " + std::to_string(steering)};
+        bool valid{false};
+        check(toProto(request) == encodeView(request, 64, valid), what + " is byte for byte the one of libcluon");
+        check(valid, what + " fits");
+        checkEnvelope(request, 1600000000123456, 1600000000100000, 0, what);
+    }
+
+    opendlv::logic::perception::ObjectDirection direction;
+    direction.objectId(3).azimuthAngle(-0.5f).zenithAngle(0.1f);
+    bool valid{false};
+    check(toProto(direction) == encodeView(direction, 64, valid), "ObjectDirection is byte for byte the one of libcluon");
+    checkEnvelope(direction, 1600000000123456, 1600000000100000, 1, "ObjectDirection");
+
+    opendlv::logic::action::AimPoint aimPoint;
+    aimPoint.azimuthAngle(0.25f).zenithAngle(0.0f).distance(1.5f);
+    check(toProto(aimPoint) == encodeView(aimPoint, 64, valid), "AimPoint is byte for byte the one of libcluon");
+    // Negative time stamps split into negative seconds and microseconds like cluon::time::fromMicroseconds.
+    checkEnvelope(aimPoint, -1500000, -1, 2, "AimPoint");
+
+    // Envelope payloads whose length needs one, two and three bytes: the reserved byte is widened and the payload moved.
+    for (const size_t size : {0, 120, 300, 16383, 16384, 40000}) {
+        opendlv::proxy::ImageReading image;
+        image.fourcc("LZ4F").width(640).height(210).data(randomBytes(size, static_cast<uint32_t>(size)));
+        const std::string what{"ImageReading with " + std::to_string(size) + " bytes"};
+        const std::string reference{toProto(image)};
+        check(reference == encodeView(image, reference.size(), valid), what + " is byte for byte the one of libcluon");
+        check(valid, what + " fits into a buffer of its size");
+        encodeView(image, reference.size() - 1, valid);
+        check(!valid, what + " does not fit into a buffer one byte shorter");
+        checkEnvelope(image, 1600000000999999, 1599999999000000, 4294967295u, what);
+    }
+}
+
+} // namespace
+
+int32_t main()
+{
+    testMessages();
+    testEnvelopes();
+    testEncoder();
+    if (0 != failures) {
+        std::cerr << failures << " checks failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}
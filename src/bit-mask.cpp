@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bit-mask.hpp"
+
+#include <algorithm>
+
+constexpr uint32_t BlobList::CAPACITY;
+
+namespace {
+
+inline uint32_t popcount(uint64_t word) noexcept
+{
+    return static_cast<uint32_t>(__builtin_popcountll(word));
+}
+
+inline int32_t trailingZeros(uint64_t word) noexcept
+{
+    return static_cast<int32_t>(__builtin_ctzll(word));
+}
+
+} // namespace
+
+BitMask::BitMask(int width, int height)
+{
+    create(width, height);
+}
+
+void BitMask::create(int width, int height)
+{
+    if ((width == m_width) && (height == m_height)) {
+        return;
+    }
+    m_width = width;
+    m_height = height;
+    m_wordsPerRow = static_cast<size_t>((width + 63) / 64);
+    m_words.assign(m_wordsPerRow * static_cast<size_t>(height), 0);
+}
+
+uint32_t BitMask::count(int first, int last) const noexcept
+{
+    uint32_t sum{0};
+    const uint64_t *words{row(first)};
+    const size_t count{static_cast<size_t>(last - first) * m_wordsPerRow};
+    for (size_t i = 0; i < count; i++) {
+        sum += popcount(words[i]);
+    }
+    return sum;
+}
+
+bool BitMask::any(int first, int last) const noexcept
+{
+    uint64_t any{0};
+    const uint64_t *words{row(first)};
+    const size_t count{static_cast<size_t>(last - first) * m_wordsPerRow};
+    for (size_t i = 0; i < count; i++) {
+        any |= words[i];
+    }
+    return 0 != any;
+}
+
+uint32_t BitMask::count(const cv::Rect &box) const noexcept
+{
+    if ((box.width <= 0) || (box.height <= 0)) {
+        return 0;
+    }
+    const int firstWord{box.x / 64};
+    const int lastWord{(box.x + box.width - 1) / 64};
+    const uint64_t firstMask{~0ULL << (box.x % 64)};
+    const uint64_t lastMask{~0ULL >> (63 - (box.x + box.width - 1) % 64)};
+    uint32_t sum{0};
+    for (int y = box.y; y < box.y + box.height; y++) {
+        const uint64_t *words{row(y)};
+        if (firstWord == lastWord) {
+            sum += popcount(words[firstWord] & firstMask & lastMask);
+            continue;
+        }
+        sum += popcount(words[firstWord] & firstMask);
+        for (int w = firstWord + 1; w < lastWord; w++) {
+            sum += popcount(words[w]);
+        }
+        sum += popcount(words[lastWord] & lastMask);
+    }
+    return sum;
+}
+
+void BitMask::project(uint16_t *rows, uint16_t *columns) const noexcept
+{
+    std::fill(columns, columns + m_width, 0);
+    for (int y = 0; y < m_height; y++) {
+        const uint64_t *words{row(y)};
+        uint32_t sum{0};
+        for (size_t w = 0; w < m_wordsPerRow; w++) {
+            sum += popcount(words[w]);
+            // Only the set bits are visited.
+            for (uint64_t word = words[w]; 0 != word; word &= word - 1) {
+                columns[static_cast<int>(w * 64) + trailingZeros(word)]++;
+            }
+        }
+        rows[y] = static_cast<uint16_t>(sum);
+    }
+}
+
+void BitMask::fromBytes(const cv::Mat &mask)
+{
+    create(mask.cols, mask.rows);
+    for (int y = 0; y < m_height; y++) {
+        const uint8_t *bytes{mask.ptr<uint8_t>(y)};
+        uint64_t *words{m_words.data() + static_cast<size_t>(y) * m_wordsPerRow};
+        for (size_t w = 0; w < m_wordsPerRow; w++) {
+            uint64_t word{0};
+            const int end{std::min(m_width, static_cast<int>(w * 64) + 64)};
+            for (int x = static_cast<int>(w * 64); x < end; x++) {
+                word |= static_cast<uint64_t>(0 != bytes[x]) << (x % 64);
+            }
+            words[w] = word;
+        }
+    }
+}
+
+void BitMask::toBytes(cv::Mat &mask) const
+{
+    mask.create(m_height, m_width, CV_8UC1);
+    for (int y = 0; y < m_height; y++) {
+        uint8_t *bytes{mask.ptr<uint8_t>(y)};
+        const uint64_t *words{row(y)};
+        for (int x = 0; x < m_width; x++) {
+            bytes[x] = static_cast<uint8_t>(-static_cast<int>((words[x / 64] >> (x % 64)) & 1));
+        }
+    }
+}
+
+BlobFinder::BlobFinder(int width, int height)
+    // At most every other pixel of a row starts a run.
+    : m_runs(static_cast<size_t>((width + 1) / 2) * static_cast<size_t>(height))
+    , m_blobOfRun(m_runs.size())
+    , m_boxOfRoot(m_runs.size())
+{
+}
+
+uint32_t BlobFinder::root(uint32_t run) noexcept
+{
+    while (m_runs[run].parent != run) {
+        // Path halving.
+        m_runs[run].parent = m_runs[m_runs[run].parent].parent;
+        run = m_runs[run].parent;
+    }
+    return run;
+}
+
+void BlobFinder::join(uint32_t a, uint32_t b) noexcept
+{
+    a = root(a);
+    b = root(b);
+    // The earlier run becomes the root, so that blobs keep the order of their first pixel.
+    if (a < b) {
+        m_runs[b].parent = a;
+    } else if (b < a) {
+        m_runs[a].parent = b;
+    }
+}
+
+void BlobFinder::find(const BitMask &mask, BlobList &blobs, int minimumArea) noexcept
+{
+    const int32_t words{static_cast<int32_t>(mask.wordsPerRow())};
+    uint32_t runs{0};
+    uint32_t previousFirst{0}, previousEnd{0};
+    for (int32_t y = 0; y < mask.height(); y++) {
+        const uint64_t *row{mask.row(y)};
+        const uint32_t first{runs};
+        // Runs of set bits: the next set bit, then the next clear bit after it.
+        for (int32_t x = 0; x < words * 64;) {
+            int32_t w{x / 64};
+            uint64_t word{row[w] & (~0ULL << (x % 64))};
+            while ((0 == word) && (++w < words)) {
+                word = row[w];
+            }
+            if (0 == word) {
+                break;
+            }
+            const int32_t start{w * 64 + trailingZeros(word)};
+            w = start / 64;
+            uint64_t inverted{~row[w] & (~0ULL << (start % 64))};
+            while ((0 == inverted) && (++w < words)) {
+                inverted = ~row[w];
+            }
+            // The bits after the last column are clear, so a run only reaches the end of the words if the width is a multiple of 64.
+            const int32_t end{(0 != inverted) ? w * 64 + trailingZeros(inverted) : words * 64};
+            Run &run{m_runs[runs]};
+            run.y = y;
+            run.start = start;
+            run.end = end;
+            run.parent = runs;
+            runs++;
+            x = end;
+        }
+
+        // Join with the runs of the row above that overlap, diagonals included.
+        uint32_t above{previousFirst};
+        for (uint32_t r = first; r < runs; r++) {
+            while ((above < previousEnd) && (m_runs[above].end < m_runs[r].start)) {
+                above++;
+            }
+            for (uint32_t a = above; (a < previousEnd) && (m_runs[a].start <= m_runs[r].end); a++) {
+                join(a, r);
+            }
+        }
+        previousFirst = first;
+        previousEnd = runs;
+    }
+
+    // Bounding boxes first, so that small blobs are known before they take a
+    // place; roots are visited before the runs joined to them.
+    for (uint32_t r = 0; r < runs; r++) {
+        const uint32_t top{root(r)};
+        const Run &run{m_runs[r]};
+        cv::Rect &box{m_boxOfRoot[top]};
+        if (top == r) {
+            box = cv::Rect(run.start, run.y, run.end - run.start, 1);
+            continue;
+        }
+        const int32_t left{std::min(box.x, run.start)};
+        const int32_t right{std::max(box.x + box.width, run.end)};
+        box.x = left;
+        box.width = right - left;
+        box.height = run.y + 1 - box.y;
+    }
+
+    // Sum up the runs per blob.
+    blobs.count = 0;
+    blobs.dropped = 0;
+    blobs.small = 0;
+    double sumX[BlobList::CAPACITY];
+    double sumY[BlobList::CAPACITY];
+    for (uint32_t r = 0; r < runs; r++) {
+        const uint32_t top{root(r)};
+        const Run &run{m_runs[r]};
+        if (top == r) {
+            if (m_boxOfRoot[r].area() <= minimumArea) {
+                m_blobOfRun[r] = BlobList::CAPACITY;
+                blobs.small++;
+                continue;
+            }
+            if (BlobList::CAPACITY == blobs.count) {
+                m_blobOfRun[r] = BlobList::CAPACITY;
+                blobs.dropped++;
+                continue;
+            }
+            m_blobOfRun[r] = blobs.count;
+            Blob &blob{blobs.blobs[blobs.count]};
+            blob.box = m_boxOfRoot[r];
+            blob.area = 0;
+            sumX[blobs.count] = sumY[blobs.count] = 0.0;
+            blobs.count++;
+        }
+        const uint32_t index{m_blobOfRun[top]};
+        if (BlobList::CAPACITY == index) {
+            continue;
+        }
+        const int32_t length{run.end - run.start};
+        blobs.blobs[index].area += static_cast<uint32_t>(length);
+        sumX[index] += length * (run.start + run.end - 1) / 2.0;
+        sumY[index] += static_cast<double>(length) * run.y;
+    }
+    for (uint32_t i = 0; i < blobs.count; i++) {
+        blobs.blobs[i].cx = static_cast<float>(sumX[i] / blobs.blobs[i].area);
+        blobs.blobs[i].cy = static_cast<float>(sumY[i] / blobs.blobs[i].area);
+    }
+}
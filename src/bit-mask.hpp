@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BIT_MASK_HPP
+#define BIT_MASK_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Binary mask with one bit per pixel as written by the SegmentBitsKernels:
+ * every row starts with a new 64 bit word, pixel x of a row is bit x % 64 of
+ * word x / 64 and the bits after the last column are 0. It is an eighth of
+ * a 0/255 byte mask, and counting or testing bands of rows reads one word
+ * per 64 pixels.
+ */
+class BitMask {
+   public:
+    BitMask() = default;
+    BitMask(int width, int height);
+
+    // Allocates the words for a width x height mask unless it already has that size.
+    void create(int width, int height);
+
+    int width() const noexcept { return m_width; }
+    int height() const noexcept { return m_height; }
+    size_t wordsPerRow() const noexcept { return m_wordsPerRow; }
+    uint64_t *data() noexcept { return m_words.data(); }
+    const uint64_t *row(int y) const noexcept { return m_words.data() + static_cast<size_t>(y) * m_wordsPerRow; }
+
+    bool at(int x, int y) const noexcept { return 0 != ((row(y)[x / 64] >> (x % 64)) & 1); }
+
+    // Number of set pixels in the rows [first, last).
+    uint32_t count(int first, int last) const noexcept;
+    uint32_t count() const noexcept { return count(0, m_height); }
+
+    // Returns true if any pixel is set in the rows [first, last).
+    bool any(int first, int last) const noexcept;
+
+    // Number of set pixels inside box, which must lie inside the mask.
+    uint32_t count(const cv::Rect &box) const noexcept;
+
+    // Set pixels per row (height() entries) and per column (width() entries).
+    void project(uint16_t *rows, uint16_t *columns) const noexcept;
+
+    // Converts from and to a CV_8UC1 mask (0 = clear, everything else = set; set pixels become 255).
+    void fromBytes(const cv::Mat &mask);
+    void toBytes(cv::Mat &mask) const;
+
+   private:
+    int m_width{0};
+    int m_height{0};
+    size_t m_wordsPerRow{0};
+    std::vector<uint64_t> m_words{};
+};
+
+// 8-connected set pixels of a BitMask.
+struct Blob {
+    cv::Rect box{};
+    uint32_t area{0};
+    float cx{0.0f};
+    float cy{0.0f};
+};
+
+// Blobs of one mask in the order of their topmost, leftmost pixel.
+struct BlobList {
+    static constexpr uint32_t CAPACITY{64};
+    Blob blobs[CAPACITY];
+    uint32_t count{0};
+    // Blobs left out because the list was full.
+    uint32_t dropped{0};
+    // Blobs left out because their box was not larger than the minimum area.
+    uint32_t small{0};
+};
+
+/**
+ * Finds the blobs of a BitMask: the runs of set pixels of every row are
+ * found with bit scans on the words, runs that touch runs of the row above
+ * (including diagonally) are joined with a union-find, and area, bounding
+ * box and centroid are summed up per run instead of per pixel. All buffers
+ * are allocated once for the largest mask.
+ */
+class BlobFinder {
+   private:
+    BlobFinder(const BlobFinder &) = delete;
+    BlobFinder(BlobFinder &&) = delete;
+    BlobFinder &operator=(const BlobFinder &) = delete;
+    BlobFinder &operator=(BlobFinder &&) = delete;
+
+   public:
+    BlobFinder(int width, int height);
+
+    /**
+     * Fills blobs with the blobs of mask, which must not be larger than given
+     * to the constructor. Blobs whose bounding box has at most minimumArea
+     * pixels take no place in the list, so that specks cannot push the cones
+     * further down out of it.
+     */
+    void find(const BitMask &mask, BlobList &blobs, int minimumArea = 0) noexcept;
+
+   private:
+    struct Run {
+        int32_t y;
+        int32_t start;
+        int32_t end; // exclusive
+        uint32_t parent;
+    };
+
+    uint32_t root(uint32_t run) noexcept;
+    void join(uint32_t a, uint32_t b) noexcept;
+
+   private:
+    std::vector<Run> m_runs{};
+    std::vector<uint32_t> m_blobOfRun{};
+    // Bounding box per blob, kept at the blob's root run.
+    std::vector<cv::Rect> m_boxOfRoot{};
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "centreline-planner.hpp"
+
+#include <cmath>
+
+CentrelinePlanner::CentrelinePlanner(float wheelBase, float lookAhead, float previewDistance, float minGateWidth, float maxGateWidth, float maxSteeringAngle) noexcept
+    : m_wheelBase(wheelBase)
+    , m_lookAhead(lookAhead)
+    , m_previewDistance(previewDistance)
+    , m_minGateWidth(minGateWidth)
+    , m_maxGateWidth(maxGateWidth)
+    , m_maxSteeringAngle(maxSteeringAngle)
+    , m_trackWidth((minGateWidth + maxGateWidth) / 2.0f)
+{
+}
+
+uint32_t CentrelinePlanner::locate(const GroundProjection &ground, const ConeList &cones, Point *points) const noexcept
+{
+    // Cones are kept sorted by x with an insertion sort; there are only a few of them.
+    uint32_t count{0};
+    for (uint32_t i = 0; i < cones.count; i++) {
+        const GroundPoint &foot{ground.footOf(cones.boxes[i])};
+        if (0.0f < foot.distance) {
+            uint32_t j{count++};
+            for (; (0 < j) && (foot.x < points[j - 1].x); j--) {
+                points[j] = points[j - 1];
+            }
+            points[j].x = foot.x;
+            points[j].y = foot.y;
+        }
+    }
+    return count;
+}
+
+void CentrelinePlanner::fit(uint32_t count) noexcept
+{
+    // Normal equations of the least squares fit of y = c0 + c1 x + c2 x^2.
+    double sx[5]{static_cast<double>(count), 0, 0, 0, 0};
+    double sxy[3]{0, 0, 0};
+    for (uint32_t i = 0; i < count; i++) {
+        const double x{m_centres[i].x};
+        const double y{m_centres[i].y};
+        const double xx{x * x};
+        sx[1] += x;
+        sx[2] += xx;
+        sx[3] += xx * x;
+        sx[4] += xx * xx;
+        sxy[0] += y;
+        sxy[1] += x * y;
+        sxy[2] += xx * y;
+    }
+    m_path.c0 = m_path.c1 = m_path.c2 = 0.0f;
+    if (3 <= count) {
+        const double det{sx[0] * (sx[2] * sx[4] - sx[3] * sx[3]) - sx[1] * (sx[1] * sx[4] - sx[3] * sx[2]) + sx[2] * (sx[1] * sx[3] - sx[2] * sx[2])};
+        if (1e-9 < std::fabs(det)) {
+            // Cramer's rule.
+            const double d0{sxy[0] * (sx[2] * sx[4] - sx[3] * sx[3]) - sx[1] * (sxy[1] * sx[4] - sx[3] * sxy[2]) + sx[2] * (sxy[1] * sx[3] - sx[2] * sxy[2])};
+            const double d1{sx[0] * (sxy[1] * sx[4] - sxy[2] * sx[3]) - sxy[0] * (sx[1] * sx[4] - sx[3] * sx[2]) + sx[2] * (sx[1] * sxy[2] - sxy[1] * sx[2])};
+            const double d2{sx[0] * (sx[2] * sxy[2] - sx[3] * sxy[1]) - sx[1] * (sx[1] * sxy[2] - sxy[1] * sx[2]) + sxy[0] * (sx[1] * sx[3] - sx[2] * sx[2])};
+            m_path.c0 = static_cast<float>(d0 / det);
+            m_path.c1 = static_cast<float>(d1 / det);
+            m_path.c2 = static_cast<float>(d2 / det);
+            return;
+        }
+    }
+    // Too few or degenerate centres: straight line.
+    const double det{sx[0] * sx[2] - sx[1] * sx[1]};
+    if (1e-9 < std::fabs(det)) {
+        m_path.c0 = static_cast<float>((sxy[0] * sx[2] - sx[1] * sxy[1]) / det);
+        m_path.c1 = static_cast<float>((sx[0] * sxy[1] - sx[1] * sxy[0]) / det);
+    }
+}
+
+GroundPoint CentrelinePlanner::pointAt(float distance) const noexcept
+{
+    // Bisection for the x where the centreline is the given distance away from the vehicle.
+    float low{0.0f};
+    float high{distance};
+    for (uint32_t i = 0; i < 24; i++) {
+        const float x{(low + high) / 2.0f};
+        const float y{m_path.c0 + (m_path.c1 + m_path.c2 * x) * x};
+        if ((x * x + y * y) < (distance * distance)) {
+            low = x;
+        } else {
+            high = x;
+        }
+    }
+    GroundPoint point;
+    point.x = low;
+    point.y = m_path.c0 + (m_path.c1 + m_path.c2 * low) * low;
+    point.distance = std::sqrt(point.x * point.x + point.y * point.y);
+    point.bearing = std::atan2(point.y, point.x);
+    return point;
+}
+
+const PlannedPath &CentrelinePlanner::plan(const GroundProjection &ground, const ConeList &blue, const ConeList &yellow) noexcept
+{
+    const uint32_t blueCount{locate(ground, blue, m_blue)};
+    const uint32_t yellowCount{locate(ground, yellow, m_yellow)};
+
+    // The vehicle is on the centreline.
+    uint32_t centres{1};
+    m_centres[0] = Point{};
+
+    // Pair every blue cone, nearest first, with the closest unpaired yellow cone at a plausible gate width.
+    uint32_t gates{0};
+    float blueSide{0.0f};
+    float gateWidths{0.0f};
+    for (uint32_t j = 0; j < yellowCount; j++) {
+        m_paired[j] = false;
+    }
+    for (uint32_t i = 0; i < blueCount; i++) {
+        float closest{m_maxGateWidth * m_maxGateWidth};
+        uint32_t partner{yellowCount};
+        for (uint32_t j = 0; j < yellowCount; j++) {
+            const float dx{m_yellow[j].x - m_blue[i].x};
+            const float dy{m_yellow[j].y - m_blue[i].y};
+            const float squared{dx * dx + dy * dy};
+            if (!m_paired[j] && (squared <= closest) && ((m_minGateWidth * m_minGateWidth) <= squared)) {
+                closest = squared;
+                partner = j;
+            }
+        }
+        if (partner < yellowCount) {
+            m_paired[partner] = true;
+            m_centres[centres].x = (m_blue[i].x + m_yellow[partner].x) / 2.0f;
+            m_centres[centres].y = (m_blue[i].y + m_yellow[partner].y) / 2.0f;
+            centres++;
+            gates++;
+            blueSide += m_blue[i].y - m_yellow[partner].y;
+            gateWidths += std::sqrt(closest);
+        }
+    }
+    if (0 < gates) {
+        m_sidesKnown = true;
+        m_blueOnLeft = (0.0f < blueSide);
+        m_trackWidth = gateWidths / static_cast<float>(gates);
+    } else if (m_sidesKnown) {
+        // Without gates, the cones of each colour are shifted by half the track width towards the centre.
+        const float halfWidth{m_trackWidth / 2.0f};
+        for (uint32_t i = 0; i < blueCount; i++, centres++) {
+            m_centres[centres].x = m_blue[i].x;
+            m_centres[centres].y = m_blue[i].y + (m_blueOnLeft ? -halfWidth : halfWidth);
+        }
+        for (uint32_t j = 0; (j < yellowCount) && (centres < (ConeList::CAPACITY + 1)); j++, centres++) {
+            m_centres[centres].x = m_yellow[j].x;
+            m_centres[centres].y = m_yellow[j].y + (m_blueOnLeft ? halfWidth : -halfWidth);
+        }
+    }
+
+    m_path.gates = gates;
+    m_path.valid = (1 < centres);
+    if (!m_path.valid) {
+        m_path.steeringAngle = 0.0f;
+        return m_path;
+    }
+    fit(centres);
+    m_path.aim = pointAt(m_lookAhead);
+    m_path.preview = pointAt(m_previewDistance);
+
+    // Pure pursuit: the arc through the aim point tangent to the heading.
+    const float angle{(0.0f < m_path.aim.distance) ? std::atan(2.0f * m_wheelBase * std::sin(m_path.aim.bearing) / m_path.aim.distance) : 0.0f};
+    m_path.steeringAngle = std::fmax(-m_maxSteeringAngle, std::fmin(m_maxSteeringAngle, angle));
+    return m_path;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CENTRELINE_PLANNER_HPP
+#define CENTRELINE_PLANNER_HPP
+
+#include "cone-detection.hpp"
+#include "ground-projection.hpp"
+
+#include <cstdint>
+
+// Path through the cones of one frame in vehicle coordinates (x forward, y left, metres).
+struct PlannedPath {
+    bool valid{false};
+    // Gates formed by a blue and a yellow cone; without any, cones of one colour shifted to the centre.
+    uint32_t gates{0};
+    // Centreline y = c0 + c1 * x + c2 * x^2.
+    float c0{0.0f};
+    float c1{0.0f};
+    float c2{0.0f};
+    // Points on the centreline at the look-ahead and the preview distance.
+    GroundPoint aim{};
+    GroundPoint preview{};
+    // Pure pursuit steering angle towards the aim point in radians, positive to the left.
+    float steeringAngle{0.0f};
+};
+
+/**
+ * Plans a path through all cones of a frame: the cones are located on the
+ * ground, paired into gates of a blue and a yellow cone, and a quadratic
+ * through the vehicle and the centres of the gates is fitted by least
+ * squares. The steering angle follows the centreline with pure pursuit.
+ *
+ * Everything is kept in fixed arrays of ConeList::CAPACITY entries, so
+ * planning allocates nothing and takes a few microseconds.
+ */
+class CentrelinePlanner {
+   private:
+    CentrelinePlanner(const CentrelinePlanner &) = delete;
+    CentrelinePlanner(CentrelinePlanner &&) = delete;
+    CentrelinePlanner &operator=(const CentrelinePlanner &) = delete;
+    CentrelinePlanner &operator=(CentrelinePlanner &&) = delete;
+
+   public:
+    /**
+     * @param wheelBase Distance between the axles in metres.
+     * @param lookAhead Distance of the aim point in metres.
+     * @param previewDistance Distance of the preview point in metres.
+     * @param minGateWidth Closest a blue and a yellow cone may be to form a gate, in metres.
+     * @param maxGateWidth Farthest a blue and a yellow cone may be to form a gate, in metres.
+     * @param maxSteeringAngle Limit of the steering angle in radians.
+     */
+    CentrelinePlanner(float wheelBase, float lookAhead, float previewDistance, float minGateWidth, float maxGateWidth, float maxSteeringAngle) noexcept;
+
+    /**
+     * Plans the path for the cones of one frame; boxes are in coordinates of
+     * the crop zone of the ground projection. The sides of the colours and
+     * the width of the track are remembered from frames with gates.
+     */
+    const PlannedPath &plan(const GroundProjection &ground, const ConeList &blue, const ConeList &yellow) noexcept;
+
+   private:
+    struct Point {
+        float x{0.0f};
+        float y{0.0f};
+    };
+
+    uint32_t locate(const GroundProjection &ground, const ConeList &cones, Point *points) const noexcept;
+    void fit(uint32_t count) noexcept;
+    GroundPoint pointAt(float distance) const noexcept;
+
+   private:
+    float m_wheelBase;
+    float m_lookAhead;
+    float m_previewDistance;
+    float m_minGateWidth;
+    float m_maxGateWidth;
+    float m_maxSteeringAngle;
+
+    bool m_sidesKnown{false};
+    bool m_blueOnLeft{false};
+    float m_trackWidth;
+
+    Point m_blue[ConeList::CAPACITY]{};
+    Point m_yellow[ConeList::CAPACITY]{};
+    bool m_paired[ConeList::CAPACITY]{};
+    // Centres of the gates plus the vehicle itself.
+    Point m_centres[ConeList::CAPACITY + 1]{};
+    PlannedPath m_path{};
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cone-bands.hpp"
+
+#include <algorithm>
+
+ConeBandFinder::ConeBandFinder(int width, int height)
+    : m_rows(static_cast<size_t>(height), 0)
+    , m_columns(static_cast<size_t>(width), 0)
+    , m_occupiedRows(static_cast<size_t>((height + 63) / 64), 0)
+    , m_occupiedColumns(static_cast<size_t>((width + 63) / 64), 0)
+    , m_blobFinder(width, height)
+{
+    m_projections.rows = m_rows.data();
+    m_projections.columns = m_columns.data();
+}
+
+uint32_t ConeBandFinder::peaks(const uint64_t *occupied, int size, const uint16_t *projection, Peak *out) noexcept
+{
+    const int words{(size + 63) / 64};
+    uint32_t count{0};
+    for (int x = 0; x < size;) {
+        // Like the runs of BlobFinder: the next set bit, then the next clear bit after it.
+        int w{x / 64};
+        uint64_t word{occupied[w] & (~0ULL << (x % 64))};
+        while ((0 == word) && (++w < words)) {
+            word = occupied[w];
+        }
+        if (0 == word) {
+            break;
+        }
+        const int first{w * 64 + __builtin_ctzll(word)};
+        w = first / 64;
+        uint64_t clear{~occupied[w] & (~0ULL << (first % 64))};
+        while ((0 == clear) && (++w < words)) {
+            clear = ~occupied[w];
+        }
+        const int last{(0 != clear) ? std::min(w * 64 + __builtin_ctzll(clear), size) : size};
+        if (BlobList::CAPACITY == count) {
+            return count + 1;
+        }
+        Peak &peak = out[count++];
+        peak.first = first;
+        peak.last = last;
+        peak.pixels = 0;
+        peak.moment = 0;
+        for (int i = first; i < last; i++) {
+            peak.pixels += projection[i];
+            peak.moment += static_cast<uint64_t>(i) * projection[i];
+        }
+        x = last;
+    }
+    return count;
+}
+
+bool ConeBandFinder::find(const BitMask &mask, BlobList &blobs, int minimumArea) noexcept
+{
+    m_masks++;
+    blobs.count = 0;
+    blobs.dropped = 0;
+    blobs.small = 0;
+    // Occupied rows from the row projection, occupied columns from all rows of the mask at once.
+    std::fill(m_occupiedRows.begin(), m_occupiedRows.end(), 0);
+    for (int y = 0; y < mask.height(); y++) {
+        m_occupiedRows[static_cast<size_t>(y / 64)] |= static_cast<uint64_t>(0 != m_rows[static_cast<size_t>(y)]) << (y % 64);
+    }
+    const size_t words{mask.wordsPerRow()};
+    uint64_t *occupiedColumns{m_occupiedColumns.data()};
+    std::fill(occupiedColumns, occupiedColumns + words, 0);
+    for (int y = 0; y < mask.height(); y++) {
+        const uint64_t *row{mask.row(y)};
+        for (size_t w = 0; w < words; w++) {
+            occupiedColumns[w] |= row[w];
+        }
+    }
+    const uint32_t bands{peaks(m_occupiedRows.data(), mask.height(), m_rows.data(), m_bands)};
+    const uint32_t runs{peaks(occupiedColumns, mask.width(), m_columns.data(), m_runs)};
+    bool ambiguous{(bands != runs) || (BlobList::CAPACITY < bands)};
+    for (uint32_t i = 0; i < runs && !ambiguous; i++) {
+        m_paired[i] = false;
+    }
+
+    // Bands are disjoint in rows, so top to bottom is the order of BlobFinder.
+    for (uint32_t i = 0; (i < bands) && !ambiguous; i++) {
+        const Peak &band = m_bands[i];
+        // A band pairs up with the run that holds its pixels in the box spanned
+        // by both; runs are disjoint in columns, so at most one run does.
+        uint32_t run{runs};
+        cv::Rect box;
+        for (uint32_t j = 0; (j < runs) && (runs == run); j++) {
+            const Peak &columns = m_runs[j];
+            if (!m_paired[j] && (columns.pixels == band.pixels)) {
+                box = cv::Rect(columns.first, band.first, columns.last - columns.first, band.last - band.first);
+                run = (mask.count(box) == band.pixels) ? j : runs;
+            }
+        }
+        if (runs == run) {
+            ambiguous = true;
+            break;
+        }
+        m_paired[run] = true;
+        if (box.area() <= minimumArea) {
+            blobs.small++;
+            continue;
+        }
+        Blob &blob = blobs.blobs[blobs.count++];
+        blob.box = box;
+        blob.area = band.pixels;
+        blob.cx = static_cast<float>(static_cast<double>(m_runs[run].moment) / band.pixels);
+        blob.cy = static_cast<float>(static_cast<double>(band.moment) / band.pixels);
+    }
+
+    if (ambiguous) {
+        m_fallbacks++;
+        m_blobFinder.find(mask, blobs, minimumArea);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONE_BANDS_HPP
+#define CONE_BANDS_HPP
+
+#include "bit-mask.hpp"
+#include "segmentation-kernels.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Finds the cones of one color from the row and column projections of its
+ * mask instead of tracing every blob: bands of consecutive non-empty rows
+ * and runs of consecutive non-empty columns are the peaks of the two
+ * projections. If there are as many bands as runs and every band pairs up
+ * with a run holding the same number of pixels, all of which lie in the box
+ * spanned by the two (counted with popcounts on the mask), every band is one
+ * cone: cones of one color apart from each other in both directions, as
+ * along the edge of the track.
+ *
+ * Otherwise the projections are ambiguous, e.g. for cones next to each other
+ * in the same rows or overlapping ones, and the blobs of the mask are
+ * extracted with a BlobFinder. Two blobs sharing rows and columns without
+ * touching look like one cone to the projections; their box is the union.
+ */
+class ConeBandFinder {
+   private:
+    ConeBandFinder(const ConeBandFinder &) = delete;
+    ConeBandFinder(ConeBandFinder &&) = delete;
+    ConeBandFinder &operator=(const ConeBandFinder &) = delete;
+    ConeBandFinder &operator=(ConeBandFinder &&) = delete;
+
+   public:
+    ConeBandFinder(int width, int height);
+
+    // Projections to fill by Segmenter::segmentBits for the mask given to find().
+    MaskProjections *projections() noexcept { return &m_projections; }
+
+    /**
+     * Fills blobs with the cones of mask in the order of BlobFinder, leaving
+     * out those with at most minimumArea pixels in their box like BlobFinder.
+     *
+     * @return false if the projections were ambiguous and the blobs were extracted.
+     */
+    bool find(const BitMask &mask, BlobList &blobs, int minimumArea = 0) noexcept;
+
+    // Masks handled by find() and those that needed blob extraction.
+    uint64_t masks() const noexcept { return m_masks; }
+    uint64_t fallbacks() const noexcept { return m_fallbacks; }
+
+   private:
+    struct Peak {
+        int first;
+        int last; // exclusive
+        uint32_t pixels;
+        uint64_t moment;
+    };
+
+    /**
+     * Finds the runs of set bits in occupied (size bits, the rest clear) and
+     * sums up projection over each of them.
+     *
+     * @return Number of peaks, or BlobList::CAPACITY + 1 if there are more.
+     */
+    static uint32_t peaks(const uint64_t *occupied, int size, const uint16_t *projection, Peak *out) noexcept;
+
+   private:
+    std::vector<uint16_t> m_rows;
+    std::vector<uint16_t> m_columns;
+    std::vector<uint64_t> m_occupiedRows;
+    std::vector<uint64_t> m_occupiedColumns;
+    MaskProjections m_projections{};
+    BlobFinder m_blobFinder;
+    Peak m_bands[BlobList::CAPACITY];
+    Peak m_runs[BlobList::CAPACITY];
+    bool m_paired[BlobList::CAPACITY];
+    uint64_t m_masks{0};
+    uint64_t m_fallbacks{0};
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cone-detection.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Color thresholds
+cv::Scalar yellowLow = cv::Scalar(17, 89, 128);
+cv::Scalar yellowHigh = cv::Scalar(35, 175, 216);
+// cv::Scalar blueLow = cv::Scalar(109, 96, 27);
+// cv::Scalar blueHigh = cv::Scalar(120, 189, 86);
+cv::Scalar blueLow = cv::Scalar(70, 43, 34);
+cv::Scalar blueHigh = cv::Scalar(120, 255, 255);
+
+int hLow = 0, hHigh = 179, sLow = 0, sHigh = 255, vLow = 0, vHigh = 255;
+
+// Constants
+const double MAX_ANGLE = 0.290888;                      // Max steering angle for car
+const double ANGLE_MARGIN = MAX_ANGLE * 0.05;           // Angle margin
+const double TURN_VAL =  0.12316760378897237;           // Turning value found through linear regression
+const int DIST_THRESHOLD = 32;                          // Threshold for distances from cone pos to car
+const int BLUR_KERNEL_SIZE = 7;                         // Box filter size applied before the HSV conversion
+const int MIN_BLUE_CONE_AREA = 50;                      // Blue cones have larger bounding boxes
+const int MIN_YELLOW_CONE_AREA = 30;                    // Yellow cones have larger bounding boxes
+
+// Vector of vectors to store points of the 'cones' in HSV filter img.
+std::vector<std::vector<cv::Point>> blueContours;
+std::vector<std::vector<cv::Point>> yellowContours;
+cv::Point centerPoint, blueCone, yellowCone, blueConePrev, yellowConePrev;
+ConeList blueConeList, yellowConeList;
+constexpr uint32_t ConeList::CAPACITY;
+
+// Variables
+double groundSteeringRequest = 0.0;
+double average = 0.0;
+double steeringAngle = 0.0;
+double correct = 0.0, total = 0.0, ourLeft = 0, hisLeft = 0, ourRight = 0, hisRight = 0, avgLeft = 0.0, avgRight = 0.0;
+bool blueInFrame = false, yellowInFrame = false;
+bool foundBlueConeOnce = false, foundYellowConeOnce = false, blueOnLeft = false, yellowOnLeft = false;
+
+// Crop zone of a width x height frame in which the cones are detected
+cv::Rect cropZone(int width, int height)
+{
+    return cv::Rect(
+        0,             // x pos
+        height / 2,    // y pos
+        width - 1,     // rect width
+        (height / 5)); // rect height
+}
+
+// Rows of a frame of the given height that the segmentation of roi reads: roi and the border of the blur
+cv::Range recordedRows(const cv::Rect &roi, int height)
+{
+    return cv::Range(std::max(0, roi.y - BLUR_KERNEL_SIZE / 2), std::min(height, roi.y + roi.height + BLUR_KERNEL_SIZE / 2));
+}
+
+// Calculates the average accuracy of our steering angle
+double steeringAccuracy()
+{
+    // Check if the steering is outside of the 50% margin
+    if (!(steeringAngle < groundSteeringRequest * 0.5 || steeringAngle > groundSteeringRequest * 1.5))
+    {
+        correct++;
+    }
+    if (steeringAngle > 0) {
+        ourLeft++;
+    } else if (steeringAngle < 0) {
+        ourRight++;
+    }
+    if (groundSteeringRequest > 0) {
+        hisLeft++;
+    } else if (groundSteeringRequest < 0) {
+        hisRight++;
+    }
+    total++;
+    average = (correct / total) * 100;
+    avgLeft = (ourLeft / hisLeft) * 100;
+    avgRight = (ourRight / hisRight) * 100;
+    return average;
+}
+
+// Returns distance of object (from center)
+double getDistance(cv::Point pos1, cv::Point pos2)
+{           
+    return sqrt(pow(pos2.x - pos1.x, 2) + pow(pos2.y - pos1.y, 2));
+}
+
+// 1 left, -1 for right
+bool steer(std::string dir, double intensity)
+{
+    int a = dir == "Left" ? 1 : -1;
+    switch (a)
+    {
+    case -1:
+        // Check if we had been turning left, if so reset angle to 0
+        if (steeringAngle > 0)
+        {
+            steeringAngle = 0;
+        }
+        break;
+    case 1:
+        // Check if we had been turning right, if so reset angle to 0
+        if (steeringAngle < 0)
+        {
+            steeringAngle = 0;
+        }
+        break;
+    default:
+        return false;
+    }
+    steeringAngle = a * TURN_VAL * (1 + intensity);
+    if (steeringAngle <= -MAX_ANGLE) {
+        steeringAngle = -MAX_ANGLE;
+    } else if (steeringAngle >= MAX_ANGLE) {
+        steeringAngle = MAX_ANGLE;
+    }
+    return true;
+}
+
+double trackCones()
+{
+    // If both are in frame return 0
+    if (blueInFrame && yellowInFrame) {
+        steeringAngle = 0;
+    } else {
+        double intensity;
+        // If yellow is on the left side
+        // Car is turning clockwise
+        if (yellowOnLeft) {
+            // If only yellow in frame
+            if (yellowInFrame) {
+                intensity = (yellowCone.x / centerPoint.x);
+                // Car is turning counterclockwise
+                if (yellowCone.x > yellowConePrev.x) {
+                    steer("Right", intensity);
+                } else {
+                    steeringAngle = 0;
+                }
+            }
+            else {
+                // This is where more logic is needed
+                // TODO: This is where more logic is needed
+                if (blueInFrame) {
+                    intensity = (centerPoint.x / blueCone.x);
+                    if (blueCone.y == blueConePrev.y) {
+                        // The car has not moved
+                        steeringAngle = 0;
+                    } else if (blueCone.y < blueConePrev.y) {
+                        // New cone targeted
+                    } else {
+                        // Current targeted cone moving closer
+                        steer("Left", intensity);
+                    }
+                }
+            }
+        // If blue is on the left side
+        // Car is turning clockwise
+        } else if (blueOnLeft) {
+            // If only blue in frame
+            if (blueInFrame) {
+                intensity = (blueCone.x / centerPoint.x);
+                if (blueCone.x > blueConePrev.x) {
+                    steer("Right", intensity);
+                } else {
+                    steeringAngle = 0;
+                }
+            } else {
+                // Car is turning counterclockwise
+                // TODO: This is where more logic is needed
+                if (yellowInFrame) {
+                    intensity = (centerPoint.x / yellowCone.x);
+                    if (yellowCone.y == yellowConePrev.y) {
+                        // The car has not moved
+                        steeringAngle = 0;
+                    } else if (yellowCone.y < yellowConePrev.y) {
+                        // New cone targeted
+                    } else {
+                        // Current targeted cone moving closer
+                        steer("Left", intensity);
+                    }
+                }
+            }
+        // If none are in frame return 0
+        } else {
+            steeringAngle = 0;
+        }
+    }
+    // Update prev cone pos's
+    blueConePrev = blueCone;
+    yellowConePrev = yellowCone;
+    // std::cout << steeringAngle
+    //         << ";" << groundSteeringRequest
+    //         << std::endl;
+    steeringAccuracy();
+    return steeringAngle;
+}
+
+// Draws the box of the closest cone and its centre; nothing if drawImage is empty
+static void drawCone(cv::Mat drawImage, const cv::Rect &bBox, cv::Scalar color)
+{
+    if (drawImage.empty()) {
+        return;
+    }
+    cv::rectangle(drawImage, bBox.tl(), bBox.br(), color, 2);
+    cv::putText(
+        drawImage,
+        "(" + std::to_string(bBox.x + (bBox.width / 2)) +
+            "," + std::to_string(bBox.y + (bBox.height / 2)) + ")",
+        cv::Point(bBox.x, bBox.y - 25),
+        5, 1,
+        cv::Scalar(0, 0, 255), 1);
+}
+
+// Method for filtering and creating rectangle around BLUE cones
+bool getBlueCones(cv::Mat detectImage, cv::Mat drawImage, cv::Scalar color)
+{
+    blueInFrame = false;
+    blueConeList.count = 0;
+    cv::Rect prevBox(cv::Point(0, 0), cv::Size(0, 0));
+    cv::findContours(detectImage, blueContours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point());
+    if (blueContours.size() > 0)
+    {
+        blueInFrame = true;
+        for (size_t i = 0; i < blueContours.size(); i++)
+        {
+            cv::Rect bBox = cv::boundingRect(blueContours[i]);
+            // Add some restriction to rectangle size to avoid
+            // duplicate 2x2 rectangles appearing on the same cone
+            if (bBox.area() > MIN_BLUE_CONE_AREA)
+            {
+                if (blueConeList.count < ConeList::CAPACITY)
+                {
+                    blueConeList.boxes[blueConeList.count++] = bBox;
+                }
+                // Only draw a new rect at the closest (bottom-most) cone
+                if (bBox.y > prevBox.y)
+                {
+                    drawCone(drawImage, bBox, color);
+                }
+                prevBox = bBox;
+            }
+        }
+        blueCone = cv::Point(prevBox.x + prevBox.width / 2, prevBox.y + prevBox.height / 2);
+        if(!foundBlueConeOnce) {
+            foundBlueConeOnce = true;
+            blueConePrev = blueCone;
+            if (blueCone.x < centerPoint.x) {
+                blueOnLeft = true;
+                yellowOnLeft = false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// Method for filtering and creating rectangle around YELLOW cones
+bool getYellowCones(cv::Mat detectImage, cv::Mat drawImage, cv::Scalar color)
+{
+    yellowInFrame = false;
+    yellowConeList.count = 0;
+    cv::Rect prevBox(cv::Point(0, 0), cv::Size(0, 0));
+    cv::findContours(detectImage, yellowContours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point());
+    if (yellowContours.size() > 0)
+    {
+        yellowInFrame = true;
+        for (size_t i = 0; i < yellowContours.size(); i++)
+        {
+            cv::Rect bBox = cv::boundingRect(yellowContours[i]);
+            // Add some restriction to rectangle size to avoid
+            // duplicate 2x2 rectangles appearing on the same cone
+            if (bBox.area() > MIN_YELLOW_CONE_AREA)
+            {
+                if (yellowConeList.count < ConeList::CAPACITY)
+                {
+                    yellowConeList.boxes[yellowConeList.count++] = bBox;
+                }
+                // Only draw a new rect at the closest (bottom-most) cone
+                if (bBox.y > prevBox.y)
+                {
+                    drawCone(drawImage, bBox, color);
+                }
+                prevBox = bBox;
+            }
+        }
+        yellowCone = cv::Point(prevBox.x + prevBox.width / 2, prevBox.y + prevBox.height / 2);
+        if(!foundYellowConeOnce) {
+            foundYellowConeOnce = true;
+            yellowConePrev = yellowCone;
+            if (yellowCone.x < centerPoint.x) {
+                blueOnLeft = false;
+                yellowOnLeft = true;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// Method for filtering and creating rectangle around BLUE cones from packed masks
+bool getBlueCones(const BlobList &blobs, cv::Mat drawImage, cv::Scalar color)
+{
+    blueInFrame = false;
+    blueConeList.count = 0;
+    cv::Rect prevBox(cv::Point(0, 0), cv::Size(0, 0));
+    // Like findContours, blobs that are too small for a cone still count as found.
+    if ((blobs.count > 0) || (blobs.small > 0))
+    {
+        blueInFrame = true;
+        // findContours returns the contours from the bottom up; the blobs
+        // are ordered top down, so walk them backwards to pick the same cone.
+        for (uint32_t i = blobs.count; i-- > 0;)
+        {
+            const cv::Rect &bBox = blobs.blobs[i].box;
+            if (bBox.area() > MIN_BLUE_CONE_AREA)
+            {
+                if (blueConeList.count < ConeList::CAPACITY)
+                {
+                    blueConeList.boxes[blueConeList.count++] = bBox;
+                }
+                if (bBox.y > prevBox.y)
+                {
+                    drawCone(drawImage, bBox, color);
+                }
+                prevBox = bBox;
+            }
+        }
+        blueCone = cv::Point(prevBox.x + prevBox.width / 2, prevBox.y + prevBox.height / 2);
+        if(!foundBlueConeOnce) {
+            foundBlueConeOnce = true;
+            blueConePrev = blueCone;
+            if (blueCone.x < centerPoint.x) {
+                blueOnLeft = true;
+                yellowOnLeft = false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// Method for filtering and creating rectangle around YELLOW cones from packed masks
+bool getYellowCones(const BlobList &blobs, cv::Mat drawImage, cv::Scalar color)
+{
+    yellowInFrame = false;
+    yellowConeList.count = 0;
+    cv::Rect prevBox(cv::Point(0, 0), cv::Size(0, 0));
+    if ((blobs.count > 0) || (blobs.small > 0))
+    {
+        yellowInFrame = true;
+        for (uint32_t i = blobs.count; i-- > 0;)
+        {
+            const cv::Rect &bBox = blobs.blobs[i].box;
+            if (bBox.area() > MIN_YELLOW_CONE_AREA)
+            {
+                if (yellowConeList.count < ConeList::CAPACITY)
+                {
+                    yellowConeList.boxes[yellowConeList.count++] = bBox;
+                }
+                if (bBox.y > prevBox.y)
+                {
+                    drawCone(drawImage, bBox, color);
+                }
+                prevBox = bBox;
+            }
+        }
+        yellowCone = cv::Point(prevBox.x + prevBox.width / 2, prevBox.y + prevBox.height / 2);
+        if(!foundYellowConeOnce) {
+            foundYellowConeOnce = true;
+            yellowConePrev = yellowCone;
+            if (yellowCone.x < centerPoint.x) {
+                blueOnLeft = false;
+                yellowOnLeft = true;
+            }
+        }
+        return true;
+    }
+    return false;
+}
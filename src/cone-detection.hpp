@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONE_DETECTION_HPP
+#define CONE_DETECTION_HPP
+
+// Include the image processing header files from OpenCV
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "bit-mask.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Color thresholds
+extern cv::Scalar yellowLow;
+extern cv::Scalar yellowHigh;
+extern cv::Scalar blueLow;
+extern cv::Scalar blueHigh;
+
+extern int hLow, hHigh, sLow, sHigh, vLow, vHigh;
+
+// Constants
+extern const double MAX_ANGLE;                          // Max steering angle for car
+extern const double ANGLE_MARGIN;                       // Angle margin
+extern const double TURN_VAL;                           // Turning value found through linear regression
+extern const int DIST_THRESHOLD;                        // Threshold for distances from cone pos to car
+extern const int BLUR_KERNEL_SIZE;                      // Box filter size applied before the HSV conversion
+extern const int MIN_BLUE_CONE_AREA;                    // Blue cones have larger bounding boxes
+extern const int MIN_YELLOW_CONE_AREA;                  // Yellow cones have larger bounding boxes
+
+// Vector of vectors to store points of the 'cones' in HSV filter img.
+extern std::vector<std::vector<cv::Point>> blueContours;
+extern std::vector<std::vector<cv::Point>> yellowContours;
+extern cv::Point centerPoint, blueCone, yellowCone, blueConePrev, yellowConePrev;
+
+// Bounding boxes (in crop zone coordinates) of all cones found in the current frame.
+struct ConeList {
+    static constexpr uint32_t CAPACITY{32};
+    cv::Rect boxes[CAPACITY];
+    uint32_t count{0};
+};
+extern ConeList blueConeList, yellowConeList;
+
+// Variables
+extern double groundSteeringRequest;
+extern double average;
+extern double steeringAngle;
+extern double correct, total, ourLeft, hisLeft, ourRight, hisRight, avgLeft, avgRight;
+extern bool blueInFrame, yellowInFrame;
+extern bool foundBlueConeOnce, foundYellowConeOnce, blueOnLeft, yellowOnLeft;
+
+// Crop zone of a width x height frame in which the cones are detected
+cv::Rect cropZone(int width, int height);
+
+// Rows of a frame of the given height that the segmentation of roi reads: roi and the border of the blur
+cv::Range recordedRows(const cv::Rect &roi, int height);
+
+// Calculates the average accuracy of our steering angle
+double steeringAccuracy();
+
+// Returns distance of object (from center)
+double getDistance(cv::Point pos1, cv::Point pos2);
+
+// 1 left, -1 for right
+bool steer(std::string dir, double intensity);
+
+// Computes the steering angle from the cones found in the current frame
+double trackCones();
+
+// Method for filtering and creating rectangle around BLUE cones; nothing is drawn if drawImage is empty
+bool getBlueCones(cv::Mat detectImage, cv::Mat drawImage, cv::Scalar color);
+
+// Method for filtering and creating rectangle around YELLOW cones; nothing is drawn if drawImage is empty
+bool getYellowCones(cv::Mat detectImage, cv::Mat drawImage, cv::Scalar color);
+
+// Same as above for the blobs of a BitMask instead of the contours of a
+// byte mask. Unlike findContours
+// with RETR_EXTERNAL, blobs inside holes of other blobs are kept. Find the
+// blobs with MIN_BLUE_CONE_AREA or MIN_YELLOW_CONE_AREA, so that specks do
+// not take the places of cones in the BlobList.
+bool getBlueCones(const BlobList &blobs, cv::Mat drawImage, cv::Scalar color);
+bool getYellowCones(const BlobList &blobs, cv::Mat drawImage, cv::Scalar color);
+
+#endif
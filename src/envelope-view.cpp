@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "envelope-view.hpp"
+
+namespace {
+
+// Protobuf wire types as used by cluon::ToProtoVisitor.
+enum WireType : uint8_t {
+    VARINT = 0,
+    FIXED64 = 1,
+    LENGTH_DELIMITED = 2,
+    FIXED32 = 5,
+};
+
+bool readVarInt(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (uint32_t shift = 0; (p < end) && (shift < 64); shift += 7) {
+        const uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (0 == (byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline int32_t fromZigZag32(uint64_t v)
+{
+    const uint32_t u = static_cast<uint32_t>(v);
+    return static_cast<int32_t>((u >> 1) ^ (~(u & 1) + 1));
+}
+
+// Skips the value of a field with the given wire type.
+bool skipField(const uint8_t *&p, const uint8_t *end, uint8_t wireType)
+{
+    uint64_t length{0};
+    switch (wireType) {
+        case VARINT:
+            return readVarInt(p, end, length);
+        case FIXED64:
+            length = 8;
+            break;
+        case FIXED32:
+            length = 4;
+            break;
+        case LENGTH_DELIMITED:
+            if (!readVarInt(p, end, length)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    if (length > static_cast<uint64_t>(end - p)) {
+        return false;
+    }
+    p += length;
+    return true;
+}
+
+// Decodes a cluon::data::TimeStamp (seconds = 1, microseconds = 2) into microseconds.
+bool decodeTimeStamp(const uint8_t *p, const uint8_t *end, int64_t &microseconds)
+{
+    int32_t seconds{0}, micros{0};
+    while (p < end) {
+        uint64_t key{0}, value{0};
+        if (!readVarInt(p, end, key)) {
+            return false;
+        }
+        const uint8_t wireType = static_cast<uint8_t>(key & 0x7);
+        const uint64_t field = key >> 3;
+        if ((VARINT == wireType) && ((1 == field) || (2 == field))) {
+            if (!readVarInt(p, end, value)) {
+                return false;
+            }
+            ((1 == field) ? seconds : micros) = fromZigZag32(value);
+        } else if (!skipField(p, end, wireType)) {
+            return false;
+        }
+    }
+    microseconds = static_cast<int64_t>(seconds) * 1000 * 1000 + micros;
+    return true;
+}
+
+} // namespace
+
+bool decodeEnvelopeView(const char *data, size_t size, EnvelopeView &view)
+{
+    view = EnvelopeView();
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    const uint8_t *end = p + size;
+    while (p < end) {
+        uint64_t key{0}, value{0};
+        if (!readVarInt(p, end, key)) {
+            return false;
+        }
+        const uint8_t wireType = static_cast<uint8_t>(key & 0x7);
+        const uint64_t field = key >> 3;
+        if ((VARINT == wireType) && ((1 == field) || (6 == field))) {
+            if (!readVarInt(p, end, value)) {
+                return false;
+            }
+            if (1 == field) {
+                view.dataType = fromZigZag32(value);
+            } else {
+                view.senderStamp = static_cast<uint32_t>(value);
+            }
+        } else if ((LENGTH_DELIMITED == wireType) && (2 <= field) && (field <= 5)) {
+            if (!readVarInt(p, end, value) || (value > static_cast<uint64_t>(end - p))) {
+                return false;
+            }
+            const uint8_t *fieldEnd = p + value;
+            if (2 == field) {
+                view.serializedData = reinterpret_cast<const char *>(p);
+                view.serializedDataSize = static_cast<size_t>(value);
+            } else {
+                int64_t &timeStamp = (3 == field) ? view.sent : ((4 == field) ? view.received : view.sampleTimeStamp);
+                if (!decodeTimeStamp(p, fieldEnd, timeStamp)) {
+                    return false;
+                }
+            }
+            p = fieldEnd;
+        } else if (!skipField(p, end, wireType)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool decodeOD4Header(const char *data, uint32_t &length)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    if ((0x0D != p[0]) || (0xA4 != p[1])) {
+        return false;
+    }
+    length = static_cast<uint32_t>(p[2]) | (static_cast<uint32_t>(p[3]) << 8) | (static_cast<uint32_t>(p[4]) << 16);
+    return true;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENVELOPE_VIEW_HPP
+#define ENVELOPE_VIEW_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Size of the OD4 header (0x0D 0xA4 and the 3 byte little-endian length) in front of every Envelope.
+constexpr size_t OD4_HEADER_SIZE{5};
+
+/**
+ * Fields of a cluon::data::Envelope decoded without copying: serializedData
+ * points into the buffer that was decoded and is only valid as long as it.
+ * Time stamps are in microseconds.
+ */
+struct EnvelopeView {
+    int32_t dataType{0};
+    uint32_t senderStamp{0};
+    int64_t sent{0};
+    int64_t received{0};
+    int64_t sampleTimeStamp{0};
+    const char *serializedData{nullptr};
+    size_t serializedDataSize{0};
+};
+
+/**
+ * Decodes the Protobuf encoded Envelope (without OD4 header) in
+ * [data, data + size) like cluon::FromProtoVisitor; unknown fields are skipped.
+ *
+ * @return false if the buffer is truncated or malformed.
+ */
+bool decodeEnvelopeView(const char *data, size_t size, EnvelopeView &view);
+
+/**
+ * Reads the OD4 header at data.
+ *
+ * @param data At least OD4_HEADER_SIZE bytes.
+ * @param length Length of the Envelope following the header.
+ * @return false if data does not start with 0x0D 0xA4.
+ */
+bool decodeOD4Header(const char *data, uint32_t &length);
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "event-loop.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+EventLoop::EventLoop()
+{
+    m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    m_stop = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((m_epoll < 0) || (m_stop < 0)) {
+        std::cerr << "[EventLoop] Error while creating epoll: " << ::strerror(errno) << std::endl;
+        return;
+    }
+    // The stop notification is the only source without a Source; its data is nullptr.
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (0 != ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_stop, &event)) {
+        std::cerr << "[EventLoop] Error while adding the stop notification: " << ::strerror(errno) << std::endl;
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    for (auto &source : m_sources) {
+        if (source->ownsFd) {
+            ::close(source->fd);
+        }
+    }
+    if (!(m_stop < 0)) {
+        ::close(m_stop);
+    }
+    if (!(m_epoll < 0)) {
+        ::close(m_epoll);
+    }
+}
+
+bool EventLoop::valid() const
+{
+    return !(m_epoll < 0) && !(m_stop < 0);
+}
+
+bool EventLoop::add(std::unique_ptr<Source> &&source)
+{
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = source.get();
+    if (!valid() || (0 != ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, source->fd, &event))) {
+        std::cerr << "[EventLoop] Error while adding file descriptor " << source->fd << ": " << ::strerror(errno) << std::endl;
+        return false;
+    }
+    m_sources.push_back(std::move(source));
+    return true;
+}
+
+bool EventLoop::addReadable(int fd, std::function<void()> callback)
+{
+    std::unique_ptr<Source> source{new Source()};
+    source->fd = fd;
+    source->callback = std::move(callback);
+    return add(std::move(source));
+}
+
+int EventLoop::addTimer(std::chrono::microseconds period, std::function<void(uint64_t expirations)> callback)
+{
+    const int fd{::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)};
+    if (fd < 0) {
+        std::cerr << "[EventLoop] Error while creating a timer: " << ::strerror(errno) << std::endl;
+        return -1;
+    }
+    struct itimerspec timer {};
+    timer.it_interval.tv_sec = static_cast<time_t>(period.count() / (1000 * 1000));
+    timer.it_interval.tv_nsec = static_cast<long>((period.count() % (1000 * 1000)) * 1000);
+    timer.it_value = timer.it_interval;
+    ::timerfd_settime(fd, 0, &timer, nullptr);
+
+    std::unique_ptr<Source> source{new Source()};
+    source->fd = fd;
+    source->ownsFd = true;
+    source->callback = [fd, callback]() {
+        uint64_t expirations{0};
+        if ((sizeof(expirations) == ::read(fd, &expirations, sizeof(expirations))) && (nullptr != callback)) {
+            callback(expirations);
+        }
+    };
+    if (!add(std::move(source))) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void EventLoop::remove(int fd)
+{
+    // Events for the source may still be pending in the current wake-up; it
+    // is only marked then and erased after the callbacks.
+    for (auto &source : m_sources) {
+        if ((source->fd == fd) && !source->removed) {
+            ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            if (source->ownsFd) {
+                ::close(fd);
+            }
+            source->removed = true;
+        }
+    }
+    if (!m_dispatching) {
+        m_sources.erase(std::remove_if(m_sources.begin(), m_sources.end(), [](const std::unique_ptr<Source> &s) { return s->removed; }),
+                        m_sources.end());
+    }
+}
+
+void EventLoop::run()
+{
+    constexpr int MAX_EVENTS{16};
+    struct epoll_event events[MAX_EVENTS];
+    while (valid() && !m_stopped.load()) {
+        const int count{::epoll_wait(m_epoll, events, MAX_EVENTS, -1)};
+        if (0 > count) {
+            if (EINTR != errno) {
+                std::cerr << "[EventLoop] epoll_wait failed: " << ::strerror(errno) << std::endl;
+                break;
+            }
+            continue;
+        }
+        m_wakeUps++;
+        m_dispatching = true;
+        for (int i = 0; i < count; i++) {
+            Source *source{static_cast<Source *>(events[i].data.ptr)};
+            if (nullptr == source) {
+                uint64_t value{0};
+                if (0 < ::read(m_stop, &value, sizeof(value))) {
+                    m_stopped.store(true);
+                }
+            } else if (!source->removed && (nullptr != source->callback)) {
+                source->callback();
+            }
+        }
+        m_dispatching = false;
+        m_sources.erase(std::remove_if(m_sources.begin(), m_sources.end(), [](const std::unique_ptr<Source> &s) { return s->removed; }),
+                        m_sources.end());
+    }
+    m_stopped.store(false);
+}
+
+void EventLoop::stop()
+{
+    const uint64_t one{1};
+    if (sizeof(one) != ::write(m_stop, &one, sizeof(one))) {
+        std::cerr << "[EventLoop] Error while stopping: " << ::strerror(errno) << std::endl;
+    }
+}
+
+uint64_t EventLoop::wakeUps() const
+{
+    return m_wakeUps;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Single-threaded event loop on epoll for Linux. It waits on any number of
+ * readable file descriptors (UDP sockets, eventfds of frame sources, ...)
+ * and periodic timers at once and calls their callbacks on the thread that
+ * runs the loop, so that one thread serves several sources instead of one
+ * blocking thread per source. stop() may be called from any thread.
+ *
+ * Sources are level-triggered: a callback must consume what made its file
+ * descriptor readable or it is called again right away.
+ */
+class EventLoop {
+   private:
+    EventLoop(const EventLoop &) = delete;
+    EventLoop(EventLoop &&) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+    EventLoop &operator=(EventLoop &&) = delete;
+
+   public:
+    EventLoop();
+    ~EventLoop();
+
+    // Returns true if epoll and the stop notification could be created.
+    bool valid() const;
+
+    /**
+     * Calls callback whenever fd is readable; the caller keeps owning fd.
+     *
+     * @return false if fd could not be added.
+     */
+    bool addReadable(int fd, std::function<void()> callback);
+
+    /**
+     * Calls callback every period, starting one period from now. Expirations
+     * missed while a callback ran are passed on.
+     *
+     * @return File descriptor of the timer to remove it, or -1.
+     */
+    int addTimer(std::chrono::microseconds period, std::function<void(uint64_t expirations)> callback);
+
+    // Removes a source added by addReadable or addTimer; timers are closed.
+    void remove(int fd);
+
+    // Dispatches events until stop() is called.
+    void run();
+
+    // Makes run() return after the callbacks of the current wake-up.
+    void stop();
+
+    // Number of times epoll_wait returned with events.
+    uint64_t wakeUps() const;
+
+   private:
+    struct Source {
+        int fd{-1};
+        bool ownsFd{false};
+        bool removed{false};
+        std::function<void()> callback{nullptr};
+    };
+
+    bool add(std::unique_ptr<Source> &&source);
+
+   private:
+    int m_epoll{-1};
+    int m_stop{-1};
+    std::atomic<bool> m_stopped{false};
+    uint64_t m_wakeUps{0};
+    bool m_dispatching{false};
+    std::vector<std::unique_ptr<Source>> m_sources{};
+};
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "frame-cache.hpp"
+#include "proto-view.hpp"
+#include "recorder.hpp"
+#include "replay-decoder.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr char FRAME_CACHE_MAGIC[8] = {'F', 'R', 'M', 'C', 'A', 'C', 'H', 'E'};
+constexpr uint32_t FRAME_CACHE_VERSION{1};
+// Frames start on a page and rows of consecutive frames on a cache line.
+constexpr uint64_t PAGE_SIZE_ALIGNMENT{4096};
+constexpr uint64_t CACHE_LINE_ALIGNMENT{64};
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+FrameCache::FrameCache(const std::string &file)
+{
+    m_fd = ::open(file.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        std::clog << "[FrameCache]: " << file << " could not be opened: " << ::strerror(errno) << std::endl;
+        return;
+    }
+    struct stat status;
+    if ((0 != ::fstat(m_fd, &status)) || (static_cast<size_t>(status.st_size) < sizeof(FrameCacheHeader))) {
+        std::clog << "[FrameCache]: " << file << " is too small or cannot be accessed." << std::endl;
+        return;
+    }
+    m_size = static_cast<size_t>(status.st_size);
+
+    void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == data) {
+        std::clog << "[FrameCache]: " << file << " could not be mapped: " << ::strerror(errno) << std::endl;
+        m_size = 0;
+        return;
+    }
+    m_data = static_cast<const char *>(data);
+
+    const auto *header = reinterpret_cast<const FrameCacheHeader *>(m_data);
+    const uint64_t frameSize{static_cast<uint64_t>(header->width) * header->rows * 4};
+    if ((0 != std::memcmp(header->magic, FRAME_CACHE_MAGIC, sizeof(FRAME_CACHE_MAGIC))) || (FRAME_CACHE_VERSION != header->version) ||
+        (sizeof(FrameCacheHeader) != header->headerSize) || (header->firstRow + header->rows > header->height) ||
+        (header->frameStride < frameSize) || (header->indexOffset + header->frames * sizeof(FrameCacheEntry) > m_size) ||
+        ((0 != header->frames) && (header->framesOffset + (header->frames - 1) * header->frameStride + frameSize > m_size))) {
+        std::clog << "[FrameCache]: " << file << " is no frame cache of this version or truncated." << std::endl;
+        return;
+    }
+    m_header = header;
+    m_entries = reinterpret_cast<const FrameCacheEntry *>(m_data + header->indexOffset);
+}
+
+FrameCache::~FrameCache()
+{
+    if (nullptr != m_data) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool FrameCache::valid() const
+{
+    return nullptr != m_header;
+}
+
+cv::Mat FrameCache::frame(size_t i) const
+{
+    char *pixels{const_cast<char *>(m_data + m_header->framesOffset + i * m_header->frameStride)};
+    return cv::Mat(static_cast<int>(m_header->rows), static_cast<int>(m_header->width), CV_8UC4, pixels);
+}
+
+cv::Rect FrameCache::crop(const cv::Rect &roi) const
+{
+    const int firstRow{static_cast<int>(m_header->firstRow)};
+    if ((roi.y < firstRow) || (roi.y + roi.height > firstRow + static_cast<int>(m_header->rows)) ||
+        (roi.x < 0) || (roi.x + roi.width > static_cast<int>(m_header->width))) {
+        return cv::Rect();
+    }
+    return cv::Rect(roi.x, roi.y - firstRow, roi.width, roi.height);
+}
+
+int64_t writeFrameCache(const std::string &file, const Recording &recording, int width, int height, int firstRow, int rows,
+                        uint32_t workers)
+{
+    const std::vector<RecordingEntry> order{recordedOrder(recording)};
+    uint64_t capacity{0};
+    for (const auto &entry : order) {
+        capacity += (opendlv::proxy::ImageReading::ID() == entry.dataType) ? 1 : 0;
+    }
+
+    FrameCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FRAME_CACHE_MAGIC, sizeof(FRAME_CACHE_MAGIC));
+    header.version = FRAME_CACHE_VERSION;
+    header.headerSize = sizeof(FrameCacheHeader);
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.firstRow = static_cast<uint32_t>(firstRow);
+    header.rows = static_cast<uint32_t>(rows);
+    header.indexOffset = alignUp(sizeof(FrameCacheHeader), CACHE_LINE_ALIGNMENT);
+    // Room for an entry per ImageReading; the frames that cannot be decoded leave it partly unused.
+    header.framesOffset = alignUp(header.indexOffset + capacity * sizeof(FrameCacheEntry), PAGE_SIZE_ALIGNMENT);
+    const size_t frameSize{static_cast<size_t>(width) * static_cast<size_t>(rows) * 4};
+    header.frameStride = alignUp(frameSize, CACHE_LINE_ALIGNMENT);
+
+    std::ofstream out(file, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.good()) {
+        std::cerr << "[FrameCache] Could not create " << file << "." << std::endl;
+        return -1;
+    }
+
+    std::vector<FrameCacheEntry> index;
+    index.reserve(capacity);
+    const std::vector<char> padding(header.frameStride - frameSize, 0);
+    float groundSteering{std::numeric_limits<float>::quiet_NaN()};
+    // Whether the last frame was cached and still waits for its recorded steering angle.
+    bool awaitingSteering{false};
+    out.seekp(static_cast<std::streamoff>(header.framesOffset));
+    ReplayDecoder decoder{recording, order, width, height, workers};
+    for (const ReplayDecoder::Item *item = decoder.next(); nullptr != item; item = decoder.next()) {
+        if (item->frame) {
+            awaitingSteering = false;
+            if (!item->decoded || (item->decodedRows.y > firstRow) || (item->decodedRows.y + item->decodedRows.height < firstRow + rows)) {
+                continue;
+            }
+            const auto *pixels = reinterpret_cast<const char *>(item->image.ptr<uint8_t>(firstRow));
+            out.write(pixels, static_cast<std::streamsize>(frameSize));
+            out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+            index.push_back(FrameCacheEntry{item->envelope.sampleTimeStamp, groundSteering, std::numeric_limits<float>::quiet_NaN()});
+            awaitingSteering = true;
+        } else if (opendlv::proxy::GroundSteeringRequest::ID() == item->envelope.dataType) {
+            opendlv::proxy::GroundSteeringRequest request;
+            if (!decodeMessage(item->envelope, request)) {
+                continue;
+            }
+            if (RECORDED_STEERING_SENDER_STAMP != item->envelope.senderStamp) {
+                groundSteering = request.groundSteering();
+            } else if (awaitingSteering) {
+                // Recorded after the frame it was computed for.
+                index.back().recordedSteering = request.groundSteering();
+                awaitingSteering = false;
+            }
+        }
+    }
+
+    header.frames = index.size();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.seekp(static_cast<std::streamoff>(header.indexOffset));
+    out.write(reinterpret_cast<const char *>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(FrameCacheEntry)));
+    out.close();
+    if (out.fail()) {
+        std::cerr << "[FrameCache] Could not write " << file << "." << std::endl;
+        return -1;
+    }
+    return static_cast<int64_t>(index.size());
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CACHE_HPP
+#define FRAME_CACHE_HPP
+
+#include "recording.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Layout of a frame cache: decoded frames of a recording, cropped to the rows
+ * the segmentation reads, for experiments that process the same recording
+ * again and again. The file is written in the byte order of the machine and
+ * is used by mapping it; nothing is parsed:
+ *
+ * - FrameCacheHeader at offset 0,
+ * - FrameCacheEntry[frames] at indexOffset,
+ * - frames at framesOffset (page aligned), frameStride bytes apart, each with
+ *   rows x width pixels of 4 bytes from row firstRow of the original frame.
+ */
+struct FrameCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t width;             // Width of the original frames.
+    uint32_t height;            // Height of the original frames.
+    uint32_t firstRow;          // First row of the original frames that is cached.
+    uint32_t rows;              // Rows cached per frame.
+    uint64_t frames;
+    uint64_t indexOffset;
+    uint64_t framesOffset;
+    uint64_t frameStride;
+};
+
+struct FrameCacheEntry {
+    int64_t sampleTimeStamp;    // Microseconds.
+    float groundSteering;       // Latest received opendlv.proxy.GroundSteeringRequest before the frame; NaN if none.
+    float recordedSteering;     // Steering angle recorded by steering --record for the frame; NaN if none.
+};
+
+/**
+ * Read-only frame cache that is memory-mapped; frames are handed out as
+ * cv::Mat headers pointing into the mapping.
+ */
+class FrameCache {
+   private:
+    FrameCache(const FrameCache &) = delete;
+    FrameCache(FrameCache &&) = delete;
+    FrameCache &operator=(const FrameCache &) = delete;
+    FrameCache &operator=(FrameCache &&) = delete;
+
+   public:
+    explicit FrameCache(const std::string &file);
+    ~FrameCache();
+
+    // Returns true if the file is a complete frame cache.
+    bool valid() const;
+
+    const FrameCacheHeader &header() const { return *m_header; }
+    size_t size() const { return static_cast<size_t>(m_header->frames); }
+    const FrameCacheEntry &entry(size_t i) const { return m_entries[i]; }
+
+    // Cached rows of frame i (CV_8UC4, read-only).
+    cv::Mat frame(size_t i) const;
+
+    /**
+     * Returns the part of the cached rows that corresponds to roi of the
+     * original frame, or an empty cv::Rect if roi is not cached.
+     */
+    cv::Rect crop(const cv::Rect &roi) const;
+
+   private:
+    int m_fd{-1};
+    size_t m_size{0};
+    const char *m_data{nullptr};
+    const FrameCacheHeader *m_header{nullptr};
+    const FrameCacheEntry *m_entries{nullptr};
+};
+
+/**
+ * Decodes the frames of a recording of steering --record in the order they
+ * were consumed and writes rows [firstRow, firstRow + rows) of each into a
+ * frame cache; frames that do not contain these rows are skipped.
+ *
+ * @param workers Decoding threads; one per core if 0.
+ * @return Number of cached frames, or -1 if the cache could not be written.
+ */
+int64_t writeFrameCache(const std::string &file, const Recording &recording, int width, int height, int firstRow, int rows,
+                        uint32_t workers = 0);
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame-codec.hpp"
+
+// imencode and imdecode; part of highgui before OpenCV 3
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstring>
+
+namespace {
+
+// Parameters of the LZ4 block format.
+constexpr size_t MIN_MATCH{4};
+// The last 5 bytes are always literals and the last match starts at least 12 bytes before the end.
+constexpr size_t LAST_LITERALS{5};
+constexpr size_t MATCH_FIND_LIMIT{12};
+constexpr size_t MAX_OFFSET{65535};
+constexpr uint32_t HASH_BITS{12};
+
+inline uint32_t read32(const uint8_t *p) noexcept
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash(uint32_t sequence) noexcept
+{
+    return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// Appends a length that did not fit into its 4 bits of the token.
+inline uint8_t *writeLength(uint8_t *out, size_t length) noexcept
+{
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+inline bool readLength(const uint8_t *in, size_t size, size_t &position, size_t &length) noexcept
+{
+    uint8_t byte;
+    do {
+        if (position >= size) {
+            return false;
+        }
+        byte = in[position++];
+        length += byte;
+    } while (255 == byte);
+    return true;
+}
+
+// Copies the rows of an encoded image of the same geometry into frame.
+bool copyRows(const cv::Mat &rows, cv::Mat &frame)
+{
+    if ((rows.type() != CV_8UC4) || (rows.cols != frame.cols) || (rows.rows != frame.rows)) {
+        return false;
+    }
+    const size_t rowSize{static_cast<size_t>(frame.cols) * 4};
+    for (int y = 0; y < rows.rows; y++) {
+        std::memcpy(frame.ptr<uint8_t>(y), rows.ptr<uint8_t>(y), rowSize);
+    }
+    return true;
+}
+
+} // namespace
+
+bool parseFrameCodec(const std::string &name, FrameCodec &codec)
+{
+    if ("png" == name) {
+        codec = FrameCodec::PNG;
+    } else if (("jpeg" == name) || ("jpg" == name)) {
+        codec = FrameCodec::JPEG;
+    } else if ("lz4" == name) {
+        codec = FrameCodec::LZ4;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *fourccOf(FrameCodec codec)
+{
+    switch (codec) {
+        case FrameCodec::JPEG: return FOURCC_JPEG;
+        case FrameCodec::LZ4: return FOURCC_LZ4;
+        default: return FOURCC_PNG;
+    }
+}
+
+bool encodeFrame(FrameCodec codec, const cv::Mat &frame, std::vector<uint8_t> &encoded, cv::Mat &scratch)
+{
+    switch (codec) {
+        case FrameCodec::JPEG:
+            cv::cvtColor(frame, scratch, cv::COLOR_BGRA2BGR);
+            return cv::imencode(".jpg", scratch, encoded, {cv::IMWRITE_JPEG_QUALITY, 90});
+        case FrameCodec::LZ4:
+            if (frame.isContinuous()) {
+                lz4Compress(frame.data, frame.total() * 4, encoded);
+            } else {
+                scratch = frame.clone();
+                lz4Compress(scratch.data, scratch.total() * 4, encoded);
+            }
+            return true;
+        default:
+            // PNG keeps the pixels including the alpha channel bit-exact.
+            return cv::imencode(".png", frame, encoded, {cv::IMWRITE_PNG_COMPRESSION, 1});
+    }
+}
+
+bool decodeFrame(const std::string &fourcc, const std::string &data, cv::Mat &frame)
+{
+    const cv::Mat encoded(1, static_cast<int>(data.size()), CV_8UC1, const_cast<char *>(data.data()));
+    if (FOURCC_PNG == fourcc) {
+        return copyRows(cv::imdecode(encoded, cv::IMREAD_UNCHANGED), frame);
+    }
+    if (FOURCC_JPEG == fourcc) {
+        const cv::Mat bgr{cv::imdecode(encoded, cv::IMREAD_COLOR)};
+        if (bgr.empty()) {
+            return false;
+        }
+        cv::Mat bgra;
+        cv::cvtColor(bgr, bgra, cv::COLOR_BGR2BGRA);
+        return copyRows(bgra, frame);
+    }
+    if (FOURCC_LZ4 == fourcc) {
+        const auto *compressed = reinterpret_cast<const uint8_t *>(data.data());
+        if (frame.isContinuous()) {
+            return lz4Decompress(compressed, data.size(), frame.data, frame.total() * 4);
+        }
+        cv::Mat rows(frame.rows, frame.cols, CV_8UC4);
+        return lz4Decompress(compressed, data.size(), rows.data, rows.total() * 4) && copyRows(rows, frame);
+    }
+    return false;
+}
+
+void lz4Compress(const uint8_t *source, size_t size, std::vector<uint8_t> &compressed)
+{
+    // Worst case: everything is literals.
+    compressed.resize(size + size / 255 + 16);
+    uint8_t *out{compressed.data()};
+    size_t anchor{0};
+
+    if (size > MATCH_FIND_LIMIT) {
+        uint32_t table[1U << HASH_BITS] = {0};
+        const size_t matchLimit{size - LAST_LITERALS};
+        const size_t searchLimit{size - MATCH_FIND_LIMIT};
+        size_t position{1};
+        while (position < searchLimit) {
+            const uint32_t sequence{read32(source + position)};
+            const uint32_t h{hash(sequence)};
+            const size_t candidate{table[h]};
+            table[h] = static_cast<uint32_t>(position);
+            if ((position - candidate > MAX_OFFSET) || (read32(source + candidate) != sequence)) {
+                // Skip faster through data that does not compress.
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+            size_t length{MIN_MATCH};
+            while ((position + length < matchLimit) && (source[candidate + length] == source[position + length])) {
+                length++;
+            }
+
+            const size_t literals{position - anchor};
+            uint8_t *token{out++};
+            if (literals >= 15) {
+                *token = 15 << 4;
+                out = writeLength(out, literals - 15);
+            } else {
+                *token = static_cast<uint8_t>(literals << 4);
+            }
+            std::memcpy(out, source + anchor, literals);
+            out += literals;
+            const size_t offset{position - candidate};
+            *out++ = static_cast<uint8_t>(offset);
+            *out++ = static_cast<uint8_t>(offset >> 8);
+            if (length - MIN_MATCH >= 15) {
+                *token |= 15;
+                out = writeLength(out, length - MIN_MATCH - 15);
+            } else {
+                *token |= static_cast<uint8_t>(length - MIN_MATCH);
+            }
+            position += length;
+            anchor = position;
+        }
+    }
+
+    // The last sequence has only literals.
+    const size_t literals{size - anchor};
+    if (literals >= 15) {
+        *out++ = 15 << 4;
+        out = writeLength(out, literals - 15);
+    } else {
+        *out++ = static_cast<uint8_t>(literals << 4);
+    }
+    std::memcpy(out, source + anchor, literals);
+    out += literals;
+    compressed.resize(static_cast<size_t>(out - compressed.data()));
+}
+
+bool lz4Decompress(const uint8_t *compressed, size_t compressedSize, uint8_t *destination, size_t size) noexcept
+{
+    size_t in{0}, out{0};
+    while (in < compressedSize) {
+        const uint8_t token{compressed[in++]};
+        size_t literals{static_cast<size_t>(token >> 4)};
+        if ((15 == literals) && !readLength(compressed, compressedSize, in, literals)) {
+            return false;
+        }
+        if ((literals > compressedSize - in) || (literals > size - out)) {
+            return false;
+        }
+        std::memcpy(destination + out, compressed + in, literals);
+        in += literals;
+        out += literals;
+        if (in == compressedSize) {
+            break;
+        }
+
+        if (2 > compressedSize - in) {
+            return false;
+        }
+        const size_t offset{static_cast<size_t>(compressed[in]) | (static_cast<size_t>(compressed[in + 1]) << 8)};
+        in += 2;
+        size_t length{static_cast<size_t>(token & 15)};
+        if ((15 == length) && !readLength(compressed, compressedSize, in, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if ((0 == offset) || (offset > out) || (length > size - out)) {
+            return false;
+        }
+        const uint8_t *match{destination + out - offset};
+        if (offset >= length) {
+            std::memcpy(destination + out, match, length);
+        } else {
+            // Overlapping matches repeat the last offset bytes.
+            for (size_t i = 0; i < length; i++) {
+                destination[out + i] = match[i];
+            }
+        }
+        out += length;
+    }
+    return out == size;
+}
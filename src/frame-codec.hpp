@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CODEC_HPP
+#define FRAME_CODEC_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compression of recorded frames in opendlv.proxy.ImageReading.
+enum class FrameCodec {
+    PNG,  // Lossless but slow to encode.
+    JPEG, // Lossy (quality 90) without alpha channel, so replays are not bit-exact; smallest.
+    LZ4,  // Lossless LZ4 block of the raw pixels; fastest but compresses the least.
+};
+
+// FOURCCs in opendlv.proxy.ImageReading.
+constexpr const char *FOURCC_PNG{"MPNG"};
+constexpr const char *FOURCC_JPEG{"MJPG"};
+constexpr const char *FOURCC_LZ4{"LZ4R"};
+
+// Parses png, jpeg or lz4; returns false for anything else.
+bool parseFrameCodec(const std::string &name, FrameCodec &codec);
+
+const char *fourccOf(FrameCodec codec);
+
+/**
+ * Encodes frame (CV_8UC4) with codec.
+ *
+ * @param encoded Receives the encoded frame; reused between calls.
+ * @param scratch Intermediate image for codecs that need one; reused between calls.
+ */
+bool encodeFrame(FrameCodec codec, const cv::Mat &frame, std::vector<uint8_t> &encoded, cv::Mat &scratch);
+
+/**
+ * Decodes a frame encoded by encodeFrame into frame (CV_8UC4), which must
+ * already have the size of the encoded frame; frame may be a view into a
+ * larger image.
+ *
+ * @return false for an unknown FOURCC, corrupt data or a size mismatch.
+ */
+bool decodeFrame(const std::string &fourcc, const std::string &data, cv::Mat &frame);
+
+/**
+ * Compresses size bytes at source into an LZ4 block (no frame header), which
+ * the reference lz4 library can decompress with LZ4_decompress_safe.
+ */
+void lz4Compress(const uint8_t *source, size_t size, std::vector<uint8_t> &compressed);
+
+// Decompresses an LZ4 block that must expand to exactly size bytes.
+bool lz4Decompress(const uint8_t *compressed, size_t compressedSize, uint8_t *destination, size_t size) noexcept;
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// The notifier waits on the condition variable and the semaphore inside
+// cluon::SharedMemory, whose layout is only known for libcluon v0.0.127;
+// check SharedMemoryHeaderPOSIX and ID_SEM_AS_CONDITION before updating it.
+#include "frame-notifier.hpp"
+
+#ifndef CLUON_COMPLETE_V0_0_127
+#error "FrameNotifier depends on the layout of cluon::SharedMemory in libcluon v0.0.127."
+#endif
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+namespace {
+
+// Header that cluon::SharedMemory (POSIX, libcluon v0.0.127) puts in front
+// of data(); its condition variable is the one notifyAll() broadcasts.
+struct SharedMemoryHeaderPOSIX {
+    uint32_t size;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+};
+
+// Project identifier of the semaphore that cluon::SharedMemory (SysV) uses as condition variable.
+constexpr int ID_SEM_AS_CONDITION{3};
+
+// How long the bridge waits before it checks whether it was stopped.
+constexpr std::chrono::milliseconds BRIDGE_TIMEOUT{20};
+
+} // namespace
+
+FrameNotifier::FrameNotifier(cluon::SharedMemory &sharedMemory, FrameSignal *signal)
+    : m_sharedMemory{sharedMemory}
+    , m_signal{((nullptr != signal) && signal->valid()) ? signal : nullptr}
+{
+    m_eventFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_eventFd < 0) {
+        std::cerr << "[FrameNotifier] Error while creating eventfd: " << ::strerror(errno) << std::endl;
+        return;
+    }
+    if (nullptr == m_signal) {
+        // Same choice of implementation as cluon::SharedMemory.
+        const char *CLUON_SHAREDMEMORY_POSIX{::getenv("CLUON_SHAREDMEMORY_POSIX")};
+        m_posix = ((nullptr != CLUON_SHAREDMEMORY_POSIX) && ('1' == CLUON_SHAREDMEMORY_POSIX[0]));
+        if (!m_posix) {
+            const key_t key{::ftok(m_sharedMemory.name().c_str(), ID_SEM_AS_CONDITION)};
+            m_conditionSysV = (-1 == key) ? -1 : ::semget(key, 0, 0);
+            if (m_conditionSysV < 0) {
+                std::cerr << "[FrameNotifier] Error while opening the semaphore of '" << m_sharedMemory.name() << "': " << ::strerror(errno) << std::endl;
+            }
+        }
+    }
+    m_bridgeThreadRunning.store(true);
+    m_bridgeThread = std::thread(&FrameNotifier::bridge, this);
+}
+
+FrameNotifier::~FrameNotifier()
+{
+    // The waits of the bridge time out, so it stops without being notified.
+    m_bridgeThreadRunning.store(false);
+    if (m_bridgeThread.joinable()) {
+        m_bridgeThread.join();
+    }
+    if (!(m_eventFd < 0)) {
+        ::close(m_eventFd);
+    }
+}
+
+bool FrameNotifier::valid() const
+{
+    return !(m_eventFd < 0);
+}
+
+int FrameNotifier::fd() const
+{
+    return m_eventFd;
+}
+
+uint64_t FrameNotifier::acknowledge()
+{
+    uint64_t count{0};
+    if (sizeof(count) != ::read(m_eventFd, &count, sizeof(count))) {
+        return 0;
+    }
+    m_missed += (1 < count) ? (count - 1) : 0;
+    return count;
+}
+
+uint64_t FrameNotifier::missed() const
+{
+    return m_missed;
+}
+
+bool FrameNotifier::waitForNotification(std::chrono::microseconds timeout)
+{
+    if (m_posix) {
+        if (nullptr == m_sharedMemory.data()) {
+            return false;
+        }
+        SharedMemoryHeaderPOSIX *header{reinterpret_cast<SharedMemoryHeaderPOSIX *>(m_sharedMemory.data() - sizeof(SharedMemoryHeaderPOSIX))};
+        // cluon creates the condition variable on CLOCK_MONOTONIC.
+        struct timespec deadline {};
+        ::clock_gettime(CLOCK_MONOTONIC, &deadline);
+        const int64_t nanoseconds{static_cast<int64_t>(deadline.tv_nsec) + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count()};
+        deadline.tv_sec += static_cast<time_t>(nanoseconds / (1000 * 1000 * 1000));
+        deadline.tv_nsec = static_cast<long>(nanoseconds % (1000 * 1000 * 1000));
+        m_sharedMemory.lock();
+        const int retVal{::pthread_cond_timedwait(&header->condition, &header->mutex, &deadline)};
+        m_sharedMemory.unlock();
+        return 0 == retVal;
+    }
+    if (m_conditionSysV < 0) {
+        std::this_thread::sleep_for(timeout);
+        return false;
+    }
+    // SharedMemory::wait() for SysV: wait for the semaphore to become 0.
+    struct sembuf operation {};
+    operation.sem_num = 0;
+    operation.sem_op = 0;
+    operation.sem_flg = 0;
+    struct timespec relative {};
+    relative.tv_sec = static_cast<time_t>(timeout.count() / (1000 * 1000));
+    relative.tv_nsec = static_cast<long>((timeout.count() % (1000 * 1000)) * 1000);
+    return 0 == ::semtimedop(m_conditionSysV, &operation, 1, &relative);
+}
+
+void FrameNotifier::bridge()
+{
+    if (nullptr != m_signal) {
+        uint32_t last{m_signal->generation()};
+        while (m_bridgeThreadRunning.load()) {
+            const uint32_t current{m_signal->wait(last, BRIDGE_TIMEOUT)};
+            const uint64_t frames{static_cast<uint32_t>(current - last)};
+            last = current;
+            if ((0 < frames) && (sizeof(frames) != ::write(m_eventFd, &frames, sizeof(frames)))) {
+                std::cerr << "[FrameNotifier] Error while notifying: " << ::strerror(errno) << std::endl;
+            }
+        }
+        return;
+    }
+
+    const uint64_t one{1};
+    while (m_bridgeThreadRunning.load() && m_sharedMemory.valid()) {
+        if (!waitForNotification(BRIDGE_TIMEOUT)) {
+            continue;
+        }
+        // A SysV notification resets the semaphore right after waking the
+        // waiters; waiting again before that returns at once.
+        std::this_thread::yield();
+        if (m_bridgeThreadRunning.load() && (sizeof(one) != ::write(m_eventFd, &one, sizeof(one)))) {
+            std::cerr << "[FrameNotifier] Error while notifying: " << ::strerror(errno) << std::endl;
+        }
+    }
+}
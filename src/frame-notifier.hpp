@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_NOTIFIER_HPP
+#define FRAME_NOTIFIER_HPP
+
+#include "cluon-complete.hpp"
+#include "frame-signal.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+/**
+ * Turns the notifications of a cluon::SharedMemory into an eventfd that an
+ * event loop (event-loop.hpp) can wait on together with sockets and timers.
+ * The notifications are a process-shared condition variable (POSIX) or a
+ * semaphore (SysV) that no file descriptor can wait on, so a small bridge
+ * thread waits on them and increments the eventfd; the work for the frame
+ * happens on the thread of the event loop. The bridge waits with a timeout
+ * on the same condition variable or semaphore as SharedMemory::wait(), so
+ * that it notices when it is stopped without a notifyAll() that every other
+ * reader of the shared memory would see as a new frame.
+ *
+ * With a FrameSignal from the producer, the bridge waits on its futex
+ * instead and forwards the number of generations that passed, so frames
+ * missed between two notifications are counted as well.
+ */
+class FrameNotifier {
+   private:
+    FrameNotifier(const FrameNotifier &) = delete;
+    FrameNotifier(FrameNotifier &&) = delete;
+    FrameNotifier &operator=(const FrameNotifier &) = delete;
+    FrameNotifier &operator=(FrameNotifier &&) = delete;
+
+   public:
+    /**
+     * @param sharedMemory Shared memory area with the frames.
+     * @param signal Generation counter of the producer to wait on instead (nullptr = SharedMemory::wait()).
+     */
+    explicit FrameNotifier(cluon::SharedMemory &sharedMemory, FrameSignal *signal = nullptr);
+    ~FrameNotifier();
+
+    bool valid() const;
+
+    // File descriptor that is readable while notifications are pending.
+    int fd() const;
+
+    /**
+     * Consumes the pending notifications; call it when fd() is readable.
+     *
+     * @return Number of notifications since the last call; more than one
+     *         means that frames were replaced before they were processed.
+     */
+    uint64_t acknowledge();
+
+    // Frames that were replaced before they were processed.
+    uint64_t missed() const;
+
+   private:
+    void bridge();
+
+    // SharedMemory::wait() with a timeout; returns true if notified.
+    bool waitForNotification(std::chrono::microseconds timeout);
+
+   private:
+    cluon::SharedMemory &m_sharedMemory;
+    FrameSignal *m_signal{nullptr};
+    bool m_posix{false};
+    int m_conditionSysV{-1};
+    int m_eventFd{-1};
+    uint64_t m_missed{0};
+    std::atomic<bool> m_bridgeThreadRunning{false};
+    std::thread m_bridgeThread{};
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame-ring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// Area: Header, one Slot per frame slot, then the frames; everything in its own cache lines.
+struct FrameRing::Header {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slotSize;
+    std::atomic<uint64_t> published;
+    char padding[40];
+};
+
+struct FrameRing::Slot {
+    std::atomic<uint64_t> sequence;
+    int64_t timeStamp;
+    int64_t completed;
+    uint64_t size;
+    char padding[32];
+};
+
+namespace {
+
+constexpr uint32_t MAGIC{0x52465453};    // "STFR"
+constexpr uint32_t VERSION{2};
+constexpr size_t CACHE_LINE{64};
+
+size_t stride(uint32_t slotSize)
+{
+    return (static_cast<size_t>(slotSize) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+} // namespace
+
+size_t FrameRing::size(uint32_t slots, uint32_t slotSize)
+{
+    static_assert(CACHE_LINE == sizeof(Header), "Header must fill one cache line.");
+    static_assert(CACHE_LINE == sizeof(Slot), "Slot must fill one cache line.");
+    return sizeof(Header) + slots * (sizeof(Slot) + stride(slotSize));
+}
+
+FrameRing::FrameRing(cluon::SharedMemory &sharedMemory, uint32_t slots, uint32_t slotSize)
+    : m_sharedMemory{sharedMemory}
+{
+    if (!m_sharedMemory.valid() || (2 > slots) || (static_cast<size_t>(m_sharedMemory.size()) < size(slots, slotSize))) {
+        std::cerr << "[FrameRing] Shared memory '" << m_sharedMemory.name() << "' cannot hold " << slots << " slots of " << slotSize << " bytes." << std::endl;
+        return;
+    }
+    m_header = reinterpret_cast<Header *>(m_sharedMemory.data());
+    std::memset(static_cast<void *>(m_sharedMemory.data()), 0, size(slots, slotSize));
+    m_header->version = VERSION;
+    m_header->slots = slots;
+    m_header->slotSize = slotSize;
+    m_header->published.store(0, std::memory_order_relaxed);
+    // Consumers that attach from now on see a complete header.
+    m_header->magic.store(MAGIC, std::memory_order_release);
+}
+
+FrameRing::FrameRing(cluon::SharedMemory &sharedMemory)
+    : m_sharedMemory{sharedMemory}
+{
+    if (!m_sharedMemory.valid() || (static_cast<size_t>(m_sharedMemory.size()) < sizeof(Header))) {
+        return;
+    }
+    Header *header{reinterpret_cast<Header *>(m_sharedMemory.data())};
+    const uint32_t magic{header->magic.load(std::memory_order_acquire)};
+    if ((MAGIC != magic) || (VERSION != header->version) || (2 > header->slots) ||
+        (static_cast<size_t>(m_sharedMemory.size()) < size(header->slots, header->slotSize))) {
+        std::cerr << "[FrameRing] Shared memory '" << m_sharedMemory.name() << "' does not contain a frame ring." << std::endl;
+        return;
+    }
+    m_header = header;
+}
+
+bool FrameRing::valid() const
+{
+    return nullptr != m_header;
+}
+
+uint32_t FrameRing::slots() const
+{
+    return valid() ? m_header->slots : 0;
+}
+
+uint32_t FrameRing::slotSize() const
+{
+    return valid() ? m_header->slotSize : 0;
+}
+
+uint64_t FrameRing::published() const
+{
+    return valid() ? m_header->published.load(std::memory_order_acquire) : 0;
+}
+
+FrameRing::Slot *FrameRing::slotAt(uint64_t frame) const
+{
+    return reinterpret_cast<Slot *>(reinterpret_cast<char *>(m_header) + sizeof(Header)) + (frame % m_header->slots);
+}
+
+char *FrameRing::dataAt(uint64_t frame) const
+{
+    return reinterpret_cast<char *>(m_header) + sizeof(Header) + m_header->slots * sizeof(Slot) + (frame % m_header->slots) * stride(m_header->slotSize);
+}
+
+char *FrameRing::beginWrite()
+{
+    if (!valid()) {
+        return nullptr;
+    }
+    m_writing = m_header->published.load(std::memory_order_relaxed) + 1;
+    Slot *slot{slotAt(m_writing)};
+    // Consumers still working on the previous frame in this slot see the odd
+    // sequence before any of the new pixels.
+    slot->sequence.store(2 * m_writing - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return dataAt(m_writing);
+}
+
+void FrameRing::endWrite(size_t size, int64_t timeStamp)
+{
+    if (!valid() || (0 == m_writing)) {
+        return;
+    }
+    Slot *slot{slotAt(m_writing)};
+    slot->timeStamp = timeStamp;
+    slot->completed = cluon::time::toMicroseconds(cluon::time::now());
+    slot->size = std::min<uint64_t>(size, m_header->slotSize);
+    slot->sequence.store(2 * m_writing, std::memory_order_release);
+    m_header->published.store(m_writing, std::memory_order_release);
+    m_writing = 0;
+    m_sharedMemory.notifyAll();
+}
+
+bool FrameRing::acquireLatest(FrameSlot &frameSlot) const
+{
+    // The newest frame is only overwritten after as many frames as there are
+    // slots; retrying is therefore rare and continues with a newer frame.
+    uint64_t frame{published()};
+    while (0 < frame) {
+        const Slot *slot{slotAt(frame)};
+        frameSlot.sequence = slot->sequence.load(std::memory_order_acquire);
+        frameSlot.data = dataAt(frame);
+        frameSlot.size = slot->size;
+        frameSlot.frame = frame;
+        frameSlot.timeStamp = slot->timeStamp;
+        frameSlot.completed = slot->completed;
+        if ((frameSlot.sequence == 2 * frame) && stillValid(frameSlot)) {
+            return true;
+        }
+        const uint64_t newer{published()};
+        frame = (newer != frame) ? newer : 0;
+    }
+    frameSlot = FrameSlot();
+    return false;
+}
+
+bool FrameRing::stillValid(const FrameSlot &frameSlot) const
+{
+    // Orders all reads of the frame before reading the sequence again.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return valid() && (0 < frameSlot.frame) && (slotAt(frameSlot.frame)->sequence.load(std::memory_order_relaxed) == frameSlot.sequence);
+}
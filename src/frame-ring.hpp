@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_RING_HPP
+#define FRAME_RING_HPP
+
+#include "cluon-complete.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Frame in a slot of a FrameRing as seen by a consumer.
+struct FrameSlot {
+    const char *data{nullptr};
+    size_t size{0};
+    uint64_t frame{0};        // Number of the frame, counting from 1.
+    int64_t timeStamp{0};     // Sample time stamp in microseconds.
+    int64_t completed{0};     // Time the producer finished writing it in microseconds.
+    uint64_t sequence{0};     // Sequence of the slot when it was acquired.
+};
+
+/**
+ * Layout of a cluon::SharedMemory area with several frame slots for one
+ * producer and any number of consumers. With a single frame in the area,
+ * the producer waits for SharedMemory::lock() while a consumer holds it
+ * for segmenting the frame, and consumers only ever see the newest frame.
+ *
+ * Here, the producer writes every frame into the next slot without a lock
+ * and publishes it afterwards. Each slot carries a sequence number like a
+ * seqlock: odd while the producer writes the slot, twice the frame number
+ * when the frame is complete. A consumer works on a slot in place and
+ * checks with stillValid() afterwards that the producer did not start to
+ * overwrite it meanwhile, which takes as many frames as there are slots.
+ * Consumers never write to the area.
+ *
+ * New frames are announced with SharedMemory::notifyAll() as before.
+ */
+class FrameRing {
+   private:
+    FrameRing(const FrameRing &) = delete;
+    FrameRing(FrameRing &&) = delete;
+    FrameRing &operator=(const FrameRing &) = delete;
+    FrameRing &operator=(FrameRing &&) = delete;
+
+   public:
+    // Bytes of shared memory needed for slots frames of up to slotSize bytes.
+    static size_t size(uint32_t slots, uint32_t slotSize);
+
+    /**
+     * Producer: lays out an empty ring in a newly created area.
+     *
+     * @param sharedMemory Area of at least size(slots, slotSize) bytes.
+     */
+    FrameRing(cluon::SharedMemory &sharedMemory, uint32_t slots, uint32_t slotSize);
+
+    // Consumer: attaches to a ring laid out by a producer.
+    explicit FrameRing(cluon::SharedMemory &sharedMemory);
+
+    ~FrameRing() = default;
+
+    // Returns false if the area is too small or does not contain a ring.
+    bool valid() const;
+
+    uint32_t slots() const;
+    uint32_t slotSize() const;
+
+    // Number of the newest complete frame; 0 before the first one.
+    uint64_t published() const;
+
+    /**
+     * Producer: returns the slot for the next frame, which is marked as being
+     * written until endWrite().
+     */
+    char *beginWrite();
+
+    // Producer: completes the frame started with beginWrite() and notifies the consumers.
+    void endWrite(size_t size, int64_t timeStamp);
+
+    /**
+     * Consumer: returns the newest complete frame.
+     *
+     * @return false if there is none yet.
+     */
+    bool acquireLatest(FrameSlot &slot) const;
+
+    // Consumer: returns false if the producer started to overwrite the slot since acquiring it.
+    bool stillValid(const FrameSlot &slot) const;
+
+   private:
+    struct Header;
+    struct Slot;
+
+    Slot *slotAt(uint64_t frame) const;
+    char *dataAt(uint64_t frame) const;
+
+   private:
+    cluon::SharedMemory &m_sharedMemory;
+    Header *m_header{nullptr};
+    uint64_t m_writing{0};
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame-sidecar.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+FrameSidecar::FrameSidecar(const std::string &name, bool create)
+    : m_name{((0 == name.find('/')) ? "" : "/") + name + ".meta"}
+    , m_created{create}
+{
+    const int fd{::shm_open(m_name.c_str(), create ? (O_RDWR | O_CREAT) : O_RDONLY, S_IRUSR | S_IWUSR)};
+    if (fd < 0) {
+        // A missing area only means that the producer does not publish metadata.
+        if (create || (ENOENT != errno)) {
+            std::cerr << "[FrameSidecar] Failed to open '" << m_name << "': " << ::strerror(errno) << std::endl;
+        }
+        return;
+    }
+    if (create && (0 != ::ftruncate(fd, sizeof(Shared)))) {
+        std::cerr << "[FrameSidecar] Failed to resize '" << m_name << "': " << ::strerror(errno) << std::endl;
+        ::close(fd);
+        return;
+    }
+    // Consumers map the area read-only.
+    void *mapping{::mmap(nullptr, sizeof(Shared), create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0)};
+    ::close(fd);
+    if (MAP_FAILED == mapping) {
+        std::cerr << "[FrameSidecar] Failed to map '" << m_name << "': " << ::strerror(errno) << std::endl;
+        return;
+    }
+    m_shared = static_cast<Shared *>(mapping);
+}
+
+FrameSidecar::~FrameSidecar()
+{
+    if (nullptr != m_shared) {
+        ::munmap(m_shared, sizeof(Shared));
+    }
+    if (m_created) {
+        ::shm_unlink(m_name.c_str());
+    }
+}
+
+bool FrameSidecar::valid() const
+{
+    return nullptr != m_shared;
+}
+
+const std::string &FrameSidecar::name() const
+{
+    return m_name;
+}
+
+void FrameSidecar::publish(const opendlv::proxy::ImageReadingShared &image, int64_t sampleTimeStamp)
+{
+    if (!valid() || !m_created) {
+        return;
+    }
+    const uint64_t sequence{m_shared->sequence.load(std::memory_order_relaxed)};
+    m_shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    FrameMetadata &metadata = m_shared->metadata;
+    metadata.frame++;
+    metadata.sampleTimeStamp = sampleTimeStamp;
+    metadata.completed = cluon::time::toMicroseconds(cluon::time::now());
+    metadata.size = image.size();
+    metadata.width = image.width();
+    metadata.height = image.height();
+    metadata.bytesPerPixel = image.bytesPerPixel();
+    m_shared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool FrameSidecar::read(FrameMetadata &metadata) const
+{
+    if (!valid()) {
+        return false;
+    }
+    // The producer holds an odd sequence only for a few stores.
+    for (uint32_t attempt = 0; attempt < 1000; attempt++) {
+        const uint64_t before{m_shared->sequence.load(std::memory_order_acquire)};
+        if (0 == (before & 1)) {
+            metadata = m_shared->metadata;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (before == m_shared->sequence.load(std::memory_order_relaxed)) {
+                return 0 < metadata.frame;
+            }
+        }
+    }
+    return false;
+}
+
+void FrameStatistics::add(uint64_t frame, int64_t completed, int64_t started, int64_t finished)
+{
+    m_dropped += ((0 < m_lastFrame) && (frame > m_lastFrame + 1)) ? (frame - m_lastFrame - 1) : 0;
+    m_lastFrame = frame;
+    m_processed++;
+    const int64_t wakeUp{started - completed};
+    const int64_t total{finished - completed};
+    m_wakeUpSum += wakeUp;
+    m_wakeUpMax = std::max(m_wakeUpMax, wakeUp);
+    m_totalSum += total;
+    m_totalMax = std::max(m_totalMax, total);
+}
+
+uint64_t FrameStatistics::processed() const
+{
+    return m_processed;
+}
+
+uint64_t FrameStatistics::dropped() const
+{
+    return m_dropped;
+}
+
+double FrameStatistics::meanWakeUpLatency() const
+{
+    return (0 < m_processed) ? static_cast<double>(m_wakeUpSum) / static_cast<double>(m_processed) : 0.0;
+}
+
+int64_t FrameStatistics::maxWakeUpLatency() const
+{
+    return m_wakeUpMax;
+}
+
+double FrameStatistics::meanTotalLatency() const
+{
+    return (0 < m_processed) ? static_cast<double>(m_totalSum) / static_cast<double>(m_processed) : 0.0;
+}
+
+int64_t FrameStatistics::maxTotalLatency() const
+{
+    return m_totalMax;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SIDECAR_HPP
+#define FRAME_SIDECAR_HPP
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Description of the frame currently in a cluon::SharedMemory area.
+struct FrameMetadata {
+    uint64_t frame{0};              // Number of the frame, counting from 1.
+    int64_t sampleTimeStamp{0};     // Time the frame was captured in microseconds.
+    int64_t completed{0};           // Time the producer finished writing it in microseconds.
+    // As in opendlv.proxy.ImageReadingShared.
+    uint32_t size{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t bytesPerPixel{0};
+};
+
+/**
+ * Publishes a FrameMetadata for every frame in the small POSIX shared memory
+ * area "<name of the frame>.meta" next to the frame: SharedMemory only carries
+ * a sample time stamp, so a consumer could neither tell how many frames it
+ * missed between two wake-ups nor check the geometry it was started with.
+ * The metadata is guarded by a sequence number like a seqlock; read()
+ * retries while the producer writes it.
+ *
+ * Producers that support it create the area and call publish() after
+ * writing a frame while they still hold SharedMemory::lock(), so that a
+ * consumer holding the lock sees the metadata of the frame it reads;
+ * consumers open the area if it exists.
+ */
+class FrameSidecar {
+   private:
+    FrameSidecar(const FrameSidecar &) = delete;
+    FrameSidecar(FrameSidecar &&) = delete;
+    FrameSidecar &operator=(const FrameSidecar &) = delete;
+    FrameSidecar &operator=(FrameSidecar &&) = delete;
+
+   public:
+    /**
+     * @param name Name of the frame's shared memory area; the metadata is stored as "<name>.meta".
+     * @param create true for the producer, which creates the area and removes it again.
+     */
+    FrameSidecar(const std::string &name, bool create);
+    ~FrameSidecar();
+
+    // Returns false if the area could not be created or does not exist.
+    bool valid() const;
+
+    const std::string &name() const;
+
+    /**
+     * Producer: describes the frame just written; numbers the frames and
+     * stamps the time of completion.
+     */
+    void publish(const opendlv::proxy::ImageReadingShared &image, int64_t sampleTimeStamp);
+
+    /**
+     * Consumer: returns the metadata of the newest frame.
+     *
+     * @return false if nothing was published yet or the producer kept writing.
+     */
+    bool read(FrameMetadata &metadata) const;
+
+   private:
+    struct Shared {
+        std::atomic<uint64_t> sequence;
+        FrameMetadata metadata;
+    };
+
+   private:
+    std::string m_name{};
+    bool m_created{false};
+    Shared *m_shared{nullptr};
+};
+
+/**
+ * Consumer side bookkeeping of frame numbers and time stamps: counts frames
+ * that were replaced before they were processed and the latency from the
+ * producer completing a frame to the consumer starting and finishing it.
+ */
+class FrameStatistics {
+   public:
+    /**
+     * Adds a processed frame.
+     *
+     * @param frame Number of the frame; gaps to the previous one are dropped frames.
+     * @param completed Time the producer finished the frame in microseconds.
+     * @param started Time processing started in microseconds.
+     * @param finished Time processing finished in microseconds.
+     */
+    void add(uint64_t frame, int64_t completed, int64_t started, int64_t finished);
+
+    uint64_t processed() const;
+    uint64_t dropped() const;
+
+    // Mean and maximum latency in microseconds from completed to started and to finished.
+    double meanWakeUpLatency() const;
+    int64_t maxWakeUpLatency() const;
+    double meanTotalLatency() const;
+    int64_t maxTotalLatency() const;
+
+   private:
+    uint64_t m_lastFrame{0};
+    uint64_t m_processed{0};
+    uint64_t m_dropped{0};
+    int64_t m_wakeUpSum{0};
+    int64_t m_wakeUpMax{0};
+    int64_t m_totalSum{0};
+    int64_t m_totalMax{0};
+};
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame-signal.hpp"
+// cpuRelax()
+#include "mpsc-pipeline.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Shared (not FUTEX_PRIVATE_FLAG) futex operations as the counter is mapped into several processes.
+long futex(std::atomic<uint32_t> *address, int operation, uint32_t value, const struct timespec *timeout)
+{
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32 bit word.");
+    return ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(address), operation, value, timeout, nullptr, 0);
+}
+
+} // namespace
+
+FrameSignal::FrameSignal(const std::string &name, bool create, uint32_t spins)
+    : m_name{((0 == name.find('/')) ? "" : "/") + name + ".signal"}
+    , m_created{create}
+    , m_spins{(1 < std::thread::hardware_concurrency()) ? spins : 0}
+{
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "The generation counter must be lock-free to be shared between processes.");
+    const int fd{::shm_open(m_name.c_str(), create ? (O_RDWR | O_CREAT) : O_RDWR, S_IRUSR | S_IWUSR)};
+    if (fd < 0) {
+        // A missing area only means that the producer does not support the signal.
+        if (create || (ENOENT != errno)) {
+            std::cerr << "[FrameSignal] Failed to open '" << m_name << "': " << ::strerror(errno) << std::endl;
+        }
+        return;
+    }
+    if (create && (0 != ::ftruncate(fd, sizeof(Shared)))) {
+        std::cerr << "[FrameSignal] Failed to resize '" << m_name << "': " << ::strerror(errno) << std::endl;
+        ::close(fd);
+        return;
+    }
+    void *mapping{::mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)};
+    ::close(fd);
+    if (MAP_FAILED == mapping) {
+        std::cerr << "[FrameSignal] Failed to map '" << m_name << "': " << ::strerror(errno) << std::endl;
+        return;
+    }
+    // A new area is zero-filled, which is generation 0 without sleepers.
+    m_shared = static_cast<Shared *>(mapping);
+}
+
+FrameSignal::~FrameSignal()
+{
+    if (nullptr != m_shared) {
+        ::munmap(m_shared, sizeof(Shared));
+    }
+    if (m_created) {
+        ::shm_unlink(m_name.c_str());
+    }
+}
+
+bool FrameSignal::valid() const
+{
+    return nullptr != m_shared;
+}
+
+const std::string &FrameSignal::name() const
+{
+    return m_name;
+}
+
+uint32_t FrameSignal::generation() const
+{
+    return valid() ? m_shared->generation.load(std::memory_order_acquire) : 0;
+}
+
+void FrameSignal::notifyAll()
+{
+    if (!valid()) {
+        return;
+    }
+    m_shared->generation.fetch_add(1, std::memory_order_acq_rel);
+    // Pairs with the increment of sleepers in wait(): either the consumer sees
+    // the new generation before sleeping or we see that it sleeps.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (0 < m_shared->sleepers.load(std::memory_order_relaxed)) {
+        futex(&m_shared->generation, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+}
+
+uint32_t FrameSignal::wait(uint32_t last, std::chrono::microseconds timeout)
+{
+    if (!valid()) {
+        return last;
+    }
+    for (uint32_t i = 0; i < m_spins; i++) {
+        const uint32_t current{m_shared->generation.load(std::memory_order_acquire)};
+        if (current != last) {
+            m_spun++;
+            return current;
+        }
+        cpuRelax();
+    }
+
+    const auto deadline{std::chrono::steady_clock::now() + timeout};
+    uint32_t current{last};
+    m_shared->sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (last == (current = m_shared->generation.load(std::memory_order_acquire))) {
+        const auto remaining{std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count()};
+        if (0 >= remaining) {
+            break;
+        }
+        struct timespec relative {};
+        relative.tv_sec = static_cast<time_t>(remaining / (1000 * 1000 * 1000));
+        relative.tv_nsec = static_cast<long>(remaining % (1000 * 1000 * 1000));
+        // Returns at once with EAGAIN if the generation changed meanwhile.
+        futex(&m_shared->generation, FUTEX_WAIT, last, &relative);
+    }
+    m_shared->sleepers.fetch_sub(1, std::memory_order_relaxed);
+    m_slept++;
+    return current;
+}
+
+uint64_t FrameSignal::spun() const
+{
+    return m_spun;
+}
+
+uint64_t FrameSignal::slept() const
+{
+    return m_slept;
+}
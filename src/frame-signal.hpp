@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SIGNAL_HPP
+#define FRAME_SIGNAL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Notification of new frames between processes as a generation counter in
+ * a small POSIX shared memory area next to the frame's cluon::SharedMemory,
+ * for consumers that need lower wake-up latency than
+ * SharedMemory::wait()/notifyAll(): these go through a process-shared
+ * pthread condition variable and its mutex (POSIX) or two semctl() and a
+ * semop() call (SysV) for every frame.
+ *
+ * The producer increments the counter after every frame and only enters the
+ * kernel (FUTEX_WAKE) when a consumer sleeps. A consumer polls the counter
+ * for a bounded number of spins before it sleeps in FUTEX_WAIT on it, so a
+ * frame that arrives while it is still spinning costs no system call at all.
+ * The difference between two generations tells how many frames a consumer
+ * missed.
+ *
+ * The signal is optional: producers that support it create the area
+ * "<name of the frame>.signal" and call notifyAll() in addition to
+ * SharedMemory::notifyAll(), so consumers that only know SharedMemory keep
+ * working.
+ */
+class FrameSignal {
+   private:
+    FrameSignal(const FrameSignal &) = delete;
+    FrameSignal(FrameSignal &&) = delete;
+    FrameSignal &operator=(const FrameSignal &) = delete;
+    FrameSignal &operator=(FrameSignal &&) = delete;
+
+   public:
+    /**
+     * @param name Name of the frame's shared memory area; the signal is stored as "<name>.signal".
+     * @param create true for the producer, which creates the area and removes it again.
+     * @param spins Polls of the counter before sleeping; ignored on single core
+     *        machines where spinning only delays the producer.
+     */
+    FrameSignal(const std::string &name, bool create, uint32_t spins = 4000);
+    ~FrameSignal();
+
+    // Returns false if the area could not be created or does not exist.
+    bool valid() const;
+
+    const std::string &name() const;
+
+    uint32_t generation() const;
+
+    // Producer: publishes a new frame and wakes sleeping consumers.
+    void notifyAll();
+
+    /**
+     * Consumer: waits until the generation differs from last, spinning
+     * first and sleeping in the kernel afterwards.
+     *
+     * @return Current generation; equal to last if the timeout expired.
+     */
+    uint32_t wait(uint32_t last, std::chrono::microseconds timeout);
+
+    // Waits that ended while spinning and waits that had to sleep.
+    uint64_t spun() const;
+    uint64_t slept() const;
+
+   private:
+    // Layout of the shared area; both counters must be lock-free to work across processes.
+    struct Shared {
+        std::atomic<uint32_t> generation;
+        std::atomic<uint32_t> sleepers;
+    };
+
+   private:
+    std::string m_name{};
+    bool m_created{false};
+    uint32_t m_spins{0};
+    Shared *m_shared{nullptr};
+    uint64_t m_spun{0};
+    uint64_t m_slept{0};
+};
+
+#endif
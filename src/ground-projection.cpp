@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ground-projection.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+CameraIntrinsics intrinsicsFromFieldOfView(uint32_t width, uint32_t height, float horizontalFieldOfView)
+{
+    CameraIntrinsics intrinsics;
+    intrinsics.fx = static_cast<float>((width / 2.0) / std::tan(horizontalFieldOfView * M_PI / 360.0));
+    intrinsics.fy = intrinsics.fx;
+    intrinsics.cx = static_cast<float>((width - 1) / 2.0);
+    intrinsics.cy = static_cast<float>((height - 1) / 2.0);
+    return intrinsics;
+}
+
+bool parseIntrinsics(const std::string &text, CameraIntrinsics &intrinsics)
+{
+    CameraIntrinsics parsed;
+    char rest{0};
+    if ((4 != std::sscanf(text.c_str(), "%f,%f,%f,%f%c", &parsed.fx, &parsed.fy, &parsed.cx, &parsed.cy, &rest)) || !(0.0f < parsed.fx) || !(0.0f < parsed.fy)) {
+        return false;
+    }
+    intrinsics = parsed;
+    return true;
+}
+
+GroundProjection::GroundProjection(const CameraIntrinsics &intrinsics, cv::Rect roi, float cameraHeight, float cameraPitch)
+    : m_width(roi.width)
+    , m_height(roi.height)
+    , m_points(static_cast<size_t>(roi.width) * static_cast<size_t>(roi.height))
+{
+    const double pitch{cameraPitch * M_PI / 180.0};
+    const double sinPitch{std::sin(pitch)};
+    const double cosPitch{std::cos(pitch)};
+    for (int32_t y = 0; y < m_height; y++) {
+        // Ray through the pixel: optical axis + a * image right + b * image down,
+        // rotated into vehicle coordinates (x forward, y left, z up).
+        const double b{(roi.y + y - intrinsics.cy) / intrinsics.fy};
+        const double down{sinPitch + b * cosPitch};
+        for (int32_t x = 0; x < m_width; x++) {
+            GroundPoint &point{m_points[static_cast<size_t>(y) * static_cast<size_t>(m_width) + static_cast<size_t>(x)]};
+            if (0.0 < down) {
+                const double a{(roi.x + x - intrinsics.cx) / intrinsics.fx};
+                const double scale{cameraHeight / down};
+                const double forward{scale * (cosPitch - b * sinPitch)};
+                const double left{-scale * a};
+                point.x = static_cast<float>(forward);
+                point.y = static_cast<float>(left);
+                point.distance = static_cast<float>(std::sqrt(forward * forward + left * left));
+                point.bearing = static_cast<float>(std::atan2(left, forward));
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GROUND_PROJECTION_HPP
+#define GROUND_PROJECTION_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pinhole camera intrinsics in pixels.
+struct CameraIntrinsics {
+    float fx{0.0f};
+    float fy{0.0f};
+    float cx{0.0f};
+    float cy{0.0f};
+};
+
+// Intrinsics of a camera with square pixels and the principal point in the centre of the frame.
+CameraIntrinsics intrinsicsFromFieldOfView(uint32_t width, uint32_t height, float horizontalFieldOfView);
+
+// Parses "fx,fy,cx,cy"; returns false and leaves intrinsics unchanged if that fails.
+bool parseIntrinsics(const std::string &text, CameraIntrinsics &intrinsics);
+
+/**
+ * Point on the ground in vehicle coordinates below the camera: x forward and
+ * y to the left in metres, with distance and bearing (radians, positive to
+ * the left) precomputed. distance is 0 for pixels at or above the horizon.
+ */
+struct GroundPoint {
+    float x{0.0f};
+    float y{0.0f};
+    float distance{0.0f};
+    float bearing{0.0f};
+};
+
+/**
+ * Inverse perspective mapping for the crop zone: a table with the ground
+ * point of every pixel, computed once on startup from the intrinsics, the
+ * mount height and the downward pitch of the camera under the assumption
+ * of a flat ground. Turning a pixel into metres is a single lookup.
+ */
+class GroundProjection {
+   private:
+    GroundProjection(const GroundProjection &) = delete;
+    GroundProjection(GroundProjection &&) = delete;
+    GroundProjection &operator=(const GroundProjection &) = delete;
+    GroundProjection &operator=(GroundProjection &&) = delete;
+
+   public:
+    /**
+     * @param intrinsics Intrinsics of the camera for full frames.
+     * @param roi Crop zone in frame coordinates whose pixels are mapped.
+     * @param cameraHeight Height of the camera above the ground in metres.
+     * @param cameraPitch Angle in degrees the camera is tilted downwards.
+     */
+    GroundProjection(const CameraIntrinsics &intrinsics, cv::Rect roi, float cameraHeight, float cameraPitch);
+
+    // Ground point of pixel (x, y) of the crop zone; coordinates are clamped to it.
+    const GroundPoint &at(int32_t x, int32_t y) const noexcept
+    {
+        x = (x < 0) ? 0 : ((x < m_width) ? x : m_width - 1);
+        y = (y < 0) ? 0 : ((y < m_height) ? y : m_height - 1);
+        return m_points[static_cast<size_t>(y) * static_cast<size_t>(m_width) + static_cast<size_t>(x)];
+    }
+
+    // Ground point where the lower edge of a box in the crop zone touches the ground.
+    const GroundPoint &footOf(const cv::Rect &box) const noexcept { return at(box.x + box.width / 2, box.y + box.height - 1); }
+
+   private:
+    int32_t m_width{0};
+    int32_t m_height{0};
+    std::vector<GroundPoint> m_points{};
+};
+
+#endif
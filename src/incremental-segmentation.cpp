@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "incremental-segmentation.hpp"
+#include "cone-detection.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// Every SAMPLE_STEP-th pixel in every SAMPLE_STEP-th row is compared; B, G and R of each.
+constexpr int SAMPLE_STEP{2};
+constexpr int SAMPLE_CHANNELS{3};
+
+int samples(const cv::Rect &area)
+{
+    return ((area.width + SAMPLE_STEP - 1) / SAMPLE_STEP) * ((area.height + SAMPLE_STEP - 1) / SAMPLE_STEP) * SAMPLE_CHANNELS;
+}
+
+bool operator!=(const ColorRange &a, const ColorRange &b)
+{
+    return (a.hLow != b.hLow) || (a.sLow != b.sLow) || (a.vLow != b.vLow) || (a.hHigh != b.hHigh) || (a.sHigh != b.sHigh) || (a.vHigh != b.vHigh);
+}
+
+} // namespace
+
+IncrementalSegmenter::IncrementalSegmenter(const Segmenter &segmenter, const cv::Rect &roi, uint32_t tileWidth, uint32_t tileHeight,
+                                           uint32_t noise, uint32_t threshold, float fullFraction)
+    : m_segmenter(segmenter)
+    , m_roi(roi)
+    , m_noise(static_cast<int32_t>(noise))
+    , m_threshold(threshold)
+    , m_fullFraction(fullFraction)
+{
+    // The blur reaches this far into the neighbouring tiles.
+    const int border{BLUR_KERNEL_SIZE / 2};
+    size_t sampleCount{0};
+    for (int y = 0; y < roi.height; y += static_cast<int>(tileHeight)) {
+        for (int x = 0; x < roi.width; x += static_cast<int>(tileWidth)) {
+            Tile tile;
+            tile.area = cv::Rect(x, y, std::min(static_cast<int>(tileWidth), roi.width - x), std::min(static_cast<int>(tileHeight), roi.height - y));
+            // Clipped to the frame below when the frame size is known.
+            tile.sampled = cv::Rect(roi.x + x - border, roi.y + y - border, tile.area.width + 2 * border, tile.area.height + 2 * border);
+            tile.firstSample = sampleCount;
+            sampleCount += static_cast<size_t>(samples(tile.sampled));
+            m_grid.push_back(tile);
+        }
+    }
+    m_samples.resize(sampleCount);
+    m_changed.resize(m_grid.size());
+    m_blurred.create(static_cast<int>(tileHeight), static_cast<int>(tileWidth), CV_8UC4);
+    m_hsv.create(static_cast<int>(tileHeight), static_cast<int>(tileWidth), CV_8UC3);
+}
+
+void IncrementalSegmenter::invalidate() noexcept
+{
+    m_valid = false;
+}
+
+double IncrementalSegmenter::skippedFraction() const noexcept
+{
+    return (0 == m_tilesSeen) ? 0.0 : static_cast<double>(m_tilesSkipped) / static_cast<double>(m_tilesSeen);
+}
+
+uint32_t IncrementalSegmenter::difference(const cv::Mat &frame, const Tile &tile) const noexcept
+{
+    const cv::Rect area{tile.sampled & cv::Rect(0, 0, frame.cols, frame.rows)};
+    const uint8_t *reference{m_samples.data() + tile.firstSample};
+    const int channels{frame.channels()};
+    uint32_t sum{0};
+    for (int y = area.y; y < area.y + area.height; y += SAMPLE_STEP) {
+        const uint8_t *row{frame.ptr<uint8_t>(y) + area.x * channels};
+        for (int x = 0; x < area.width; x += SAMPLE_STEP) {
+            for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+                const int32_t excess{std::abs(row[x * channels + c] - *reference++) - m_noise};
+                sum += static_cast<uint32_t>(std::max(excess, 0));
+            }
+        }
+    }
+    return sum;
+}
+
+void IncrementalSegmenter::storeReference(const cv::Mat &frame, const Tile &tile) noexcept
+{
+    const cv::Rect area{tile.sampled & cv::Rect(0, 0, frame.cols, frame.rows)};
+    uint8_t *reference{m_samples.data() + tile.firstSample};
+    const int channels{frame.channels()};
+    for (int y = area.y; y < area.y + area.height; y += SAMPLE_STEP) {
+        const uint8_t *row{frame.ptr<uint8_t>(y) + area.x * channels};
+        for (int x = 0; x < area.width; x += SAMPLE_STEP) {
+            for (int c = 0; c < SAMPLE_CHANNELS; c++) {
+                *reference++ = row[x * channels + c];
+            }
+        }
+    }
+}
+
+void IncrementalSegmenter::segmentTile(const cv::Mat &frame, Tile &tile, const ColorRange &blue, const ColorRange &yellow, cv::Mat &blueMask, cv::Mat &yellowMask)
+{
+    // Views of the preallocated buffers with the size of the tile, so that OpenCV allocates nothing.
+    cv::Mat blurred{m_blurred(cv::Rect(0, 0, tile.area.width, tile.area.height))};
+    cv::Mat hsv{m_hsv(cv::Rect(0, 0, tile.area.width, tile.area.height))};
+    cv::Mat blueTile{blueMask(tile.area)};
+    cv::Mat yellowTile{yellowMask(tile.area)};
+    cv::blur(frame(tile.area + m_roi.tl()), blurred, cv::Size(BLUR_KERNEL_SIZE, BLUR_KERNEL_SIZE));
+    cv::cvtColor(blurred, hsv, cv::COLOR_BGR2HSV);
+    cv::inRange(hsv, cv::Scalar(blue.hLow, blue.sLow, blue.vLow), cv::Scalar(blue.hHigh, blue.sHigh, blue.vHigh), blueTile);
+    cv::inRange(hsv, cv::Scalar(yellow.hLow, yellow.sLow, yellow.vLow), cv::Scalar(yellow.hHigh, yellow.sHigh, yellow.vHigh), yellowTile);
+    tile.counts.blue = static_cast<uint32_t>(cv::countNonZero(blueTile));
+    tile.counts.yellow = static_cast<uint32_t>(cv::countNonZero(yellowTile));
+}
+
+MaskCounts IncrementalSegmenter::segment(const cv::Mat &frame, const ColorRange &blue, const ColorRange &yellow, cv::Mat &blueMask, cv::Mat &yellowMask)
+{
+    const bool complete{!m_valid || (blue != m_blue) || (yellow != m_yellow) || (blueMask.data != m_blueMask) || (yellowMask.data != m_yellowMask)};
+    size_t changedTiles{0};
+    for (size_t i = 0; i < m_grid.size(); i++) {
+        m_changed[i] = (complete || (m_threshold < difference(frame, m_grid[i]))) ? 1 : 0;
+        changedTiles += m_changed[i];
+    }
+    m_tilesSeen += m_grid.size();
+    m_tilesSkipped += m_grid.size() - changedTiles;
+
+    MaskCounts counts;
+    if (complete || (m_fullFraction * static_cast<float>(m_grid.size()) < static_cast<float>(changedTiles))) {
+        m_segmenter.segment(frame, m_roi, blue, yellow, blueMask, yellowMask);
+        for (auto &tile : m_grid) {
+            storeReference(frame, tile);
+            tile.counts.blue = static_cast<uint32_t>(cv::countNonZero(blueMask(tile.area)));
+            tile.counts.yellow = static_cast<uint32_t>(cv::countNonZero(yellowMask(tile.area)));
+            counts.blue += tile.counts.blue;
+            counts.yellow += tile.counts.yellow;
+        }
+    } else {
+        for (size_t i = 0; i < m_grid.size(); i++) {
+            Tile &tile{m_grid[i]};
+            if (0 != m_changed[i]) {
+                storeReference(frame, tile);
+                segmentTile(frame, tile, blue, yellow, blueMask, yellowMask);
+            }
+            counts.blue += tile.counts.blue;
+            counts.yellow += tile.counts.yellow;
+        }
+    }
+
+    m_valid = true;
+    m_blue = blue;
+    m_yellow = yellow;
+    m_blueMask = blueMask.data;
+    m_yellowMask = yellowMask.data;
+    return counts;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCREMENTAL_SEGMENTATION_HPP
+#define INCREMENTAL_SEGMENTATION_HPP
+
+#include "segmentation.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Segmentation that only redoes the tiles of the ROI that changed since they
+ * were last segmented; the masks of the other tiles are kept from the
+ * previous frames. Consecutive frames are largely alike, so most tiles are
+ * skipped while the car stands or drives straight.
+ *
+ * Whether a tile changed is decided by the sum of absolute differences of
+ * every other pixel in every other row of the tile and the blur border
+ * around it against the same pixels when the tile was segmented last.
+ * Differences up to the noise level of the camera are left out of the sum,
+ * so that a small cone moving into a tile is not averaged away while sensor
+ * noise does not count; tiles whose sum exceeds the threshold are segmented
+ * again. Changes that fall between the sampled pixels or stay below these
+ * levels are missed, so the masks match a full segmentation only within
+ * that tolerance.
+ *
+ * Tiles are segmented with cv::blur, cv::cvtColor and cv::inRange on the
+ * tile in the frame, which blur across the tile borders like a full
+ * segmentation; if more tiles changed than fullFraction, the whole ROI is
+ * segmented with the given segmenter instead.
+ */
+class IncrementalSegmenter {
+   private:
+    IncrementalSegmenter(const IncrementalSegmenter &) = delete;
+    IncrementalSegmenter(IncrementalSegmenter &&) = delete;
+    IncrementalSegmenter &operator=(const IncrementalSegmenter &) = delete;
+    IncrementalSegmenter &operator=(IncrementalSegmenter &&) = delete;
+
+   public:
+    /**
+     * @param segmenter Segmenter for frames that changed too much.
+     * @param roi Region of interest of all frames.
+     * @param tileWidth Width of a tile in pixels.
+     * @param tileHeight Height of a tile in pixels.
+     * @param noise Absolute difference per sampled channel that is ignored.
+     * @param threshold Sum of the absolute differences beyond noise above which a tile changed.
+     * @param fullFraction Fraction of changed tiles above which the whole ROI is segmented.
+     */
+    IncrementalSegmenter(const Segmenter &segmenter, const cv::Rect &roi, uint32_t tileWidth = 32, uint32_t tileHeight = 16,
+                         uint32_t noise = 8, uint32_t threshold = 64, float fullFraction = 0.5f);
+
+    /**
+     * Same parameters and results as Segmenter::segment. The masks must be
+     * the ones passed for the previous frame and must not have been
+     * modified meanwhile; the first frame is segmented completely.
+     */
+    MaskCounts segment(const cv::Mat &frame, const ColorRange &blue, const ColorRange &yellow, cv::Mat &blueMask, cv::Mat &yellowMask);
+
+    // Segments the next frame completely, e.g. after the masks were drawn into.
+    void invalidate() noexcept;
+
+    // Tiles of all frames so far and how many of them were kept.
+    uint64_t tiles() const noexcept { return m_tilesSeen; }
+    uint64_t skippedTiles() const noexcept { return m_tilesSkipped; }
+
+    // Fraction of the tiles of all frames so far whose masks were kept.
+    double skippedFraction() const noexcept;
+
+   private:
+    struct Tile {
+        cv::Rect area{};    // in mask coordinates
+        cv::Rect sampled{}; // in frame coordinates, including the blur border
+        size_t firstSample{0};
+        MaskCounts counts{};
+    };
+
+    // Sum of the absolute differences beyond noise between a tile and its reference.
+    uint32_t difference(const cv::Mat &frame, const Tile &tile) const noexcept;
+    void storeReference(const cv::Mat &frame, const Tile &tile) noexcept;
+    void segmentTile(const cv::Mat &frame, Tile &tile, const ColorRange &blue, const ColorRange &yellow, cv::Mat &blueMask, cv::Mat &yellowMask);
+
+   private:
+    Segmenter m_segmenter;
+    cv::Rect m_roi;
+    int32_t m_noise;
+    uint32_t m_threshold;
+    float m_fullFraction;
+
+    std::vector<Tile> m_grid{};
+    std::vector<uint8_t> m_samples{};
+    std::vector<uint8_t> m_changed{};
+    cv::Mat m_blurred{};
+    cv::Mat m_hsv{};
+
+    bool m_valid{false};
+    ColorRange m_blue{};
+    ColorRange m_yellow{};
+    const void *m_blueMask{nullptr};
+    const void *m_yellowMask{nullptr};
+
+    uint64_t m_tilesSeen{0};
+    uint64_t m_tilesSkipped{0};
+};
+
+#endif
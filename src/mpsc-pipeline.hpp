@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPSC_PIPELINE_HPP
+#define MPSC_PIPELINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Hint to the CPU that the calling thread is spinning.
+inline void cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * Pipeline like cluon::NotifyingPipeline that calls a delegate for every
+ * entry on its own thread, but with a bounded lock-free ring instead of a
+ * std::deque behind a mutex: producers claim a slot with one compare-and-swap
+ * on the tail and publish it through the sequence number of the slot (the
+ * bounded queue by Dmitry Vyukov, with a single consumer). Slots are
+ * allocated once and reused; a full ring drops the entry and counts it.
+ *
+ * The consumer spins for a while when the ring runs empty, then yields and
+ * finally parks on a condition variable; producers only touch the mutex to
+ * wake a parked consumer.
+ */
+template <class T>
+class MPSCPipeline {
+   private:
+    MPSCPipeline(const MPSCPipeline &) = delete;
+    MPSCPipeline(MPSCPipeline &&) = delete;
+    MPSCPipeline &operator=(const MPSCPipeline &) = delete;
+    MPSCPipeline &operator=(MPSCPipeline &&) = delete;
+
+   public:
+    /**
+     * @param delegate Function to call for every entry.
+     * @param capacity Number of slots; rounded up to a power of two.
+     * @param spins Empty polls before the consumer yields and eventually parks;
+     *        ignored on single core machines where spinning only delays the producers.
+     */
+    explicit MPSCPipeline(std::function<void(T &&)> delegate, uint32_t capacity = 1024, uint32_t spins = 2000)
+        : m_delegate(std::move(delegate))
+        , m_spins((1 < std::thread::hardware_concurrency()) ? spins : 0)
+    {
+        uint32_t size{1};
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots.reset(new Slot[size]);
+        for (uint32_t i = 0; i < size; i++) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_pipelineThreadRunning.store(true);
+        m_pipelineThread = std::thread(&MPSCPipeline::processPipeline, this);
+    }
+
+    ~MPSCPipeline()
+    {
+        m_pipelineThreadRunning.store(false);
+        wakeConsumer();
+        if (m_pipelineThread.joinable()) {
+            m_pipelineThread.join();
+        }
+    }
+
+   public:
+    /**
+     * Adds an entry; safe to call from several threads at once.
+     *
+     * @return false if the ring is full and the entry was dropped.
+     */
+    bool add(T &&entry) noexcept
+    {
+        uint64_t position{m_tail.load(std::memory_order_relaxed)};
+        Slot *slot{nullptr};
+        for (;;) {
+            slot = &m_slots[position & m_mask];
+            const uint64_t sequence{slot->sequence.load(std::memory_order_acquire)};
+            const int64_t difference{static_cast<int64_t>(sequence) - static_cast<int64_t>(position)};
+            if (0 == difference) {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (0 > difference) {
+                // The consumer has not freed this slot from the previous lap yet.
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(entry);
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        // Pairs with the fence in processPipeline: either the consumer sees
+        // the entry before parking or we see that it parked.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_parked.load(std::memory_order_relaxed)) {
+            wakeConsumer();
+        }
+        return true;
+    }
+
+    bool isRunning() const noexcept { return m_pipelineThreadRunning.load(); }
+
+    // Entries dropped because the ring was full.
+    uint64_t dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Times the consumer parked, i.e. needed a wake-up through the condition variable.
+    uint64_t parked() const noexcept { return m_parkedCount.load(std::memory_order_relaxed); }
+
+   private:
+    bool available() const noexcept
+    {
+        return m_slots[m_head & m_mask].sequence.load(std::memory_order_acquire) == (m_head + 1);
+    }
+
+    void wakeConsumer() noexcept
+    {
+        std::lock_guard<std::mutex> lck(m_parkMutex);
+        m_parkCondition.notify_one();
+    }
+
+    void processPipeline() noexcept
+    {
+        constexpr uint32_t YIELDS{16};
+        uint32_t idle{0};
+        while (m_pipelineThreadRunning.load(std::memory_order_relaxed) || available()) {
+            if (available()) {
+                Slot &slot = m_slots[m_head & m_mask];
+                T entry{std::move(slot.value)};
+                slot.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+                m_head++;
+                idle = 0;
+                if (nullptr != m_delegate) {
+                    m_delegate(std::move(entry));
+                }
+            } else if (idle < m_spins) {
+                idle++;
+                cpuRelax();
+            } else if (idle < (m_spins + YIELDS)) {
+                idle++;
+                std::this_thread::yield();
+            } else {
+                m_parked.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                {
+                    std::unique_lock<std::mutex> lck(m_parkMutex);
+                    if (!available() && m_pipelineThreadRunning.load()) {
+                        m_parkedCount.fetch_add(1, std::memory_order_relaxed);
+                        m_parkCondition.wait_for(lck, std::chrono::milliseconds(20));
+                    }
+                }
+                m_parked.store(false, std::memory_order_relaxed);
+                idle = 0;
+            }
+        }
+    }
+
+   private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        T value{};
+    };
+
+    std::function<void(T &&)> m_delegate;
+    uint32_t m_spins{0};
+    uint64_t m_mask{0};
+    std::unique_ptr<Slot[]> m_slots{};
+
+    // Producers and the consumer write to different cache lines; padding
+    // instead of alignas as C++14 does not align heap allocations beyond
+    // the default.
+    char m_paddingBeforeTail[64]{};
+    std::atomic<uint64_t> m_tail{0};
+    char m_paddingBeforeHead[64]{};
+    uint64_t m_head{0};
+    std::atomic<bool> m_parked{false};
+    char m_paddingAfterHead[64]{};
+
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_parkedCount{0};
+
+    std::atomic<bool> m_pipelineThreadRunning{false};
+    std::thread m_pipelineThread{};
+    std::mutex m_parkMutex{};
+    std::condition_variable m_parkCondition{};
+};
+
+#endif
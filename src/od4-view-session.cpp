@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "od4-view-session.hpp"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+constexpr size_t OD4ViewSession::SEND_BUFFER_SIZE;
+constexpr uint32_t OD4SendBatch::CAPACITY;
+constexpr size_t OD4SendBatch::BUFFER_SIZE;
+
+OD4ViewSession::OD4ViewSession(uint16_t CID, EventLoop *loop)
+    : m_loop{loop}
+{
+    const std::string address{"225.0.0." + std::to_string(CID)};
+    m_sendToAddress.sin_family = AF_INET;
+    m_sendToAddress.sin_port = htons(12175);
+    ::inet_pton(AF_INET, address.c_str(), &m_sendToAddress.sin_addr);
+
+    // Bind to a random port like cluon::UDPSender; the receiver ignores datagrams from it.
+    m_socket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in sendFromAddress {};
+    sendFromAddress.sin_family = AF_INET;
+    socklen_t length{sizeof(sendFromAddress)};
+    if ((m_socket < 0) ||
+        (0 != ::bind(m_socket, reinterpret_cast<struct sockaddr *>(&sendFromAddress), sizeof(sendFromAddress))) ||
+        (0 != ::getsockname(m_socket, reinterpret_cast<struct sockaddr *>(&sendFromAddress), &length))) {
+        std::cerr << "[OD4ViewSession] Error while creating the sending socket: " << ::strerror(errno) << std::endl;
+    } else {
+        m_sendFromPort = ntohs(sendFromAddress.sin_port);
+    }
+
+    m_receiver = std::make_unique<UDPBatchReceiver>(
+        address,
+        12175,
+        [this](const UDPDatagram &datagram) { this->callback(datagram); },
+        m_sendFromPort /* filter out our own datagrams */,
+        32 /* datagrams per recvmmsg */,
+        std::chrono::microseconds(100) /* coalescing window for bursts */,
+        nullptr == m_loop /* own receiving thread */);
+    if ((nullptr != m_loop) && !(m_receiver->socket() < 0)) {
+        // The loop does the waiting; receive() collects without coalescing bursts.
+        m_loop->addReadable(m_receiver->socket(), [this]() { m_receiver->receive(); });
+    }
+}
+
+OD4ViewSession::~OD4ViewSession()
+{
+    if ((nullptr != m_loop) && !(m_receiver->socket() < 0)) {
+        m_loop->remove(m_receiver->socket());
+    }
+    m_receiver.reset();
+    if (!(m_socket < 0)) {
+        ::close(m_socket);
+    }
+}
+
+char *OD4ViewSession::sendBuffer()
+{
+    // One buffer per thread, so that threads send concurrently without a mutex.
+    static thread_local char buffer[SEND_BUFFER_SIZE];
+    return buffer;
+}
+
+bool OD4ViewSession::sendDatagram(const char *data, size_t size)
+{
+    // Every sendto() call sends a whole datagram; the socket needs no lock.
+    const ssize_t sent{::sendto(m_socket, data, size, 0, reinterpret_cast<const struct sockaddr *>(&m_sendToAddress), sizeof(m_sendToAddress))};
+    return static_cast<ssize_t>(size) == sent;
+}
+
+bool OD4ViewSession::send(OD4SendBatch &batch)
+{
+    struct iovec iov[OD4SendBatch::CAPACITY];
+    struct mmsghdr messages[OD4SendBatch::CAPACITY];
+    const uint32_t count{batch.m_count};
+    for (uint32_t i = 0; i < count; i++) {
+        iov[i].iov_base = batch.m_buffer + batch.m_offsets[i];
+        iov[i].iov_len = batch.m_sizes[i];
+        std::memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_name = &m_sendToAddress;
+        messages[i].msg_hdr.msg_namelen = sizeof(m_sendToAddress);
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    batch.clear();
+
+    // sendmmsg() may stop early, e.g. when the socket buffer is full; the rest is tried once more.
+    uint32_t sent{0};
+    for (uint32_t attempts = 0; (sent < count) && (attempts < 2); attempts++) {
+        const int result{::sendmmsg(m_socket, messages + sent, count - sent, 0)};
+        if (0 < result) {
+            sent += static_cast<uint32_t>(result);
+        } else if ((0 > result) && (EINTR != errno)) {
+            break;
+        }
+    }
+    return sent == count;
+}
+
+void OD4ViewSession::dataTrigger(int32_t messageIdentifier, Delegate delegate)
+{
+    std::lock_guard<std::mutex> lck(m_delegatesMutex);
+    auto it = std::find_if(m_delegates.begin(), m_delegates.end(),
+                           [messageIdentifier](const std::pair<int32_t, Delegate> &entry) { return entry.first == messageIdentifier; });
+    if (nullptr == delegate) {
+        if (it != m_delegates.end()) {
+            m_delegates.erase(it);
+        }
+    } else if (it != m_delegates.end()) {
+        it->second = std::move(delegate);
+    } else {
+        m_delegates.emplace_back(messageIdentifier, std::move(delegate));
+    }
+}
+
+bool OD4ViewSession::isRunning()
+{
+    return m_receiver->isRunning() && !cluon::TerminateHandler::instance().isTerminated.load();
+}
+
+UDPReceiveStatistics OD4ViewSession::statistics() const
+{
+    return m_receiver->statistics();
+}
+
+void OD4ViewSession::callback(const UDPDatagram &datagram)
+{
+    // One Envelope per datagram as sent by cluon::OD4Session.
+    uint32_t length{0};
+    if ((datagram.size < OD4_HEADER_SIZE) || !decodeOD4Header(datagram.data, length) || ((OD4_HEADER_SIZE + length) > datagram.size)) {
+        return;
+    }
+    EnvelopeView envelope;
+    if (!decodeEnvelopeView(datagram.data + OD4_HEADER_SIZE, length, envelope)) {
+        return;
+    }
+    envelope.received = datagram.received / 1000;
+
+    std::lock_guard<std::mutex> lck(m_delegatesMutex);
+    for (const auto &entry : m_delegates) {
+        if (entry.first == envelope.dataType) {
+            entry.second(envelope);
+            break;
+        }
+    }
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OD4_VIEW_SESSION_HPP
+#define OD4_VIEW_SESSION_HPP
+
+#include "cluon-complete.hpp"
+#include "envelope-view.hpp"
+#include "event-loop.hpp"
+#include "proto-view.hpp"
+#include "udp-batch-receiver.hpp"
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Envelopes collected for sending them at once with OD4ViewSession::send;
+ * they are encoded into a fixed buffer as they are added. cluon::OD4Session
+ * takes one Envelope per datagram, so every Envelope stays a datagram of its
+ * own and only the system call is shared.
+ */
+class OD4SendBatch {
+   private:
+    OD4SendBatch(const OD4SendBatch &) = delete;
+    OD4SendBatch(OD4SendBatch &&) = delete;
+    OD4SendBatch &operator=(const OD4SendBatch &) = delete;
+    OD4SendBatch &operator=(OD4SendBatch &&) = delete;
+
+   public:
+    static constexpr uint32_t CAPACITY{256};
+    static constexpr size_t BUFFER_SIZE{32768};
+
+    OD4SendBatch() = default;
+
+    /**
+     * Encodes a message like OD4ViewSession::send.
+     *
+     * @param sampleTimeStamp Time point in microseconds when the sample was captured (0 = sent time point).
+     * @return false if the batch is full; the message is not added then.
+     */
+    template <typename T>
+    bool add(T &message, int64_t sampleTimeStamp = 0, uint32_t senderStamp = 0) noexcept
+    {
+        if (CAPACITY == m_count) {
+            return false;
+        }
+        const int64_t sent{cluon::time::toMicroseconds(cluon::time::now())};
+        const size_t offset{(0 == m_count) ? 0 : m_offsets[m_count - 1] + m_sizes[m_count - 1]};
+        const size_t size{encodeEnvelope(m_buffer + offset, BUFFER_SIZE - offset, message, sent, (0 == sampleTimeStamp) ? sent : sampleTimeStamp, senderStamp)};
+        if (0 == size) {
+            return false;
+        }
+        m_offsets[m_count] = offset;
+        m_sizes[m_count] = size;
+        m_count++;
+        return true;
+    }
+
+    uint32_t count() const noexcept { return m_count; }
+    void clear() noexcept { m_count = 0; }
+
+   private:
+    friend class OD4ViewSession;
+
+    char m_buffer[BUFFER_SIZE];
+    size_t m_offsets[CAPACITY];
+    size_t m_sizes[CAPACITY];
+    uint32_t m_count{0};
+};
+
+/**
+ * OD4 session like cluon::OD4Session that hands EnvelopeViews into the
+ * received datagram to its delegates instead of cluon::data::Envelopes:
+ * cluon::OD4Session copies every datagram into a std::stringstream and the
+ * payload into the Envelope before a delegate gets to decode it again with
+ * cluon::extractMessage. Delegates decode the payload with decodeMessage
+ * (proto-view.hpp); the view points into the receive buffer of a
+ * UDPBatchReceiver and is only valid during the call, which happens on the
+ * receiving thread.
+ *
+ * Messages are sent without allocating: they are encoded with
+ * encodeEnvelope into a fixed buffer per sending thread and handed to
+ * sendto() directly, instead of going through two cluon::ToProtoVisitors,
+ * their std::stringstreams and a std::string per datagram.
+ *
+ * Given an EventLoop, the session starts no receiving thread of its own:
+ * its socket is added to the loop and the delegates are called on the
+ * thread that runs the loop.
+ */
+class OD4ViewSession {
+   private:
+    OD4ViewSession(const OD4ViewSession &) = delete;
+    OD4ViewSession(OD4ViewSession &&) = delete;
+    OD4ViewSession &operator=(const OD4ViewSession &) = delete;
+    OD4ViewSession &operator=(OD4ViewSession &&) = delete;
+
+   public:
+    typedef std::function<void(const EnvelopeView &envelope)> Delegate;
+
+    /**
+     * @param CID OpenDaVINCI v4 session identifier [1 .. 254]
+     * @param loop Event loop to receive on (nullptr = own receiving thread); must outlive the session.
+     */
+    explicit OD4ViewSession(uint16_t CID, EventLoop *loop = nullptr);
+    ~OD4ViewSession();
+
+    /**
+     * Sets the delegate for Envelopes with the given message identifier;
+     * passing nullptr removes it.
+     */
+    void dataTrigger(int32_t messageIdentifier, Delegate delegate);
+
+    bool isRunning();
+
+    UDPReceiveStatistics statistics() const;
+
+    /**
+     * Sends a message to this OD4 session like cluon::OD4Session::send.
+     *
+     * @param message Message to be sent.
+     * @param sampleTimeStamp Time point when this sample to be sent was captured (default = sent time point).
+     * @param senderStamp Optional sender stamp (default = 0).
+     * @return false if the message does not fit into a datagram or could not be sent.
+     */
+    template <typename T>
+    bool send(T &message, const cluon::data::TimeStamp &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0)
+    {
+        const int64_t sent{cluon::time::toMicroseconds(cluon::time::now())};
+        const int64_t sampled{(0 == (sampleTimeStamp.seconds() + sampleTimeStamp.microseconds())) ? sent : cluon::time::toMicroseconds(sampleTimeStamp)};
+        char *buffer{sendBuffer()};
+        const size_t size{encodeEnvelope(buffer, SEND_BUFFER_SIZE, message, sent, sampled, senderStamp)};
+        return (0 < size) && sendDatagram(buffer, size);
+    }
+
+    /**
+     * Sends all Envelopes of a batch with a single sendmmsg() call and
+     * clears it.
+     *
+     * @return false if not all of them could be sent.
+     */
+    bool send(OD4SendBatch &batch);
+
+   private:
+    // Largest UDP payload over IPv4.
+    static constexpr size_t SEND_BUFFER_SIZE{65507};
+
+    // Returns the encode buffer of the calling thread.
+    static char *sendBuffer();
+
+    bool sendDatagram(const char *data, size_t size);
+    void callback(const UDPDatagram &datagram);
+
+   private:
+    int m_socket{-1};
+    struct sockaddr_in m_sendToAddress {};
+    uint16_t m_sendFromPort{0};
+    std::unique_ptr<UDPBatchReceiver> m_receiver{nullptr};
+    EventLoop *m_loop{nullptr};
+
+    // Only a handful of message types are subscribed to; a flat vector is searched faster than a hash map.
+    std::mutex m_delegatesMutex{};
+    std::vector<std::pair<int32_t, Delegate>> m_delegates{};
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perception-objects.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+PerceptionObjects::PerceptionObjects(const CameraIntrinsics &intrinsics, uint32_t width, uint32_t height, const GroundProjection &ground)
+    : m_azimuth(width)
+    , m_zenith(height)
+    , m_ground(ground)
+{
+    for (uint32_t column = 0; column < width; column++) {
+        m_azimuth[column] = static_cast<float>(std::atan2(intrinsics.cx - column, intrinsics.fx));
+    }
+    for (uint32_t row = 0; row < height; row++) {
+        m_zenith[row] = static_cast<float>(std::atan2(intrinsics.cy - row, intrinsics.fy));
+    }
+}
+
+uint32_t PerceptionObjects::add(OD4SendBatch &batch, const ConeList &cones, uint32_t type, cv::Point offset, uint32_t firstObjectId, int64_t sampleTimeStamp) const noexcept
+{
+    uint32_t objectId{firstObjectId};
+    for (uint32_t i = 0; (i < cones.count) && (4 <= (OD4SendBatch::CAPACITY - batch.count())); i++) {
+        const cv::Rect &box{cones.boxes[i]};
+        const uint32_t column{std::min(static_cast<uint32_t>(offset.x + box.x + box.width / 2), static_cast<uint32_t>(m_azimuth.size() - 1))};
+        const uint32_t row{std::min(static_cast<uint32_t>(offset.y + box.y + box.height / 2), static_cast<uint32_t>(m_zenith.size() - 1))};
+
+        opendlv::logic::perception::Object object;
+        object.objectId(objectId);
+        opendlv::logic::perception::ObjectType objectType;
+        objectType.objectId(objectId).type(type);
+        opendlv::logic::perception::ObjectDirection direction;
+        direction.objectId(objectId).azimuthAngle(m_azimuth[column]).zenithAngle(m_zenith[row]);
+        opendlv::logic::perception::ObjectDistance distance;
+        distance.objectId(objectId).distance(m_ground.footOf(box).distance);
+        batch.add(object, sampleTimeStamp);
+        batch.add(objectType, sampleTimeStamp);
+        batch.add(direction, sampleTimeStamp);
+        batch.add(distance, sampleTimeStamp);
+        objectId++;
+    }
+    return objectId;
+}
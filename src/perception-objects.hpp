@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERCEPTION_OBJECTS_HPP
+#define PERCEPTION_OBJECTS_HPP
+
+#include "cone-detection.hpp"
+#include "ground-projection.hpp"
+#include "od4-view-session.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Values of opendlv.logic.perception.ObjectType for the cones we detect.
+constexpr uint32_t OBJECT_TYPE_BLUE_CONE{1};
+constexpr uint32_t OBJECT_TYPE_YELLOW_CONE{2};
+
+/**
+ * Turns the cones found in a frame into opendlv.logic.perception.Object,
+ * ObjectType, ObjectDirection and ObjectDistance messages, so that other
+ * microservices can use our detections instead of segmenting the same
+ * frames again.
+ *
+ * Angles come from tables with one entry per column and per row of the
+ * frame that are computed once from the camera intrinsics; the distance of
+ * a cone is looked up in the ground projection at the centre of its lower
+ * edge. Azimuth is positive to the left and zenith positive upwards of the
+ * optical axis, both in radians; distances are in metres on the ground.
+ */
+class PerceptionObjects {
+   private:
+    PerceptionObjects(const PerceptionObjects &) = delete;
+    PerceptionObjects(PerceptionObjects &&) = delete;
+    PerceptionObjects &operator=(const PerceptionObjects &) = delete;
+    PerceptionObjects &operator=(PerceptionObjects &&) = delete;
+
+   public:
+    /**
+     * @param intrinsics Intrinsics of the camera.
+     * @param width Width of the frame in pixels.
+     * @param height Height of the frame in pixels.
+     * @param ground Ground projection of the crop zone; must outlive this object.
+     */
+    PerceptionObjects(const CameraIntrinsics &intrinsics, uint32_t width, uint32_t height, const GroundProjection &ground);
+
+    float azimuth(uint32_t column) const noexcept { return m_azimuth[column]; }
+    float zenith(uint32_t row) const noexcept { return m_zenith[row]; }
+
+    /**
+     * Adds the messages for all cones of a list to a batch; boxes are in
+     * coordinates of the crop zone, which starts at offset in the frame. Objects are numbered per frame
+     * starting at firstObjectId.
+     *
+     * @return Object identifier for the next cone; cones that do not fit into the batch are left out.
+     */
+    uint32_t add(OD4SendBatch &batch, const ConeList &cones, uint32_t type, cv::Point offset, uint32_t firstObjectId, int64_t sampleTimeStamp) const noexcept;
+
+   private:
+    std::vector<float> m_azimuth{};
+    std::vector<float> m_zenith{};
+    const GroundProjection &m_ground;
+};
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROTO_VIEW_HPP
+#define PROTO_VIEW_HPP
+
+#include "envelope-view.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+/**
+ * Decodes Protobuf encoded messages straight from a buffer into a message
+ * generated by cluon-msc. It is a visitor like cluon::FromProtoVisitor, which
+ * needs a std::istream and hence a copy of the buffer; only std::string fields
+ * of the message are copied.
+ */
+class ProtoViewDecoder {
+   private:
+    ProtoViewDecoder(const ProtoViewDecoder &) = delete;
+    ProtoViewDecoder(ProtoViewDecoder &&) = delete;
+    ProtoViewDecoder &operator=(const ProtoViewDecoder &) = delete;
+    ProtoViewDecoder &operator=(ProtoViewDecoder &&) = delete;
+
+   public:
+    ProtoViewDecoder() = default;
+    ~ProtoViewDecoder() = default;
+
+    /**
+     * Decodes the message in [data, data + size) into message; fields that are
+     * not in the buffer keep their value.
+     *
+     * @return false if the buffer is truncated or malformed.
+     */
+    template <typename T>
+    bool decode(const char *data, size_t size, T &message) noexcept
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+        const uint8_t *end = p + size;
+        while (p < end) {
+            uint64_t key{0};
+            if (!readVarInt(p, end, key)) {
+                return false;
+            }
+            switch (key & 0x7) {
+                case 0: // Varint
+                    if (!readVarInt(p, end, m_value)) {
+                        return false;
+                    }
+                    break;
+                case 1: // 8 bytes
+                    if ((end - p) < 8) {
+                        return false;
+                    }
+                    m_value = readLittleEndian(p, 8);
+                    p += 8;
+                    break;
+                case 5: // 4 bytes
+                    if ((end - p) < 4) {
+                        return false;
+                    }
+                    m_value = readLittleEndian(p, 4);
+                    p += 4;
+                    break;
+                case 2: // Length-delimited
+                    if (!readVarInt(p, end, m_value) || (m_value > static_cast<uint64_t>(end - p))) {
+                        return false;
+                    }
+                    m_data = reinterpret_cast<const char *>(p);
+                    p += m_value;
+                    break;
+                default:
+                    return false;
+            }
+            message.accept(static_cast<uint32_t>(key >> 3), *this);
+        }
+        return true;
+    }
+
+   public:
+    // Visitor interface used by the accept(fieldId, visitor) methods of the messages.
+    void preVisit(int32_t, const std::string &, const std::string &) noexcept {}
+    void postVisit() noexcept {}
+
+    void visit(uint32_t, std::string &&, std::string &&, bool &v) noexcept { v = (0 != m_value); }
+    void visit(uint32_t, std::string &&, std::string &&, char &v) noexcept { v = static_cast<char>(m_value); }
+    void visit(uint32_t, std::string &&, std::string &&, int8_t &v) noexcept { v = static_cast<int8_t>(fromZigZag(m_value)); }
+    void visit(uint32_t, std::string &&, std::string &&, uint8_t &v) noexcept { v = static_cast<uint8_t>(m_value); }
+    void visit(uint32_t, std::string &&, std::string &&, int16_t &v) noexcept { v = static_cast<int16_t>(fromZigZag(m_value)); }
+    void visit(uint32_t, std::string &&, std::string &&, uint16_t &v) noexcept { v = static_cast<uint16_t>(m_value); }
+    void visit(uint32_t, std::string &&, std::string &&, int32_t &v) noexcept { v = static_cast<int32_t>(fromZigZag(m_value)); }
+    void visit(uint32_t, std::string &&, std::string &&, uint32_t &v) noexcept { v = static_cast<uint32_t>(m_value); }
+    void visit(uint32_t, std::string &&, std::string &&, int64_t &v) noexcept { v = fromZigZag(m_value); }
+    void visit(uint32_t, std::string &&, std::string &&, uint64_t &v) noexcept { v = m_value; }
+    void visit(uint32_t, std::string &&, std::string &&, float &v) noexcept
+    {
+        const uint32_t bits = static_cast<uint32_t>(m_value);
+        std::memcpy(&v, &bits, sizeof(v));
+    }
+    void visit(uint32_t, std::string &&, std::string &&, double &v) noexcept { std::memcpy(&v, &m_value, sizeof(v)); }
+    void visit(uint32_t, std::string &&, std::string &&, std::string &v) noexcept { v.assign(m_data, static_cast<size_t>(m_value)); }
+
+    // Nested messages.
+    template <typename T>
+    void visit(uint32_t &, std::string &&, std::string &&, T &v) noexcept
+    {
+        ProtoViewDecoder nested;
+        nested.decode(m_data, static_cast<size_t>(m_value), v);
+    }
+
+   private:
+    static bool readVarInt(const uint8_t *&p, const uint8_t *end, uint64_t &value) noexcept
+    {
+        value = 0;
+        for (uint32_t shift = 0; (p < end) && (shift < 64); shift += 7) {
+            const uint8_t byte = *p++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (0 == (byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint64_t readLittleEndian(const uint8_t *p, uint32_t bytes) noexcept
+    {
+        uint64_t value{0};
+        for (uint32_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(p[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    static int64_t fromZigZag(uint64_t v) noexcept
+    {
+        return static_cast<int64_t>((v >> 1) ^ (~(v & 1) + 1));
+    }
+
+   private:
+    uint64_t m_value{0};
+    const char *m_data{nullptr};
+};
+
+/**
+ * Decodes the payload of an Envelope into a message without copying it first,
+ * replacing cluon::extractMessage.
+ *
+ * @return false if the Envelope carries a different message or the payload is malformed.
+ */
+template <typename T>
+bool decodeMessage(const EnvelopeView &envelope, T &message) noexcept
+{
+    if (T::ID() != envelope.dataType) {
+        return false;
+    }
+    ProtoViewDecoder decoder;
+    return decoder.decode(envelope.serializedData, envelope.serializedDataSize, message);
+}
+
+/**
+ * Encodes a message generated by cluon-msc into a caller-provided buffer,
+ * byte for byte like cluon::ToProtoVisitor, which writes into a
+ * std::stringstream and allocates for every message and every nested one.
+ * Nested messages are written in place behind a one byte length that is
+ * widened afterwards if needed.
+ */
+class ProtoViewEncoder {
+   private:
+    ProtoViewEncoder(const ProtoViewEncoder &) = delete;
+    ProtoViewEncoder(ProtoViewEncoder &&) = delete;
+    ProtoViewEncoder &operator=(const ProtoViewEncoder &) = delete;
+    ProtoViewEncoder &operator=(ProtoViewEncoder &&) = delete;
+
+   public:
+    ProtoViewEncoder(char *buffer, size_t capacity) noexcept
+        : m_position(reinterpret_cast<uint8_t *>(buffer))
+        , m_end(reinterpret_cast<uint8_t *>(buffer) + capacity)
+    {
+    }
+    ~ProtoViewEncoder() = default;
+
+    /**
+     * Writes the fields of message. The fields are visited one by one through
+     * accept(fieldId, visitor) in the order of their identifiers, which is the
+     * order in which all messages of the OpenDLV Standard Message Set declare
+     * them; accept(visitor) would construct the names of the message as
+     * std::strings for preVisit first.
+     */
+    template <typename T>
+    void encodeFields(T &message) noexcept
+    {
+        // Largest gap between the identifiers of two fields in a message.
+        constexpr uint32_t MAX_FIELD_GAP{8};
+        uint32_t misses{0};
+        for (uint32_t id = 1; misses < MAX_FIELD_GAP; id++) {
+            m_visited = false;
+            message.accept(id, *this);
+            misses = m_visited ? 0 : misses + 1;
+        }
+    }
+
+    // Returns the position after the last byte written.
+    char *position() const noexcept { return reinterpret_cast<char *>(m_position); }
+
+    // Returns false if the buffer was too small; the content is undefined then.
+    bool valid() const noexcept { return !m_overflow; }
+
+   public:
+    // Visitor interface used by the accept(visitor) methods of the messages.
+    void preVisit(int32_t, const std::string &, const std::string &) noexcept {}
+    void postVisit() noexcept {}
+
+    void visit(uint32_t id, std::string &&, std::string &&, bool &v) noexcept { writeKeyValue(id, v ? 1 : 0); }
+    void visit(uint32_t id, std::string &&, std::string &&, char &v) noexcept { writeKeyValue(id, static_cast<uint8_t>(v)); }
+    void visit(uint32_t id, std::string &&, std::string &&, int8_t &v) noexcept { writeKeyValue(id, static_cast<uint8_t>(toZigZag(v))); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint8_t &v) noexcept { writeKeyValue(id, v); }
+    void visit(uint32_t id, std::string &&, std::string &&, int16_t &v) noexcept { writeKeyValue(id, static_cast<uint16_t>(toZigZag(v))); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint16_t &v) noexcept { writeKeyValue(id, v); }
+    void visit(uint32_t id, std::string &&, std::string &&, int32_t &v) noexcept { writeKeyValue(id, static_cast<uint32_t>(toZigZag(v))); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint32_t &v) noexcept { writeKeyValue(id, v); }
+    void visit(uint32_t id, std::string &&, std::string &&, int64_t &v) noexcept { writeKeyValue(id, toZigZag(v)); }
+    void visit(uint32_t id, std::string &&, std::string &&, uint64_t &v) noexcept { writeKeyValue(id, v); }
+    void visit(uint32_t id, std::string &&, std::string &&, float &v) noexcept
+    {
+        uint32_t bits{0};
+        std::memcpy(&bits, &v, sizeof(bits));
+        m_visited = true;
+        writeVarInt((static_cast<uint64_t>(id) << 3) | 5);
+        writeLittleEndian(bits, 4);
+    }
+    void visit(uint32_t id, std::string &&, std::string &&, double &v) noexcept
+    {
+        uint64_t bits{0};
+        std::memcpy(&bits, &v, sizeof(bits));
+        m_visited = true;
+        writeVarInt((static_cast<uint64_t>(id) << 3) | 1);
+        writeLittleEndian(bits, 8);
+    }
+    void visit(uint32_t id, std::string &&, std::string &&, std::string &v) noexcept { writeBytes(id, v.data(), v.size()); }
+
+    // Nested messages.
+    template <typename T>
+    void visit(uint32_t &id, std::string &&, std::string &&, T &v) noexcept
+    {
+        uint8_t *length{beginField(id)};
+        encodeFields(v);
+        endField(length);
+        m_visited = true;
+    }
+
+    /**
+     * Writes a length-delimited field whose content is written by the caller
+     * between beginField and endField, e.g. the payload of an Envelope.
+     */
+    uint8_t *beginField(uint32_t id) noexcept
+    {
+        writeVarInt((static_cast<uint64_t>(id) << 3) | 2);
+        uint8_t *length{m_position};
+        writeVarInt(0);
+        return length;
+    }
+    void endField(uint8_t *length) noexcept { finishLength(length, length + 1); }
+
+    void writeKeyValue(uint32_t id, uint64_t value) noexcept
+    {
+        m_visited = true;
+        writeVarInt(static_cast<uint64_t>(id) << 3);
+        writeVarInt(value);
+    }
+
+    void writeBytes(uint32_t id, const char *data, size_t size) noexcept
+    {
+        m_visited = true;
+        writeVarInt((static_cast<uint64_t>(id) << 3) | 2);
+        writeVarInt(size);
+        if (static_cast<size_t>(m_end - m_position) < size) {
+            m_overflow = true;
+            m_position = m_end;
+            return;
+        }
+        std::memcpy(m_position, data, size);
+        m_position += size;
+    }
+
+    static uint64_t toZigZag(int64_t v) noexcept
+    {
+        return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+    }
+
+   private:
+    void writeVarInt(uint64_t v) noexcept
+    {
+        do {
+            if (m_position == m_end) {
+                m_overflow = true;
+                return;
+            }
+            *m_position++ = static_cast<uint8_t>((v & 0x7F) | ((0x7F < v) ? 0x80 : 0));
+            v >>= 7;
+        } while (0 < v);
+    }
+
+    void writeLittleEndian(uint64_t v, uint32_t bytes) noexcept
+    {
+        if (static_cast<size_t>(m_end - m_position) < bytes) {
+            m_overflow = true;
+            m_position = m_end;
+            return;
+        }
+        for (uint32_t i = 0; i < bytes; i++) {
+            *m_position++ = static_cast<uint8_t>(v >> (8 * i));
+        }
+    }
+
+    // Stores the length of the content [begin, m_position) in the one byte
+    // reserved at length and moves the content if the length needs more.
+    void finishLength(uint8_t *length, uint8_t *begin) noexcept
+    {
+        if (m_overflow) {
+            return;
+        }
+        uint64_t size{static_cast<uint64_t>(m_position - begin)};
+        uint32_t bytes{1};
+        for (uint64_t v = size; 0x7F < v; v >>= 7) {
+            bytes++;
+        }
+        if (1 < bytes) {
+            if (static_cast<size_t>(m_end - m_position) < (bytes - 1)) {
+                m_overflow = true;
+                return;
+            }
+            std::memmove(begin + bytes - 1, begin, static_cast<size_t>(size));
+            m_position += bytes - 1;
+        }
+        for (uint32_t i = 0; i < bytes; i++, size >>= 7) {
+            length[i] = static_cast<uint8_t>((size & 0x7F) | ((i + 1 < bytes) ? 0x80 : 0));
+        }
+    }
+
+   private:
+    uint8_t *m_position{nullptr};
+    uint8_t *m_end{nullptr};
+    bool m_overflow{false};
+    bool m_visited{false};
+};
+
+/**
+ * Encodes message as payload of an Envelope with OD4 header into buffer,
+ * byte for byte like cluon::serializeEnvelope; the received time stamp is
+ * left empty. Time stamps are in microseconds.
+ *
+ * @return Bytes written or 0 if the buffer is too small.
+ */
+template <typename T>
+size_t encodeEnvelope(char *buffer, size_t capacity, T &message, int64_t sent, int64_t sampleTimeStamp, uint32_t senderStamp) noexcept
+{
+    if (capacity < OD4_HEADER_SIZE) {
+        return 0;
+    }
+    ProtoViewEncoder encoder{buffer + OD4_HEADER_SIZE, capacity - OD4_HEADER_SIZE};
+    encoder.writeKeyValue(1, ProtoViewEncoder::toZigZag(static_cast<int32_t>(T::ID())));
+    uint8_t *payload{encoder.beginField(2)};
+    encoder.encodeFields(message);
+    encoder.endField(payload);
+    const int64_t timeStamps[3] = {sent, 0, sampleTimeStamp};
+    for (uint32_t i = 0; i < 3; i++) {
+        // cluon::data::TimeStamp with seconds = 1 and microseconds = 2.
+        uint8_t *timeStamp{encoder.beginField(3 + i)};
+        encoder.writeKeyValue(1, ProtoViewEncoder::toZigZag(static_cast<int32_t>(timeStamps[i] / 1000000)));
+        encoder.writeKeyValue(2, ProtoViewEncoder::toZigZag(static_cast<int32_t>(timeStamps[i] % 1000000)));
+        encoder.endField(timeStamp);
+    }
+    encoder.writeKeyValue(6, senderStamp);
+    if (!encoder.valid()) {
+        return 0;
+    }
+    const size_t length{static_cast<size_t>(encoder.position() - buffer) - OD4_HEADER_SIZE};
+    if (0xFFFFFF < length) {
+        return 0;
+    }
+    buffer[0] = static_cast<char>(0x0D);
+    buffer[1] = static_cast<char>(0xA4);
+    buffer[2] = static_cast<char>(length & 0xFF);
+    buffer[3] = static_cast<char>((length >> 8) & 0xFF);
+    buffer[4] = static_cast<char>((length >> 16) & 0xFF);
+    return OD4_HEADER_SIZE + length;
+}
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "proto-view.hpp"
+#include "recorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+Recorder::Recorder(const std::string &file, int width, int firstRow, int rows, FrameCodec codec, uint32_t encoders, uint32_t buffers)
+    : m_file(file, std::ios::out | std::ios::binary | std::ios::trunc)
+    , m_width(width)
+    , m_firstRow(firstRow)
+    , m_rows(rows)
+    , m_codec(codec)
+    , m_toEncode(buffers, nullptr)
+{
+    if (!m_file.good()) {
+        std::cerr << "[Recorder] Could not create " << file << "." << std::endl;
+        return;
+    }
+    for (uint32_t i = 0; i < buffers; i++) {
+        m_frames.emplace_back(new Frame());
+        m_frames.back()->pixels.resize(static_cast<size_t>(width) * static_cast<size_t>(rows) * 4);
+        m_free.push_back(m_frames.back().get());
+    }
+    for (uint32_t i = 0; i < std::max(encoders, 1U); i++) {
+        m_encoders.emplace_back([this]() { encode(); });
+    }
+    // Room for the frames and for the Envelopes received while they wait.
+    m_pipeline.reset(new MPSCPipeline<Entry>([this](Entry &&entry) { write(std::move(entry)); }, buffers + 256));
+}
+
+Recorder::~Recorder()
+{
+    m_pipeline.reset();
+    {
+        std::lock_guard<std::mutex> lck(m_encodeMutex);
+        m_stopEncoders = true;
+    }
+    m_encodeCondition.notify_all();
+    for (auto &encoder : m_encoders) {
+        encoder.join();
+    }
+}
+
+bool Recorder::valid() const
+{
+    return nullptr != m_pipeline;
+}
+
+Recorder::Frame *Recorder::snapshot(const cv::Mat &frame) noexcept
+{
+    Frame *snapshot{nullptr};
+    {
+        std::lock_guard<std::mutex> lck(m_freeMutex);
+        if (!m_free.empty()) {
+            snapshot = m_free.back();
+            m_free.pop_back();
+        }
+    }
+    if (nullptr == snapshot) {
+        m_droppedFrames++;
+        return nullptr;
+    }
+    const size_t rowSize{static_cast<size_t>(m_width) * 4};
+    for (int y = 0; y < m_rows; y++) {
+        std::memcpy(snapshot->pixels.data() + static_cast<size_t>(y) * rowSize, frame.ptr<uint8_t>(m_firstRow + y), rowSize);
+    }
+    snapshot->done = false;
+    return snapshot;
+}
+
+void Recorder::commit(Frame *frame, int64_t sampleTimeStamp) noexcept
+{
+    Entry entry;
+    entry.frame = frame;
+    entry.dataType = opendlv::proxy::ImageReading::ID();
+    entry.senderStamp = static_cast<uint32_t>(m_firstRow);
+    entry.sampleTimeStamp = sampleTimeStamp;
+    // Queued for writing first, so that the frame keeps its place among the Envelopes.
+    if (!m_pipeline->add(std::move(entry))) {
+        m_droppedFrames++;
+        release(frame);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lck(m_encodeMutex);
+        m_toEncode[(m_toEncodeHead + m_toEncodeCount) % m_toEncode.size()] = frame;
+        m_toEncodeCount++;
+    }
+    m_encodeCondition.notify_one();
+}
+
+void Recorder::discard(Frame *frame) noexcept
+{
+    release(frame);
+}
+
+void Recorder::add(const EnvelopeView &envelope) noexcept
+{
+    Entry entry;
+    entry.dataType = envelope.dataType;
+    entry.senderStamp = envelope.senderStamp;
+    entry.sent = envelope.sent;
+    entry.received = envelope.received;
+    entry.sampleTimeStamp = envelope.sampleTimeStamp;
+    entry.serializedData.assign(envelope.serializedData, envelope.serializedDataSize);
+    if (!m_pipeline->add(std::move(entry))) {
+        m_droppedEnvelopes++;
+    }
+}
+
+void Recorder::addSteering(float steeringAngle, int64_t sampleTimeStamp) noexcept
+{
+    opendlv::proxy::GroundSteeringRequest request;
+    request.groundSteering(steeringAngle);
+    cluon::ToProtoVisitor protoEncoder;
+    request.accept(protoEncoder);
+
+    Entry entry;
+    entry.dataType = opendlv::proxy::GroundSteeringRequest::ID();
+    entry.senderStamp = RECORDED_STEERING_SENDER_STAMP;
+    entry.sampleTimeStamp = sampleTimeStamp;
+    entry.serializedData = protoEncoder.encodedData();
+    if (!m_pipeline->add(std::move(entry))) {
+        m_droppedEnvelopes++;
+    }
+}
+
+void Recorder::release(Frame *frame) noexcept
+{
+    std::lock_guard<std::mutex> lck(m_freeMutex);
+    m_free.push_back(frame);
+}
+
+void Recorder::encode()
+{
+    cv::Mat scratch;
+    while (true) {
+        Frame *frame{nullptr};
+        {
+            std::unique_lock<std::mutex> lck(m_encodeMutex);
+            m_encodeCondition.wait(lck, [this]() { return m_stopEncoders || (0 != m_toEncodeCount); });
+            if (0 == m_toEncodeCount) {
+                return;
+            }
+            frame = m_toEncode[m_toEncodeHead];
+            m_toEncodeHead = (m_toEncodeHead + 1) % m_toEncode.size();
+            m_toEncodeCount--;
+        }
+        const cv::Mat rows(m_rows, m_width, CV_8UC4, frame->pixels.data());
+        const bool encoded{encodeFrame(m_codec, rows, frame->encoded, scratch)};
+        {
+            std::lock_guard<std::mutex> lck(m_encodeMutex);
+            frame->encodedOk = encoded;
+            frame->done = true;
+        }
+        m_encodedCondition.notify_all();
+    }
+}
+
+void Recorder::write(Entry &&entry)
+{
+    if (nullptr != entry.frame) {
+        Frame *frame{entry.frame};
+        {
+            std::unique_lock<std::mutex> lck(m_encodeMutex);
+            m_encodedCondition.wait(lck, [frame]() { return frame->done; });
+        }
+        const bool encoded{frame->encodedOk};
+        if (encoded) {
+            opendlv::proxy::ImageReading image;
+            image.fourcc(fourccOf(m_codec)).width(static_cast<uint32_t>(m_width)).height(static_cast<uint32_t>(m_rows));
+            image.data(std::string(reinterpret_cast<const char *>(frame->encoded.data()), frame->encoded.size()));
+            cluon::ToProtoVisitor protoEncoder;
+            image.accept(protoEncoder);
+            entry.serializedData = protoEncoder.encodedData();
+            m_frameBytes += frame->encoded.size();
+        }
+        release(frame);
+        if (!encoded) {
+            return;
+        }
+    }
+
+    // Frames and steering angles are stamped when they are written.
+    const int64_t now{cluon::time::toMicroseconds(cluon::time::now())};
+    cluon::data::Envelope envelope;
+    envelope.dataType(entry.dataType)
+        .serializedData(std::move(entry.serializedData))
+        .senderStamp(entry.senderStamp)
+        .sent(cluon::time::fromMicroseconds((0 != entry.sent) ? entry.sent : now))
+        .received(cluon::time::fromMicroseconds((0 != entry.received) ? entry.received : now))
+        .sampleTimeStamp(cluon::time::fromMicroseconds(entry.sampleTimeStamp));
+    const std::string serialized{cluon::serializeEnvelope(std::move(envelope))};
+    m_file.write(serialized.data(), static_cast<std::streamsize>(serialized.size()));
+    m_written++;
+}
+
+std::vector<RecordingEntry> recordedOrder(const Recording &recording)
+{
+    std::vector<RecordingEntry> entries{recording.index()};
+    std::sort(entries.begin(), entries.end(), [](const RecordingEntry &a, const RecordingEntry &b) { return a.offset < b.offset; });
+    return entries;
+}
+
+bool decodeRecordedFrame(const EnvelopeView &envelope, cv::Mat &frame, cv::Rect *decoded)
+{
+    opendlv::proxy::ImageReading image;
+    if (!decodeMessage(envelope, image) || !frame.isContinuous() || (static_cast<int>(image.width()) != frame.cols) ||
+        (static_cast<int>(envelope.senderStamp + image.height()) > frame.rows)) {
+        return false;
+    }
+    // The recorded rows are a view into frame.
+    cv::Mat rows(static_cast<int>(image.height()), frame.cols, CV_8UC4, frame.ptr<uint8_t>(static_cast<int>(envelope.senderStamp)));
+    if (!decodeFrame(image.fourcc(), image.data(), rows)) {
+        return false;
+    }
+    if (nullptr != decoded) {
+        *decoded = cv::Rect(0, static_cast<int>(envelope.senderStamp), frame.cols, rows.rows);
+    }
+    return true;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include "envelope-view.hpp"
+#include "frame-codec.hpp"
+#include "mpsc-pipeline.hpp"
+#include "recording.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Steering angles computed by the microservice are recorded as opendlv.proxy.GroundSteeringRequest with this sender stamp.
+constexpr uint32_t RECORDED_STEERING_SENDER_STAMP{9000};
+
+/**
+ * Records what the steering microservice consumes, in the order it consumes
+ * it, into a .rec file of Envelopes as written by cluon::Recorder:
+ *
+ * - the rows of every processed frame that the segmentation reads (the crop
+ *   zone and the rows above and below it that the blur needs), compressed
+ *   with a FrameCodec into an opendlv.proxy.ImageReading, with the sample
+ *   time stamp of the frame and the first row as senderStamp,
+ * - every received Envelope unchanged, and
+ * - the computed steering angle of every frame (RECORDED_STEERING_SENDER_STAMP).
+ *
+ * The control loop only copies the rows into one of a few preallocated
+ * buffers and queues it. A pool of encoder threads compresses the queued
+ * frames in parallel, and the thread of an MPSCPipeline writes everything in
+ * the order it was queued, waiting for a frame's encoder if it gets there
+ * first. If all buffers are waiting, the frame is not recorded and counted as
+ * dropped, so that slow encoders or a slow disk never stall the loop.
+ */
+class Recorder {
+   private:
+    Recorder(const Recorder &) = delete;
+    Recorder(Recorder &&) = delete;
+    Recorder &operator=(const Recorder &) = delete;
+    Recorder &operator=(Recorder &&) = delete;
+
+   public:
+    // Copy of the recorded rows of one frame and their encoding.
+    struct Frame {
+        std::vector<uint8_t> pixels{};
+        std::vector<uint8_t> encoded{};
+        bool encodedOk{false};
+        bool done{false};
+    };
+
+    /**
+     * @param file .rec file to create.
+     * @param width Width of the frames (4 bytes per pixel).
+     * @param firstRow First frame row to record.
+     * @param rows Number of rows to record.
+     * @param codec Compression of the frames.
+     * @param encoders Threads that compress frames.
+     * @param buffers Frames that may wait for compression at once.
+     */
+    Recorder(const std::string &file, int width, int firstRow, int rows, FrameCodec codec = FrameCodec::PNG,
+             uint32_t encoders = 2, uint32_t buffers = 8);
+    ~Recorder();
+
+    // Returns true if the file could be created.
+    bool valid() const;
+
+    /**
+     * Copies the recorded rows of frame (CV_8UC4) into a free buffer, which
+     * must be handed to either commit() or discard().
+     *
+     * @return nullptr if all buffers are in use; the frame is counted as dropped.
+     */
+    Frame *snapshot(const cv::Mat &frame) noexcept;
+
+    // Queues a snapshot for compression and recording.
+    void commit(Frame *frame, int64_t sampleTimeStamp) noexcept;
+
+    // Returns a snapshot of a frame that was not processed after all.
+    void discard(Frame *frame) noexcept;
+
+    // Records a received Envelope.
+    void add(const EnvelopeView &envelope) noexcept;
+
+    // Records the steering angle computed for the last frame.
+    void addSteering(float steeringAngle, int64_t sampleTimeStamp) noexcept;
+
+    // Frames not recorded because no buffer was free.
+    uint64_t droppedFrames() const noexcept { return m_droppedFrames; }
+    // Envelopes and steering angles not recorded because the queue was full.
+    uint64_t droppedEnvelopes() const noexcept { return m_droppedEnvelopes; }
+    // Envelopes written so far.
+    uint64_t written() const noexcept { return m_written.load(); }
+    // Bytes of compressed frames written so far.
+    uint64_t frameBytes() const noexcept { return m_frameBytes.load(); }
+
+   private:
+    struct Entry {
+        Frame *frame{nullptr};
+        int32_t dataType{0};
+        uint32_t senderStamp{0};
+        int64_t sent{0};
+        int64_t received{0};
+        int64_t sampleTimeStamp{0};
+        std::string serializedData{};
+    };
+
+    void encode();
+    void write(Entry &&entry);
+    void release(Frame *frame) noexcept;
+
+   private:
+    std::ofstream m_file;
+    int m_width;
+    int m_firstRow;
+    int m_rows;
+    FrameCodec m_codec;
+    std::vector<std::unique_ptr<Frame>> m_frames{};
+    std::mutex m_freeMutex{};
+    std::vector<Frame *> m_free{};
+    uint64_t m_droppedFrames{0};
+    uint64_t m_droppedEnvelopes{0};
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_frameBytes{0};
+
+    // Frames waiting for an encoder in a ring of one slot per buffer, and the encoders.
+    std::mutex m_encodeMutex{};
+    std::condition_variable m_encodeCondition{};
+    std::condition_variable m_encodedCondition{};
+    std::vector<Frame *> m_toEncode{};
+    size_t m_toEncodeHead{0};
+    size_t m_toEncodeCount{0};
+    bool m_stopEncoders{false};
+    std::vector<std::thread> m_encoders{};
+
+    // Stopped first in the destructor: its thread drains the queue while the encoders still run.
+    std::unique_ptr<MPSCPipeline<Entry>> m_pipeline{};
+};
+
+// Returns the entries of a recording made by Recorder in the order they were recorded, i.e. consumed.
+std::vector<RecordingEntry> recordedOrder(const Recording &recording);
+
+/**
+ * Decodes a frame recorded by Recorder into the rows of frame (CV_8UC4) it
+ * was taken from; the other rows are left unchanged.
+ *
+ * @param decoded Receives the part of frame that was decoded if not nullptr.
+ * @return false if the Envelope holds no recorded frame or it does not fit into frame.
+ */
+bool decodeRecordedFrame(const EnvelopeView &envelope, cv::Mat &frame, cv::Rect *decoded = nullptr);
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "recording.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Header of a <file>.idx index file, followed by the RecordingEntries. The
+// file is written in the byte order of the machine; the magic and the entry
+// size reject files from other layouts.
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t entrySize;
+    uint32_t reserved;
+    uint64_t recordingSize;
+    int64_t recordingModified;
+    uint64_t entries;
+};
+
+constexpr char INDEX_FILE_MAGIC[8] = {'R', 'E', 'C', 'I', 'D', 'X', '0', '1'};
+
+} // namespace
+
+Recording::Recording(const std::string &file, bool useIndexFile)
+{
+    m_fd = ::open(file.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        std::clog << "[Recording]: " << file << " could not be opened: " << ::strerror(errno) << std::endl;
+        return;
+    }
+    struct stat status;
+    if ((0 != ::fstat(m_fd, &status)) || (0 == status.st_size)) {
+        std::clog << "[Recording]: " << file << " is empty or cannot be accessed." << std::endl;
+        return;
+    }
+    m_size = static_cast<size_t>(status.st_size);
+    m_modified = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000 * 1000 * 1000 + static_cast<int64_t>(status.st_mtim.tv_nsec);
+
+    void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == data) {
+        std::clog << "[Recording]: " << file << " could not be mapped: " << ::strerror(errno) << std::endl;
+        m_size = 0;
+        return;
+    }
+    m_data = static_cast<const char *>(data);
+
+    const std::string indexFile{file + ".idx"};
+    if (useIndexFile && loadIndex(indexFile)) {
+        m_indexFromFile = true;
+    } else if (buildIndex() && useIndexFile) {
+        storeIndex(indexFile);
+    }
+}
+
+Recording::~Recording()
+{
+    if (nullptr != m_data) {
+        ::munmap(const_cast<char *>(m_data), m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool Recording::valid() const
+{
+    return (nullptr != m_data) && !m_index.empty();
+}
+
+bool Recording::indexFromFile() const
+{
+    return m_indexFromFile;
+}
+
+const std::vector<RecordingEntry> &Recording::index() const
+{
+    return m_index;
+}
+
+bool Recording::envelope(const RecordingEntry &entry, EnvelopeView &view) const
+{
+    if ((entry.offset + OD4_HEADER_SIZE + entry.size) > m_size) {
+        return false;
+    }
+    return decodeEnvelopeView(m_data + entry.offset + OD4_HEADER_SIZE, entry.size, view);
+}
+
+size_t Recording::lowerBound(int64_t microseconds) const
+{
+    auto it = std::lower_bound(m_index.begin(), m_index.end(), microseconds,
+                               [](const RecordingEntry &entry, int64_t t) { return entry.sampleTimeStamp < t; });
+    return static_cast<size_t>(it - m_index.begin());
+}
+
+bool Recording::buildIndex()
+{
+    // Only the OD4 header and the Envelope fields around serializedData are
+    // read; the pages of large payloads are skipped.
+    m_index.clear();
+    uint64_t offset{0};
+    while ((offset + OD4_HEADER_SIZE) <= m_size) {
+        uint32_t length{0};
+        if (!decodeOD4Header(m_data + offset, length)) {
+            std::clog << "[Recording]: No Envelope at offset " << offset << "; ignoring the rest of the file." << std::endl;
+            break;
+        }
+        if ((offset + OD4_HEADER_SIZE + length) > m_size) {
+            std::clog << "[Recording]: Envelope at offset " << offset << " is truncated." << std::endl;
+            break;
+        }
+        EnvelopeView view;
+        if (decodeEnvelopeView(m_data + offset + OD4_HEADER_SIZE, length, view)) {
+            RecordingEntry entry;
+            entry.sampleTimeStamp = view.sampleTimeStamp;
+            entry.offset = offset;
+            entry.size = length;
+            entry.dataType = view.dataType;
+            entry.senderStamp = view.senderStamp;
+            entry.reserved = 0;
+            m_index.push_back(entry);
+        }
+        offset += OD4_HEADER_SIZE + length;
+    }
+    std::stable_sort(m_index.begin(), m_index.end(),
+                     [](const RecordingEntry &a, const RecordingEntry &b) { return a.sampleTimeStamp < b.sampleTimeStamp; });
+    return !m_index.empty();
+}
+
+bool Recording::loadIndex(const std::string &file)
+{
+    FILE *in = std::fopen(file.c_str(), "rb");
+    if (nullptr == in) {
+        return false;
+    }
+    // The entry count is bounded by the size of the file so that a corrupt
+    // header falls back to a rebuild instead of a huge allocation.
+    struct stat status;
+    IndexFileHeader header;
+    bool retVal = (0 == ::fstat(::fileno(in), &status)) &&
+                  (static_cast<uint64_t>(status.st_size) >= sizeof(header)) &&
+                  (1 == std::fread(&header, sizeof(header), 1, in)) &&
+                  (0 == std::memcmp(header.magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC))) &&
+                  (sizeof(RecordingEntry) == header.entrySize) &&
+                  (m_size == header.recordingSize) &&
+                  (m_modified == header.recordingModified) &&
+                  (0 < header.entries) &&
+                  (header.entries <= (static_cast<uint64_t>(status.st_size) - sizeof(header)) / sizeof(RecordingEntry));
+    if (retVal) {
+        m_index.resize(static_cast<size_t>(header.entries));
+        retVal = (m_index.size() == std::fread(m_index.data(), sizeof(RecordingEntry), m_index.size(), in));
+        if (!retVal) {
+            m_index.clear();
+        }
+    }
+    std::fclose(in);
+    if (!retVal) {
+        std::clog << "[Recording]: " << file << " is outdated or invalid; rebuilding the index." << std::endl;
+    }
+    return retVal;
+}
+
+bool Recording::storeIndex(const std::string &file) const
+{
+    // Write to a temporary file first so that readers never see a partial index.
+    const std::string tmp{file + ".tmp"};
+    FILE *out = std::fopen(tmp.c_str(), "wb");
+    if (nullptr == out) {
+        std::clog << "[Recording]: Could not write " << file << ": " << ::strerror(errno) << std::endl;
+        return false;
+    }
+    IndexFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+    header.entrySize = sizeof(RecordingEntry);
+    header.recordingSize = m_size;
+    header.recordingModified = m_modified;
+    header.entries = m_index.size();
+    bool retVal = (1 == std::fwrite(&header, sizeof(header), 1, out)) &&
+                  (m_index.size() == std::fwrite(m_index.data(), sizeof(RecordingEntry), m_index.size(), out));
+    retVal = (0 == std::fclose(out)) && retVal;
+    retVal = retVal && (0 == std::rename(tmp.c_str(), file.c_str()));
+    if (!retVal) {
+        std::clog << "[Recording]: Could not write " << file << "." << std::endl;
+        std::remove(tmp.c_str());
+    }
+    return retVal;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include "envelope-view.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Location of one Envelope in a .rec file. The index stores these entries in
+ * a flat vector sorted by sampleTimeStamp (entries with the same time stamp
+ * keep their order in the file, as in cluon::Player's multimap).
+ */
+struct RecordingEntry {
+    int64_t sampleTimeStamp;    // Microseconds.
+    uint64_t offset;            // Offset of the OD4 header in the .rec file.
+    uint32_t size;              // Size of the Protobuf encoded Envelope after the OD4 header.
+    int32_t dataType;
+    uint32_t senderStamp;
+    uint32_t reserved;
+};
+
+/**
+ * Read-only .rec file that is memory-mapped instead of read through
+ * std::fstream as done by cluon::Player. Opening a recording builds a sorted
+ * index of all Envelopes by scanning only their headers and time stamps;
+ * the index can be stored next to the recording as <file>.idx and is reused
+ * as long as size and modification time of the recording match.
+ *
+ * Envelopes are handed out as EnvelopeViews into the mapping; they stay valid
+ * as long as the Recording exists. The complete file is mapped, which limits
+ * recordings to the address space of 32 bit builds.
+ */
+class Recording {
+   private:
+    Recording(const Recording &) = delete;
+    Recording(Recording &&) = delete;
+    Recording &operator=(const Recording &) = delete;
+    Recording &operator=(Recording &&) = delete;
+
+   public:
+    /**
+     * @param file .rec file to open.
+     * @param useIndexFile Load <file>.idx if it is up to date; build and store it otherwise.
+     */
+    explicit Recording(const std::string &file, bool useIndexFile = true);
+    ~Recording();
+
+    // Returns true if the recording is mapped and indexed.
+    bool valid() const;
+
+    // Returns true if the index was loaded from <file>.idx.
+    bool indexFromFile() const;
+
+    const std::vector<RecordingEntry> &index() const;
+
+    /**
+     * Decodes the Envelope of an index entry.
+     *
+     * @return false if the entry is malformed.
+     */
+    bool envelope(const RecordingEntry &entry, EnvelopeView &view) const;
+
+    // Returns the position of the first entry with sampleTimeStamp >= microseconds.
+    size_t lowerBound(int64_t microseconds) const;
+
+   private:
+    bool buildIndex();
+    bool loadIndex(const std::string &file);
+    bool storeIndex(const std::string &file) const;
+
+   private:
+    int m_fd{-1};
+    const char *m_data{nullptr};
+    size_t m_size{0};
+    int64_t m_modified{0};
+    bool m_indexFromFile{false};
+    std::vector<RecordingEntry> m_index{};
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "recorder.hpp"
+#include "replay-decoder.hpp"
+
+#include <algorithm>
+
+ReplayDecoder::ReplayDecoder(const Recording &recording, std::vector<RecordingEntry> order, int width, int height, uint32_t workers,
+                             uint32_t lookAhead)
+    : m_recording(recording)
+    , m_order(std::move(order))
+    , m_slots()
+{
+    if (0 == workers) {
+        workers = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+    if (0 == lookAhead) {
+        lookAhead = 4 * workers;
+    }
+    m_slots.resize(lookAhead);
+    for (auto &slot : m_slots) {
+        slot.item.image = cv::Mat(height, width, CV_8UC4, cv::Scalar(0, 0, 0, 0));
+    }
+    m_queue.resize(lookAhead);
+    for (uint32_t i = 0; i < workers; i++) {
+        m_workers.emplace_back([this]() { decode(); });
+    }
+}
+
+ReplayDecoder::~ReplayDecoder()
+{
+    {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        m_stop = true;
+    }
+    m_queuedCondition.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+const ReplayDecoder::Item *ReplayDecoder::next()
+{
+    // The slot handed out last is free again.
+    if (m_delivering) {
+        m_delivered++;
+        m_delivering = false;
+    }
+    fill();
+    if (m_delivered == m_issued) {
+        return nullptr;
+    }
+
+    Slot &slot{m_slots[m_delivered % m_slots.size()]};
+    {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if (!slot.done) {
+            m_stalls++;
+            m_doneCondition.wait(lck, [&slot]() { return slot.done; });
+        }
+    }
+    m_delivering = true;
+    return &slot.item;
+}
+
+void ReplayDecoder::fill()
+{
+    bool queued{false};
+    while ((m_nextEntry < m_order.size()) && (m_issued - m_delivered < m_slots.size())) {
+        Slot &slot{m_slots[m_issued % m_slots.size()]};
+        if (!m_recording.envelope(m_order[m_nextEntry++], slot.item.envelope)) {
+            continue;
+        }
+        slot.item.frame = (opendlv::proxy::ImageReading::ID() == slot.item.envelope.dataType);
+        slot.item.decoded = false;
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            slot.done = !slot.item.frame;
+            if (slot.item.frame) {
+                m_queue[(m_queueHead + m_queueCount) % m_queue.size()] = m_issued;
+                m_queueCount++;
+                queued = true;
+            }
+        }
+        m_issued++;
+    }
+    if (queued) {
+        m_queuedCondition.notify_all();
+    }
+}
+
+void ReplayDecoder::decode()
+{
+    while (true) {
+        uint64_t sequence{0};
+        {
+            std::unique_lock<std::mutex> lck(m_mutex);
+            m_queuedCondition.wait(lck, [this]() { return m_stop || (0 != m_queueCount); });
+            if (m_stop) {
+                return;
+            }
+            sequence = m_queue[m_queueHead];
+            m_queueHead = (m_queueHead + 1) % m_queue.size();
+            m_queueCount--;
+        }
+        Item &item{m_slots[sequence % m_slots.size()].item};
+        item.decoded = decodeRecordedFrame(item.envelope, item.image, &item.decodedRows);
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_slots[sequence % m_slots.size()].done = true;
+        }
+        // Only next() waits for slots.
+        m_doneCondition.notify_one();
+    }
+}
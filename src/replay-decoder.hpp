@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_DECODER_HPP
+#define REPLAY_DECODER_HPP
+
+#include "envelope-view.hpp"
+#include "recording.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Front-end for replays that decodes the frames of a Recording ahead of the
+ * pipeline: the Envelopes are taken sequentially in the given order, frames
+ * (opendlv.proxy.ImageReading as written by Recorder) are decoded on several
+ * worker threads and complete in any order, and next() hands everything out
+ * in the given order again. At most lookAhead entries are in flight, each in
+ * a preallocated slot with a frame of its own, so memory does not grow with
+ * the length of the recording.
+ *
+ * Pass Recording::index() to replay by sampleTimeStamp or recordedOrder() to
+ * replay a recording of the steering microservice in the order it was consumed.
+ */
+class ReplayDecoder {
+   private:
+    ReplayDecoder(const ReplayDecoder &) = delete;
+    ReplayDecoder(ReplayDecoder &&) = delete;
+    ReplayDecoder &operator=(const ReplayDecoder &) = delete;
+    ReplayDecoder &operator=(ReplayDecoder &&) = delete;
+
+   public:
+    struct Item {
+        EnvelopeView envelope{};
+        // True for an opendlv.proxy.ImageReading.
+        bool frame{false};
+        // True if the frame was decoded into image.
+        bool decoded{false};
+        // Frame of the size given to the constructor; only the rows in decodedRows are updated.
+        cv::Mat image{};
+        cv::Rect decodedRows{};
+    };
+
+    /**
+     * @param recording Recording to replay; must outlive the decoder.
+     * @param order Entries of recording in the order to hand them out.
+     * @param width Width of the frames.
+     * @param height Height of the frames.
+     * @param workers Decoding threads; one per core if 0.
+     * @param lookAhead Entries in flight at most; four per worker if 0.
+     */
+    ReplayDecoder(const Recording &recording, std::vector<RecordingEntry> order, int width, int height, uint32_t workers = 0,
+                  uint32_t lookAhead = 0);
+    ~ReplayDecoder();
+
+    /**
+     * Returns the next entry, waiting for its frame to be decoded if needed.
+     * The entry stays valid until the next call.
+     *
+     * @return nullptr after the last entry.
+     */
+    const Item *next();
+
+    uint32_t workers() const noexcept { return static_cast<uint32_t>(m_workers.size()); }
+    // Frames that next() had to wait for.
+    uint64_t stalls() const noexcept { return m_stalls; }
+
+   private:
+    struct Slot {
+        Item item{};
+        bool done{false};
+    };
+
+    void fill();
+    void decode();
+
+   private:
+    const Recording &m_recording;
+    std::vector<RecordingEntry> m_order;
+    std::vector<Slot> m_slots;
+    // Next entry of m_order to take, slots taken and slots handed out so far.
+    size_t m_nextEntry{0};
+    uint64_t m_issued{0};
+    uint64_t m_delivered{0};
+    bool m_delivering{false};
+    uint64_t m_stalls{0};
+
+    // Slots waiting for a worker in a ring of one position per slot.
+    std::mutex m_mutex{};
+    std::condition_variable m_queuedCondition{};
+    std::condition_variable m_doneCondition{};
+    std::vector<uint64_t> m_queue{};
+    size_t m_queueHead{0};
+    size_t m_queueCount{0};
+    bool m_stop{false};
+    std::vector<std::thread> m_workers{};
+};
+
+#endif
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scratch-arena.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+constexpr size_t HUGE_PAGE_SIZE{2 * 1024 * 1024};
+
+// From <numaif.h>, which would need libnuma.
+constexpr int MPOL_PREFERRED_POLICY{1};
+
+size_t roundUp(size_t value, size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Value in bytes of a "Name:    1234 kB" line from smaps.
+size_t kilobytes(const std::string &line)
+{
+    std::istringstream fields{line.substr(line.find(':') + 1)};
+    size_t value{0};
+    fields >> value;
+    return value * 1024;
+}
+
+std::string megabytes(size_t bytes)
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MB";
+    return text.str();
+}
+
+} // namespace
+
+int currentNumaNode()
+{
+    unsigned int cpu{0}, node{0};
+    return (0 == ::syscall(SYS_getcpu, &cpu, &node, nullptr)) ? static_cast<int>(node) : -1;
+}
+
+PageStatistics pageStatistics(const void *address, size_t size)
+{
+    PageStatistics statistics;
+    const uintptr_t begin{reinterpret_cast<uintptr_t>(address)};
+
+    // The huge page counters of the mappings that overlap the range; madvise()
+    // splits a mapping where the advised part begins and ends.
+    const uintptr_t end{begin + size};
+    std::ifstream smaps{"/proc/self/smaps"};
+    size_t overlap{0}, hugeBytes{0};
+    for (std::string line; std::getline(smaps, line);) {
+        const std::string first{line.substr(0, line.find(' '))};
+        if (!first.empty() && (':' != first.back())) {
+            // "from-to perms offset device inode path" starts the next mapping.
+            statistics.hugeBytes += std::min(hugeBytes, overlap);
+            hugeBytes = 0;
+            const size_t dash{first.find('-')};
+            const uintptr_t from{std::stoull(first.substr(0, dash), nullptr, 16)};
+            const uintptr_t to{std::stoull(first.substr(dash + 1), nullptr, 16)};
+            overlap = ((from < end) && (begin < to)) ? (std::min(to, end) - std::max(from, begin)) : 0;
+            statistics.bytes += overlap;
+        } else if (0 < overlap) {
+            if ("KernelPageSize:" == first) {
+                statistics.kernelPageSize = std::max(statistics.kernelPageSize, kilobytes(line));
+            } else if (("AnonHugePages:" == first) || ("ShmemPmdMapped:" == first) || ("FilePmdMapped:" == first) ||
+                       ("Shared_Hugetlb:" == first) || ("Private_Hugetlb:" == first)) {
+                hugeBytes += kilobytes(line);
+            }
+        }
+    }
+    statistics.hugeBytes += std::min(hugeBytes, overlap);
+
+    // The node of every page, or of every n-th page for large ranges.
+    statistics.node = currentNumaNode();
+    const size_t pageSize{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+    const size_t pages{(size + pageSize - 1) / pageSize};
+    const size_t step{std::max<size_t>(1, pages / 4096)};
+    std::vector<void *> samples;
+    for (size_t page = 0; page < pages; page += step) {
+        samples.push_back(reinterpret_cast<void *>((begin + page * pageSize) & ~(pageSize - 1)));
+    }
+    std::vector<int> status(samples.size(), 0);
+    if (!samples.empty() && (0 == ::syscall(SYS_move_pages, 0, samples.size(), samples.data(), nullptr, status.data(), 0))) {
+        for (int s : status) {
+            if (0 > s) {
+                statistics.pagesMissing += step;
+            } else if (s == statistics.node) {
+                statistics.pagesOnNode += step;
+            } else {
+                statistics.pagesElsewhere += step;
+            }
+        }
+    }
+    return statistics;
+}
+
+std::string describe(const PageStatistics &statistics)
+{
+    std::ostringstream text;
+    text << megabytes(statistics.bytes) << ", " << statistics.kernelPageSize / 1024 << " kB pages, " << megabytes(statistics.hugeBytes)
+         << " on huge pages, " << statistics.pagesOnNode << "/" << (statistics.pagesOnNode + statistics.pagesElsewhere + statistics.pagesMissing)
+         << " pages on node " << statistics.node;
+    if (0 < statistics.pagesMissing) {
+        text << " (" << statistics.pagesMissing << " not backed yet)";
+    }
+    return text.str();
+}
+
+bool adviseHugePages(void *address, size_t size)
+{
+    const uintptr_t begin{roundUp(reinterpret_cast<uintptr_t>(address), HUGE_PAGE_SIZE)};
+    const uintptr_t end{(reinterpret_cast<uintptr_t>(address) + size) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE};
+    if (end <= begin) {
+        return false;
+    }
+    if (0 != ::madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE)) {
+        std::cerr << "[ScratchArena] madvise(MADV_HUGEPAGE) failed: " << ::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ScratchArena::ScratchArena(size_t capacity, bool hugePages, bool numaLocal)
+{
+    if (hugePages) {
+        m_capacity = roundUp(capacity, HUGE_PAGE_SIZE);
+        void *mapping{::mmap(nullptr, m_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0)};
+        if (MAP_FAILED != mapping) {
+            m_mapping = m_begin = static_cast<char *>(mapping);
+            m_mappingSize = m_capacity;
+            m_backing = "hugetlb";
+        } else {
+            // Room to align the start to a huge page for transparent huge pages.
+            m_mappingSize = m_capacity + HUGE_PAGE_SIZE;
+            mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED != mapping) {
+                m_mapping = static_cast<char *>(mapping);
+                m_begin = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(m_mapping), HUGE_PAGE_SIZE));
+                m_backing = adviseHugePages(m_begin, m_capacity) ? "thp" : "4k";
+            }
+        }
+    } else {
+        m_capacity = m_mappingSize = roundUp(capacity, static_cast<size_t>(::sysconf(_SC_PAGESIZE)));
+        void *mapping{::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+        if (MAP_FAILED != mapping) {
+            m_mapping = m_begin = static_cast<char *>(mapping);
+        }
+    }
+    if (nullptr == m_mapping) {
+        std::cerr << "[ScratchArena] Failed to map " << m_capacity << " bytes: " << ::strerror(errno) << std::endl;
+        m_capacity = m_mappingSize = 0;
+        return;
+    }
+
+    const int node{currentNumaNode()};
+    if (numaLocal && (0 <= node) && (node < 64)) {
+        // Preferred instead of bound, so that a full node falls back to another one.
+        const unsigned long nodeMask{1UL << node};
+        if (0 != ::syscall(SYS_mbind, m_begin, m_capacity, MPOL_PREFERRED_POLICY, &nodeMask, sizeof(nodeMask) * 8, 0)) {
+            std::cerr << "[ScratchArena] mbind to node " << node << " failed: " << ::strerror(errno) << std::endl;
+        }
+    }
+    // Fault all pages in now, on this thread and its node, instead of during the first frames.
+    std::memset(m_begin, 0, m_capacity);
+}
+
+ScratchArena::~ScratchArena()
+{
+    if (nullptr != m_mapping) {
+        ::munmap(m_mapping, m_mappingSize);
+    }
+}
+
+bool ScratchArena::valid() const
+{
+    return nullptr != m_mapping;
+}
+
+void *ScratchArena::allocate(size_t size, size_t alignment)
+{
+    const size_t offset{roundUp(m_used, alignment)};
+    if (!valid() || (offset + size > m_capacity)) {
+        return nullptr;
+    }
+    m_used = offset + size;
+    return m_begin + offset;
+}
+
+size_t ScratchArena::capacity() const
+{
+    return m_capacity;
+}
+
+size_t ScratchArena::used() const
+{
+    return m_used;
+}
+
+const char *ScratchArena::backing() const
+{
+    return m_backing;
+}
+
+PageStatistics ScratchArena::statistics() const
+{
+    return pageStatistics(m_begin, m_capacity);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRATCH_ARENA_HPP
+#define SCRATCH_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// What backs a range of memory as reported by the kernel.
+struct PageStatistics {
+    size_t bytes{0};             // Bytes of the range that are mapped.
+    size_t kernelPageSize{0};    // 4096 for normal and transparent huge pages, 2 MB for hugetlbfs.
+    size_t hugeBytes{0};         // Bytes of the range on huge pages (transparent or hugetlbfs).
+    int node{-1};                // NUMA node of the calling thread.
+    size_t pagesOnNode{0};       // Pages of the range on that node.
+    size_t pagesElsewhere{0};    // Pages of the range on other nodes.
+    size_t pagesMissing{0};      // Pages of the range that are not backed yet.
+};
+
+// Returns the NUMA node of the CPU the calling thread runs on, or -1.
+int currentNumaNode();
+
+/**
+ * Reads /proc/self/smaps and move_pages() for the range; huge page counters
+ * are kept per mapping by the kernel and capped at the part in the range.
+ */
+PageStatistics pageStatistics(const void *address, size_t size);
+
+// One line summary like "2.6 MB, 4 kB pages, 2.0 MB on huge pages, 675/675 pages on node 0".
+std::string describe(const PageStatistics &statistics);
+
+/**
+ * Asks for transparent huge pages for the 2 MB aligned part of the range,
+ * e.g. of a cluon::SharedMemory area, which is mapped by libcluon with
+ * default pages; shared memory needs shmem_enabled set to "advise" or
+ * "always" in /sys/kernel/mm/transparent_hugepage.
+ *
+ * @return false if the range has no aligned 2 MB part or madvise() failed.
+ */
+bool adviseHugePages(void *address, size_t size);
+
+/**
+ * Memory for the scratch buffers of a frame pipeline (masks, copies of the
+ * frame) that is mapped once, optionally on huge pages and on the NUMA node
+ * of the thread that creates it, and handed out by bumping a pointer; the
+ * buffers live as long as the arena. The pages are touched on construction,
+ * so the creating thread should already run where the pipeline will run.
+ *
+ * With huge pages, the arena tries a hugetlbfs mapping (MAP_HUGETLB, needs
+ * reserved pages in /proc/sys/vm/nr_hugepages) and falls back to a mapping
+ * aligned to 2 MB with transparent huge pages advised.
+ */
+class ScratchArena {
+   private:
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena(ScratchArena &&) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+    ScratchArena &operator=(ScratchArena &&) = delete;
+
+   public:
+    /**
+     * @param capacity Bytes to reserve; rounded up to 2 MB with huge pages.
+     * @param hugePages Use huge pages if available.
+     * @param numaLocal Prefer the NUMA node of the calling thread.
+     */
+    ScratchArena(size_t capacity, bool hugePages, bool numaLocal);
+    ~ScratchArena();
+
+    bool valid() const;
+
+    /**
+     * @return size bytes aligned to alignment (a power of two), or nullptr if the arena is exhausted.
+     */
+    void *allocate(size_t size, size_t alignment = 64);
+
+    size_t capacity() const;
+    size_t used() const;
+
+    // "hugetlb", "thp" or "4k": what was requested and granted by mmap/madvise.
+    const char *backing() const;
+
+    // What the kernel actually provides for the arena.
+    PageStatistics statistics() const;
+
+   private:
+    char *m_mapping{nullptr};
+    size_t m_mappingSize{0};
+    char *m_begin{nullptr};
+    size_t m_capacity{0};
+    size_t m_used{0};
+    const char *m_backing{"4k"};
+};
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Kernels for x86-64 CPUs with AVX2; built with -mavx2.
+
+#if defined(__x86_64__)
+
+#ifndef __AVX2__
+#error "segmentation-kernels-avx2.cpp must be compiled with -mavx2"
+#endif
+
+#define SEGMENTATION_KERNELS_ISA avx2
+#define SEGMENTATION_KERNELS_ISA_NAME "avx2"
+#define SEGMENTATION_KERNELS_PACK_AVX2
+#include "segmentation-kernels-impl.hpp"
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Source of the specialised segmentation kernels. It is included once by every
+// segmentation-kernels-<isa>.cpp, which defines SEGMENTATION_KERNELS_ISA (the
+// namespace) and SEGMENTATION_KERNELS_ISA_NAME (the --force-isa name) and is
+// compiled with the -m flags of that instruction set; the loops are written so
+// that the compiler vectorizes them for each of them. Everything except the
+// KERNELS table has internal linkage so that no code compiled for one
+// instruction set can be picked by the linker for another one.
+
+#if !defined(SEGMENTATION_KERNELS_ISA) || !defined(SEGMENTATION_KERNELS_ISA_NAME)
+#error "Define SEGMENTATION_KERNELS_ISA and SEGMENTATION_KERNELS_ISA_NAME before including segmentation-kernels-impl.hpp"
+#endif
+
+#include "segmentation-kernels.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(SEGMENTATION_KERNELS_PACK_SSE2) || defined(SEGMENTATION_KERNELS_PACK_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace SEGMENTATION_KERNELS_ISA {
+namespace {
+
+// Radius and size of the box filter; the kernels are only selected when
+// BLUR_KERNEL_SIZE matches.
+constexpr int RADIUS = 3;
+constexpr int KERNEL = 2 * RADIUS + 1;
+
+// Calls f(0), f(1), ..., f(N - 1) without a loop.
+template <int N>
+struct Unroll {
+    template <typename F>
+    static inline void apply(F &&f) {
+        Unroll<N - 1>::apply(f);
+        f(N - 1);
+    }
+};
+template <>
+struct Unroll<0> {
+    template <typename F>
+    static inline void apply(F &&) {}
+};
+
+inline int minimum(int a, int b) { return (a < b) ? a : b; }
+inline int maximum(int a, int b) { return (a > b) ? a : b; }
+
+// Fixed-point division tables of OpenCV's 8-bit BGR -> HSV conversion; using
+// the same tables makes the kernels produce the same H, S and V.
+struct HSVTables {
+    static constexpr int SHIFT = 12;
+    int sdiv[256];
+    int hdiv[256];
+
+    HSVTables() : sdiv(), hdiv() {
+        for (int i = 1; i < 256; i++) {
+            sdiv[i] = static_cast<int>(std::lround((255 << SHIFT) / (1.0 * i)));
+            hdiv[i] = static_cast<int>(std::lround((180 << SHIFT) / (6.0 * i)));
+        }
+    }
+};
+
+const HSVTables &hsvTables()
+{
+    static const HSVTables tables;
+    return tables;
+}
+
+// Mirrors an index at the borders without repeating the border pixel (cv::BORDER_REFLECT_101).
+inline int reflect101(int i, int size)
+{
+    return (i < 0) ? -i : ((i >= size) ? 2 * size - 2 - i : i);
+}
+
+/**
+ * Classifies count blurred pixels given as V = max(B, G, R), diff = V - min(B, G, R)
+ * and hue numerator n into 255 (inside) or 0 for both ranges and returns the
+ * number of set pixels. H and S are computed with OpenCV's fixed-point formulas;
+ * the two table lookups become gathers with AVX2.
+ */
+inline MaskCounts classify(int count, const uint8_t *__restrict v, const uint8_t *__restrict diff, const int16_t *__restrict n,
+                           const ColorRange &blue, const ColorRange &yellow,
+                           uint8_t *__restrict blueOut, uint8_t *__restrict yellowOut)
+{
+    const int *__restrict sdiv = hsvTables().sdiv;
+    const int *__restrict hdiv = hsvTables().hdiv;
+    const int bhLow{blue.hLow}, bhHigh{blue.hHigh}, bsLow{blue.sLow}, bsHigh{blue.sHigh}, bvLow{blue.vLow}, bvHigh{blue.vHigh};
+    const int yhLow{yellow.hLow}, yhHigh{yellow.hHigh}, ysLow{yellow.sLow}, ysHigh{yellow.sHigh}, yvLow{yellow.vLow}, yvHigh{yellow.vHigh};
+    constexpr int HALF = 1 << (HSVTables::SHIFT - 1);
+    uint32_t blueCount{0}, yellowCount{0};
+    for (int x = 0; x < count; x++) {
+        const int value = v[x];
+        const int delta = diff[x];
+        const int s = (delta * sdiv[value] + HALF) >> HSVTables::SHIFT;
+        int h = (n[x] * hdiv[delta] + HALF) >> HSVTables::SHIFT;
+        h += (h < 0) ? 180 : 0;
+        // Bitwise instead of logical operators to avoid data-dependent branches.
+        const int isBlue = (h >= bhLow) & (h <= bhHigh) & (s >= bsLow) & (s <= bsHigh) & (value >= bvLow) & (value <= bvHigh);
+        const int isYellow = (h >= yhLow) & (h <= yhHigh) & (s >= ysLow) & (s <= ysHigh) & (value >= yvLow) & (value <= yvHigh);
+        blueOut[x] = static_cast<uint8_t>(-isBlue);
+        yellowOut[x] = static_cast<uint8_t>(-isYellow);
+        blueCount += static_cast<uint32_t>(isBlue);
+        yellowCount += static_cast<uint32_t>(isYellow);
+    }
+    MaskCounts counts;
+    counts.blue = blueCount;
+    counts.yellow = yellowCount;
+    return counts;
+}
+
+/**
+ * Packs count 0/255 bytes into bits, byte x into bit x % 64 of word x / 64;
+ * the bits of the last word after count are cleared. Uses the sign bits of
+ * the bytes (movemask) with SSE2 and AVX2, and otherwise gathers the lowest
+ * bit of eight bytes at a time with a multiplication.
+ */
+inline void packBits(int count, const uint8_t *__restrict bytes, uint64_t *__restrict bits)
+{
+    int x = 0;
+    for (; x + 64 <= count; x += 64) {
+#if defined(SEGMENTATION_KERNELS_PACK_AVX2)
+        const uint32_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + x))));
+        const uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + x + 32))));
+        bits[x / 64] = static_cast<uint64_t>(low) | (static_cast<uint64_t>(high) << 32);
+#elif defined(SEGMENTATION_KERNELS_PACK_SSE2)
+        uint64_t word = 0;
+        Unroll<4>::apply([&](int k) {
+            const uint32_t part = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + x + 16 * k))));
+            word |= static_cast<uint64_t>(part) << (16 * k);
+        });
+        bits[x / 64] = word;
+#else
+        uint64_t word = 0;
+        Unroll<8>::apply([&](int k) {
+            uint64_t eight;
+            std::memcpy(&eight, bytes + x + 8 * k, sizeof(eight));
+            // Moves bit 0 of byte i to bit 56 + i; assumes a little-endian CPU.
+            word |= (((eight & 0x0101010101010101ULL) * 0x0102040810204080ULL) >> 56) << (8 * k);
+        });
+        bits[x / 64] = word;
+#endif
+    }
+    if (x < count) {
+        uint64_t word = 0;
+        for (int i = 0; x + i < count; i++) {
+            word |= static_cast<uint64_t>(bytes[x + i] & 1) << i;
+        }
+        bits[x / 64] = word;
+    }
+}
+
+// Adds the lowest bit of count 0/255 bytes to the column counts.
+inline void addColumns(int count, const uint8_t *__restrict bytes, uint16_t *__restrict columns)
+{
+    for (int x = 0; x < count; x++) {
+        columns[x] = static_cast<uint16_t>(columns[x] + (bytes[x] & 1));
+    }
+}
+
+/**
+ * Adds the B, G and R channels of the incoming row to the running vertical
+ * sums and subtracts the ones of the outgoing row (if any).
+ */
+template <int C>
+inline void slideWindow(int count, const uint8_t *__restrict incoming, const uint8_t *__restrict outgoing,
+                        uint16_t *__restrict b, uint16_t *__restrict g, uint16_t *__restrict r)
+{
+    if (nullptr == outgoing) {
+        for (int x = 0; x < count; x++) {
+            b[x] = static_cast<uint16_t>(b[x] + incoming[x * C + 0]);
+            g[x] = static_cast<uint16_t>(g[x] + incoming[x * C + 1]);
+            r[x] = static_cast<uint16_t>(r[x] + incoming[x * C + 2]);
+        }
+    } else {
+        for (int x = 0; x < count; x++) {
+            b[x] = static_cast<uint16_t>(b[x] + incoming[x * C + 0] - outgoing[x * C + 0]);
+            g[x] = static_cast<uint16_t>(g[x] + incoming[x * C + 1] - outgoing[x * C + 1]);
+            r[x] = static_cast<uint16_t>(r[x] + incoming[x * C + 2] - outgoing[x * C + 2]);
+        }
+    }
+}
+
+// Upper bound for the source bytes of the KERNEL rows a stripe reads; half of
+// the 32 KiB L1 data cache of the Cortex-A53 so that the running sums, the
+// rows of the blur window and the output rows stay in L1.
+constexpr int STRIPE_BYTES = 16 * 1024;
+
+/**
+ * Segmentation kernel for frames of width W with C bytes per pixel and a ROI
+ * of H rows spanning the columns [0, W - 1).
+ *
+ * The ROI is processed in stripes of columns whose blur window fits into
+ * STRIPE_BYTES. Per stripe, the box filter keeps running vertical sums of the
+ * B, G and R channels that are updated with one incoming and one outgoing row
+ * read straight from the frame (the alpha channel is skipped); each output row
+ * is then summed horizontally and handed to the classifier without storing the
+ * blurred image. With BITS, the classified row is packed into the bit masks;
+ * stripes start at multiples of 64 columns so that they fill whole words.
+ * The projections are taken from the classified row while it is in L1: the
+ * row count is the result of the classifier and the columns are summed up
+ * per stripe.
+ */
+template <int W, int H, int C, bool BITS>
+MaskCounts segmentInto(const uint8_t *frame, size_t step, int rows, int roiY,
+                       const ColorRange &blue, const ColorRange &yellow,
+                       uint8_t *blueMask, uint8_t *yellowMask, uint64_t *blueBits, uint64_t *yellowBits,
+                       MaskProjections *blueProjections, MaskProjections *yellowProjections)
+{
+    constexpr int COLUMNS = W - 1;
+    constexpr int WORDS = (COLUMNS + 63) / 64;
+    constexpr int MAX_STRIPE = STRIPE_BYTES / (KERNEL * C);
+    constexpr int STRIPES = (COLUMNS + MAX_STRIPE - 1) / MAX_STRIPE;
+    constexpr int STRIPE = (((COLUMNS + STRIPES - 1) / STRIPES + 63) / 64) * 64;
+    constexpr int AREA = KERNEL * KERNEL;
+    static_assert((STRIPE - 64) * KERNEL * C < STRIPE_BYTES, "Stripes rounded up to whole words exceed the L1 budget");
+
+    MaskCounts counts;
+    // Running vertical sums per channel for the stripe, padded by RADIUS columns on both sides.
+    uint16_t sumB[STRIPE + 2 * RADIUS], sumG[STRIPE + 2 * RADIUS], sumR[STRIPE + 2 * RADIUS];
+    // Blurred pixels of one stripe row as V, V - min and hue numerator.
+    uint8_t v[STRIPE], diff[STRIPE];
+    int16_t n[STRIPE];
+    // Classified stripe row before it is packed into bits.
+    uint8_t blueRow[BITS ? STRIPE : 1], yellowRow[BITS ? STRIPE : 1];
+    auto clear = [](MaskProjections *projections) {
+        if (nullptr != projections) {
+            std::memset(projections->rows, 0, sizeof(uint16_t) * H);
+            std::memset(projections->columns, 0, sizeof(uint16_t) * COLUMNS);
+        }
+    };
+    clear(blueProjections);
+    clear(yellowProjections);
+    for (int x0 = 0; x0 < COLUMNS; x0 += STRIPE) {
+        const int width = minimum(STRIPE, COLUMNS - x0);
+        // Frame columns [first, last) contribute to the stripe; the rest of the padding is mirrored.
+        const int first = maximum(x0 - RADIUS, 0);
+        const int last = minimum(x0 + width + RADIUS, W);
+        const int offset = first - (x0 - RADIUS);
+        const int count = last - first;
+        auto rowAt = [&](int y) {
+            return frame + static_cast<size_t>(reflect101(y, rows)) * step + static_cast<size_t>(first * C);
+        };
+
+        // Vertical sums of the first ROI row.
+        for (int x = 0; x < count; x++) {
+            sumB[offset + x] = sumG[offset + x] = sumR[offset + x] = 0;
+        }
+        for (int k = -RADIUS; k <= RADIUS; k++) {
+            slideWindow<C>(count, rowAt(roiY + k), nullptr, sumB + offset, sumG + offset, sumR + offset);
+        }
+
+        for (int y = 0; y < H; y++) {
+            if (0 < y) {
+                slideWindow<C>(count, rowAt(roiY + y + RADIUS), rowAt(roiY + y - RADIUS - 1), sumB + offset, sumG + offset, sumR + offset);
+            }
+            // Mirror the columns left of 0 and right of W - 1 (cv::BORDER_REFLECT_101).
+            for (int i = 0; i < offset; i++) {
+                const int source = reflect101(x0 - RADIUS + i, W) - (x0 - RADIUS);
+                sumB[i] = sumB[source];
+                sumG[i] = sumG[source];
+                sumR[i] = sumR[source];
+            }
+            for (int i = offset + count; i < width + 2 * RADIUS; i++) {
+                const int source = reflect101(x0 - RADIUS + i, W) - (x0 - RADIUS);
+                sumB[i] = sumB[source];
+                sumG[i] = sumG[source];
+                sumR[i] = sumR[source];
+            }
+
+            // Horizontal sums, rounded division by the kernel area as done by
+            // cv::blur and the BGR -> HSV quantities; the loop has no lookups
+            // so that the compiler vectorizes it.
+            for (int x = 0; x < width; x++) {
+                // 16 bit sums (at most 49 * 255) keep twice as many lanes per vector as int.
+                uint16_t sb = 0, sg = 0, sr = 0;
+                Unroll<KERNEL>::apply([&](int k) {
+                    sb = static_cast<uint16_t>(sb + sumB[x + k]);
+                    sg = static_cast<uint16_t>(sg + sumG[x + k]);
+                    sr = static_cast<uint16_t>(sr + sumR[x + k]);
+                });
+                const int pb = static_cast<uint16_t>(sb + AREA / 2) / AREA;
+                const int pg = static_cast<uint16_t>(sg + AREA / 2) / AREA;
+                const int pr = static_cast<uint16_t>(sr + AREA / 2) / AREA;
+                const int max = maximum(pb, maximum(pg, pr));
+                const int delta = max - minimum(pb, minimum(pg, pr));
+                v[x] = static_cast<uint8_t>(max);
+                diff[x] = static_cast<uint8_t>(delta);
+                n[x] = static_cast<int16_t>((max == pr) ? (pg - pb) : ((max == pg) ? (pb - pr + 2 * delta) : (pr - pg + 4 * delta)));
+            }
+            MaskCounts row;
+            if (BITS) {
+                row = classify(width, v, diff, n, blue, yellow, blueRow, yellowRow);
+                const size_t wordOffset = static_cast<size_t>(y) * WORDS + static_cast<size_t>(x0 / 64);
+                packBits(width, blueRow, blueBits + wordOffset);
+                packBits(width, yellowRow, yellowBits + wordOffset);
+                if (nullptr != blueProjections) {
+                    blueProjections->rows[y] = static_cast<uint16_t>(blueProjections->rows[y] + row.blue);
+                    addColumns(width, blueRow, blueProjections->columns + x0);
+                }
+                if (nullptr != yellowProjections) {
+                    yellowProjections->rows[y] = static_cast<uint16_t>(yellowProjections->rows[y] + row.yellow);
+                    addColumns(width, yellowRow, yellowProjections->columns + x0);
+                }
+            } else {
+                const size_t maskOffset = static_cast<size_t>(y) * COLUMNS + static_cast<size_t>(x0);
+                row = classify(width, v, diff, n, blue, yellow, blueMask + maskOffset, yellowMask + maskOffset);
+            }
+            counts.blue += row.blue;
+            counts.yellow += row.yellow;
+        }
+    }
+    return counts;
+}
+
+template <int W, int H, int C>
+MaskCounts segment(const uint8_t *frame, size_t step, int rows, int roiY,
+                   const ColorRange &blue, const ColorRange &yellow,
+                   uint8_t *blueMask, uint8_t *yellowMask)
+{
+    return segmentInto<W, H, C, false>(frame, step, rows, roiY, blue, yellow, blueMask, yellowMask, nullptr, nullptr, nullptr, nullptr);
+}
+
+template <int W, int H, int C>
+MaskCounts segmentBits(const uint8_t *frame, size_t step, int rows, int roiY,
+                       const ColorRange &blue, const ColorRange &yellow,
+                       uint64_t *blueBits, uint64_t *yellowBits,
+                       MaskProjections *blueProjections, MaskProjections *yellowProjections)
+{
+    return segmentInto<W, H, C, true>(frame, step, rows, roiY, blue, yellow, nullptr, nullptr, blueBits, yellowBits,
+                                      blueProjections, yellowProjections);
+}
+
+// Frame geometries with a specialised kernel; all other geometries use segmentGeneric.
+const KernelEntry ENTRIES[] = {
+    {640, 96, 4, "Segmenter<640, 96, 4>", &segment<640, 96, 4>, &segmentBits<640, 96, 4>},
+    {1280, 144, 4, "Segmenter<1280, 144, 4>", &segment<1280, 144, 4>, &segmentBits<1280, 144, 4>},
+};
+
+} // namespace
+
+const IsaKernels KERNELS{SEGMENTATION_KERNELS_ISA_NAME, ENTRIES, sizeof(ENTRIES) / sizeof(ENTRIES[0])};
+
+} // namespace SEGMENTATION_KERNELS_ISA
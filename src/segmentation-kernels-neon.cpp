@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Kernels for ARM CPUs with NEON; built with -mfpu=neon on armv7, NEON is part of the aarch64 baseline.
+
+#if defined(__arm__) || defined(__aarch64__)
+
+#if defined(__arm__) && !defined(__ARM_NEON)
+#error "segmentation-kernels-neon.cpp must be compiled with -mfpu=neon"
+#endif
+
+#define SEGMENTATION_KERNELS_ISA neon
+#define SEGMENTATION_KERNELS_ISA_NAME "neon"
+#include "segmentation-kernels-impl.hpp"
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Kernels for x86-64 CPUs; SSE2 is part of the x86-64 baseline.
+
+#if defined(__x86_64__)
+
+#define SEGMENTATION_KERNELS_ISA sse2
+#define SEGMENTATION_KERNELS_ISA_NAME "sse2"
+#define SEGMENTATION_KERNELS_PACK_SSE2
+#include "segmentation-kernels-impl.hpp"
+
+#endif
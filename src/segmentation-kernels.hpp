@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEGMENTATION_KERNELS_HPP
+#define SEGMENTATION_KERNELS_HPP
+
+// Plain types shared by the segmentation kernels of all instruction sets; this
+// header must not pull in OpenCV so that the kernel translation units compiled
+// with extra -m flags do not instantiate any inline code shared with the rest
+// of the binary.
+
+#include <cstddef>
+#include <cstdint>
+
+// Inclusive HSV range as used by cv::inRange (H in [0, 180), S and V in [0, 255]).
+struct ColorRange {
+    uint8_t hLow{0}, sLow{0}, vLow{0};
+    uint8_t hHigh{0}, sHigh{0}, vHigh{0};
+};
+
+// Number of pixels set in the blue and yellow masks.
+struct MaskCounts {
+    uint32_t blue{0};
+    uint32_t yellow{0};
+};
+
+/**
+ * Segmentation kernel for one frame geometry: blurs the ROI rows
+ * [roiY, roiY + roiHeight) x [0, width - 1) of a frame, converts them to HSV,
+ * thresholds them into one 0/255 mask per color and counts the set pixels.
+ *
+ * @param frame First byte of the frame.
+ * @param step Bytes per frame row.
+ * @param rows Number of frame rows; rows outside the ROI are used as blur border.
+ * @param roiY First row of the ROI.
+ * @param blue Range for the blue cones.
+ * @param yellow Range for the yellow cones.
+ * @param blueMask Continuous (width - 1) x roiHeight output mask for the blue cones.
+ * @param yellowMask Continuous (width - 1) x roiHeight output mask for the yellow cones.
+ * @return Set pixels per mask.
+ */
+typedef MaskCounts (*SegmentKernel)(const uint8_t *frame, size_t step, int rows, int roiY,
+                                    const ColorRange &blue, const ColorRange &yellow,
+                                    uint8_t *blueMask, uint8_t *yellowMask);
+
+// Number of set pixels per row (roiHeight entries) and per column (width - 1 entries) of a mask.
+struct MaskProjections {
+    uint16_t *rows{nullptr};
+    uint16_t *columns{nullptr};
+};
+
+/**
+ * Same as SegmentKernel, but the masks are packed into one bit per pixel:
+ * every mask row starts with a new 64 bit word, pixel x of a row is bit
+ * x % 64 of word x / 64 and the bits after the last column are 0.
+ *
+ * @param blueBits Continuous ((width - 1 + 63) / 64) x roiHeight words for the blue cones.
+ * @param yellowBits Same for the yellow cones.
+ * @param blueProjections If not nullptr, filled with the projections of the blue mask while it is written.
+ * @param yellowProjections Same for the yellow mask.
+ */
+typedef MaskCounts (*SegmentBitsKernel)(const uint8_t *frame, size_t step, int rows, int roiY,
+                                        const ColorRange &blue, const ColorRange &yellow,
+                                        uint64_t *blueBits, uint64_t *yellowBits,
+                                        MaskProjections *blueProjections, MaskProjections *yellowProjections);
+
+// Kernel specialised for one frame geometry.
+struct KernelEntry {
+    uint32_t width;
+    uint32_t roiHeight;
+    uint32_t channels;
+    const char *name;
+    SegmentKernel kernel;
+    SegmentBitsKernel bitsKernel;
+};
+
+// All specialised kernels compiled for one instruction set.
+struct IsaKernels {
+    const char *isa;
+    const KernelEntry *entries;
+    size_t count;
+};
+
+// One kernel set per translation unit segmentation-kernels-<isa>.cpp; only the
+// sets for the target architecture are defined.
+namespace scalar { extern const IsaKernels KERNELS; }
+namespace sse2 { extern const IsaKernels KERNELS; }
+namespace avx2 { extern const IsaKernels KERNELS; }
+namespace neon { extern const IsaKernels KERNELS; }
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "segmentation.hpp"
+#include "cone-detection.hpp"
+
+#if defined(__arm__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace {
+
+// Box filter size of the specialised kernels.
+constexpr int KERNEL = 7;
+
+// Returns the kernel sets compiled for this architecture, best first.
+std::vector<const IsaKernels *> compiledKernels()
+{
+#if defined(__x86_64__)
+    return {&avx2::KERNELS, &sse2::KERNELS, &scalar::KERNELS};
+#elif defined(__arm__) || defined(__aarch64__)
+    return {&neon::KERNELS, &scalar::KERNELS};
+#else
+    return {&scalar::KERNELS};
+#endif
+}
+
+// Returns true if the CPU can run the kernels of the given instruction set.
+bool cpuSupports(const std::string &isa)
+{
+#if defined(__x86_64__)
+    if ("avx2" == isa) {
+        __builtin_cpu_init();
+        return 0 != __builtin_cpu_supports("avx2");
+    }
+#elif defined(__arm__) && defined(__linux__)
+    if ("neon" == isa) {
+        return 0 != (getauxval(AT_HWCAP) & HWCAP_NEON);
+    }
+#endif
+    return true;
+}
+
+} // namespace
+
+ColorRange toColorRange(const cv::Scalar &low, const cv::Scalar &high)
+{
+    ColorRange range;
+    range.hLow = cv::saturate_cast<uint8_t>(low[0]);
+    range.sLow = cv::saturate_cast<uint8_t>(low[1]);
+    range.vLow = cv::saturate_cast<uint8_t>(low[2]);
+    range.hHigh = cv::saturate_cast<uint8_t>(high[0]);
+    range.sHigh = cv::saturate_cast<uint8_t>(high[1]);
+    range.vHigh = cv::saturate_cast<uint8_t>(high[2]);
+    return range;
+}
+
+MaskCounts segmentGeneric(const cv::Mat &frame, const cv::Rect &roi,
+                          const ColorRange &blue, const ColorRange &yellow,
+                          cv::Mat &blueMask, cv::Mat &yellowMask)
+{
+    static thread_local cv::Mat imgBlur, imgHSV;
+    cv::blur(frame(roi), imgBlur, cv::Size(BLUR_KERNEL_SIZE, BLUR_KERNEL_SIZE));
+    cv::cvtColor(imgBlur, imgHSV, cv::COLOR_BGR2HSV);
+    cv::inRange(imgHSV, cv::Scalar(blue.hLow, blue.sLow, blue.vLow), cv::Scalar(blue.hHigh, blue.sHigh, blue.vHigh), blueMask);
+    cv::inRange(imgHSV, cv::Scalar(yellow.hLow, yellow.sLow, yellow.vLow), cv::Scalar(yellow.hHigh, yellow.sHigh, yellow.vHigh), yellowMask);
+    MaskCounts counts;
+    counts.blue = static_cast<uint32_t>(cv::countNonZero(blueMask));
+    counts.yellow = static_cast<uint32_t>(cv::countNonZero(yellowMask));
+    return counts;
+}
+
+MaskCounts Segmenter::segment(const cv::Mat &frame, const cv::Rect &roi,
+                              const ColorRange &blue, const ColorRange &yellow,
+                              cv::Mat &blueMask, cv::Mat &yellowMask) const
+{
+    if ((nullptr == kernel) ||
+        (roi.x != 0) || (roi.width != static_cast<int>(width) - 1) || (roi.height != static_cast<int>(roiHeight)) ||
+        (frame.cols != static_cast<int>(width)) || (frame.channels() != static_cast<int>(channels)) || (frame.depth() != CV_8U)) {
+        return segmentGeneric(frame, roi, blue, yellow, blueMask, yellowMask);
+    }
+    blueMask.create(roi.height, roi.width, CV_8UC1);
+    yellowMask.create(roi.height, roi.width, CV_8UC1);
+    return kernel(frame.ptr<uint8_t>(0), frame.step, frame.rows, roi.y, blue, yellow,
+                  blueMask.ptr<uint8_t>(0), yellowMask.ptr<uint8_t>(0));
+}
+
+MaskCounts Segmenter::segmentBits(const cv::Mat &frame, const cv::Rect &roi,
+                                  const ColorRange &blue, const ColorRange &yellow,
+                                  BitMask &blueBits, BitMask &yellowBits,
+                                  MaskProjections *blueProjections, MaskProjections *yellowProjections) const
+{
+    blueBits.create(roi.width, roi.height);
+    yellowBits.create(roi.width, roi.height);
+    if ((nullptr == bitsKernel) ||
+        (roi.x != 0) || (roi.width != static_cast<int>(width) - 1) || (roi.height != static_cast<int>(roiHeight)) ||
+        (frame.cols != static_cast<int>(width)) || (frame.channels() != static_cast<int>(channels)) || (frame.depth() != CV_8U)) {
+        static thread_local cv::Mat blueMask, yellowMask;
+        const MaskCounts counts{segmentGeneric(frame, roi, blue, yellow, blueMask, yellowMask)};
+        blueBits.fromBytes(blueMask);
+        yellowBits.fromBytes(yellowMask);
+        if (nullptr != blueProjections) {
+            blueBits.project(blueProjections->rows, blueProjections->columns);
+        }
+        if (nullptr != yellowProjections) {
+            yellowBits.project(yellowProjections->rows, yellowProjections->columns);
+        }
+        return counts;
+    }
+    return bitsKernel(frame.ptr<uint8_t>(0), frame.step, frame.rows, roi.y, blue, yellow,
+                      blueBits.data(), yellowBits.data(), blueProjections, yellowProjections);
+}
+
+std::vector<std::string> availableIsas()
+{
+    std::vector<std::string> isas;
+    for (const IsaKernels *kernels : compiledKernels()) {
+        if (cpuSupports(kernels->isa)) {
+            isas.push_back(kernels->isa);
+        }
+    }
+    return isas;
+}
+
+Segmenter selectSegmenter(uint32_t width, uint32_t roiHeight, uint32_t channels, const std::string &isa)
+{
+    Segmenter segmenter;
+    if (KERNEL != BLUR_KERNEL_SIZE) {
+        return segmenter;
+    }
+    for (const IsaKernels *kernels : compiledKernels()) {
+        if ((isa.empty() && cpuSupports(kernels->isa)) || (isa == kernels->isa)) {
+            for (size_t i = 0; i < kernels->count; i++) {
+                const KernelEntry &entry = kernels->entries[i];
+                if ((entry.width == width) && (entry.roiHeight == roiHeight) && (entry.channels == channels)) {
+                    segmenter.name = entry.name;
+                    segmenter.isa = kernels->isa;
+                    segmenter.width = width;
+                    segmenter.roiHeight = roiHeight;
+                    segmenter.channels = channels;
+                    segmenter.kernel = entry.kernel;
+                    segmenter.bitsKernel = entry.bitsKernel;
+                }
+            }
+            break;
+        }
+    }
+    return segmenter;
+}
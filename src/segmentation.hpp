@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEGMENTATION_HPP
+#define SEGMENTATION_HPP
+
+// Include the image processing header files from OpenCV
+#include <opencv2/imgproc/imgproc.hpp>
+
+// ColorRange, MaskCounts and the kernels compiled per instruction set
+#include "segmentation-kernels.hpp"
+#include "bit-mask.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Converts the lower and upper cv::Scalar thresholds into a ColorRange.
+ColorRange toColorRange(const cv::Scalar &low, const cv::Scalar &high);
+
+/**
+ * Generic segmentation using cv::blur, cv::cvtColor and cv::inRange; works for
+ * every frame geometry.
+ *
+ * @param frame Complete ARGB frame (CV_8UC4); rows outside the ROI are used as blur border.
+ * @param roi Region of interest to segment.
+ * @param blue Range for the blue cones.
+ * @param yellow Range for the yellow cones.
+ * @param blueMask Output mask for the blue cones (0/255, size of the ROI).
+ * @param yellowMask Output mask for the yellow cones (0/255, size of the ROI).
+ * @return Set pixels per mask.
+ */
+MaskCounts segmentGeneric(const cv::Mat &frame, const cv::Rect &roi,
+                          const ColorRange &blue, const ColorRange &yellow,
+                          cv::Mat &blueMask, cv::Mat &yellowMask);
+
+/**
+ * Segmentation for one frame geometry: blurs the ROI of an ARGB frame with a
+ * BLUR_KERNEL_SIZE box filter, converts it to HSV and thresholds it into one
+ * binary mask per color. Uses a kernel specialised at compile time if one was
+ * selected, otherwise segmentGeneric.
+ */
+struct Segmenter {
+    std::string name{"generic"};
+    std::string isa{"opencv"};
+    uint32_t width{0};
+    uint32_t roiHeight{0};
+    uint32_t channels{0};
+    SegmentKernel kernel{nullptr};
+    SegmentBitsKernel bitsKernel{nullptr};
+
+    // Same parameters and results as segmentGeneric.
+    MaskCounts segment(const cv::Mat &frame, const cv::Rect &roi,
+                       const ColorRange &blue, const ColorRange &yellow,
+                       cv::Mat &blueMask, cv::Mat &yellowMask) const;
+
+    /**
+     * Same as segment, but writes packed masks with one bit per pixel and, if
+     * given, their projections. Without a specialised kernel the byte masks of
+     * segmentGeneric are packed and projected afterwards.
+     */
+    MaskCounts segmentBits(const cv::Mat &frame, const cv::Rect &roi,
+                           const ColorRange &blue, const ColorRange &yellow,
+                           BitMask &blueBits, BitMask &yellowBits,
+                           MaskProjections *blueProjections = nullptr, MaskProjections *yellowProjections = nullptr) const;
+};
+
+// Returns the instruction sets with kernels in this binary that the CPU supports, best first.
+std::vector<std::string> availableIsas();
+
+/**
+ * Selects the segmenter for the given frame geometry: the kernel specialised
+ * at compile time for width, ROI height and channels if one exists, otherwise
+ * the generic one.
+ *
+ * @param width Width of the frame (the ROI spans width - 1 columns).
+ * @param roiHeight Height of the ROI.
+ * @param channels Bytes per pixel.
+ * @param isa Instruction set of the kernel (see availableIsas()); the best one if empty.
+ * @return Segmenter to use for all frames of this geometry.
+ */
+Segmenter selectSegmenter(uint32_t width, uint32_t roiHeight, uint32_t channels, const std::string &isa = "");
+
+#endif
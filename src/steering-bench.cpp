@@ -0,0 +1,601 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing
+#include "cluon-complete.hpp"
+// Cone detection and steering logic of the steering microservice
+#include "cone-detection.hpp"
+// Segmentation kernels compared by the benchmark
+#include "segmentation.hpp"
+#include "incremental-segmentation.hpp"
+#include "cone-bands.hpp"
+// Huge page and NUMA-local scratch buffers
+#include "scratch-arena.hpp"
+// Centreline planner timed after trackCones
+#include "centreline-planner.hpp"
+#include "ground-projection.hpp"
+// Cost of recording in the control loop
+#include "recorder.hpp"
+#include "replay-decoder.hpp"
+// Decoded frames of a recording
+#include "frame-cache.hpp"
+
+// Include the GUI (image loading) and image processing header files from OpenCV
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <dirent.h>
+
+// Library's
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Timings of one pipeline stage in milliseconds
+struct StageTimings {
+    std::string name;
+    std::vector<double> samples;
+};
+
+// Returns the time between two tick counts in milliseconds
+static double toMilliseconds(int64_t start, int64_t end)
+{
+    return (static_cast<double>(end - start) / cv::getTickFrequency()) * 1000.0;
+}
+
+// Loads all images from a directory or a comma-separated list of files as ARGB frames
+static std::vector<cv::Mat> loadFrames(const std::string &source, uint32_t width, uint32_t height)
+{
+    std::vector<std::string> files;
+    DIR *dir = opendir(source.c_str());
+    if (nullptr != dir) {
+        for (struct dirent *entry = readdir(dir); nullptr != entry; entry = readdir(dir)) {
+            const std::string name{entry->d_name};
+            if ('.' != name[0]) {
+                files.push_back(source + "/" + name);
+            }
+        }
+        closedir(dir);
+        std::sort(files.begin(), files.end());
+    } else {
+        files = stringtoolbox::split(source, ',');
+    }
+
+    std::vector<cv::Mat> frames;
+    for (const auto &file : files) {
+        cv::Mat bgr = cv::imread(file, cv::IMREAD_COLOR);
+        if (bgr.empty() || bgr.cols != static_cast<int>(width) || bgr.rows != static_cast<int>(height)) {
+            std::cerr << "Skipping '" << file << "' (not a " << width << "x" << height << " image)." << std::endl;
+            continue;
+        }
+        cv::Mat argb;
+        cv::cvtColor(bgr, argb, cv::COLOR_BGR2BGRA);
+        frames.push_back(argb);
+    }
+    return frames;
+}
+
+// Wraps the cached rows of every frame of a frame cache without copying them
+static std::vector<cv::Mat> cachedFrames(const FrameCache &cache)
+{
+    std::vector<cv::Mat> frames;
+    for (size_t i = 0; i < cache.size(); i++) {
+        frames.push_back(cache.frame(i));
+    }
+    return frames;
+}
+
+// Creates frames with a blue cone row on the left and a yellow cone row on the right moving towards the car
+static std::vector<cv::Mat> syntheticFrames(uint32_t width, uint32_t height, uint32_t count)
+{
+    std::vector<cv::Mat> frames;
+    const int W = static_cast<int>(width);
+    const int H = static_cast<int>(height);
+    for (uint32_t i = 0; i < count; i++) {
+        cv::Mat frame(H, W, CV_8UC4, cv::Scalar(90, 90, 90, 255));
+        const int shift = static_cast<int>(i % 20) * 2;
+        for (int k = 0; k < 4; k++) {
+            const int y = H / 2 + (k * H) / 20 + shift;
+            const int size = 6 + 3 * k;
+            cv::rectangle(frame, cv::Point(W / 5 - 12 * k, y), cv::Point(W / 5 - 12 * k + size, y + size), cv::Scalar(160, 60, 20, 255), -1);
+            cv::rectangle(frame, cv::Point(4 * W / 5 + 12 * k, y), cv::Point(4 * W / 5 + 12 * k + size, y + size), cv::Scalar(40, 190, 200, 255), -1);
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+static void printTimings(const std::vector<StageTimings> &stages)
+{
+    std::cout << "stage;frames;mean (ms);median (ms);p95 (ms);max (ms)" << std::endl;
+    for (auto stage : stages) {
+        if (stage.samples.empty()) {
+            continue;
+        }
+        std::sort(stage.samples.begin(), stage.samples.end());
+        double sum = 0.0;
+        for (double s : stage.samples) {
+            sum += s;
+        }
+        const size_t N = stage.samples.size();
+        std::cout << std::fixed << std::setprecision(4)
+                  << stage.name << ";" << N << ";" << sum / static_cast<double>(N)
+                  << ";" << stage.samples[N / 2]
+                  << ";" << stage.samples[std::min(N - 1, (N * 95) / 100)]
+                  << ";" << stage.samples[N - 1] << std::endl;
+    }
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+    int32_t retCode{0};
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " measures the per-stage processing time of the steering pipeline." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--frames=<directory or comma-separated images>|--cache=<frame cache>] [--width=640] [--height=480] [--iterations=<passes>] [--force-isa=<isa>] [--huge-pages] [--numa-local] [--record=<file.rec>] [--replay=<file.rec>]" << std::endl;
+        std::cerr << "         --frames:     images to process; synthetic frames are used if omitted" << std::endl;
+        std::cerr << "                       they are also segmented incrementally in sorted order, so pass consecutive frames of a recording" << std::endl;
+        std::cerr << "         --cache:      frames of a frame cache written by steering-frame-cache instead of images; sets --width and --height" << std::endl;
+        std::cerr << "         --width:      width of the frame" << std::endl;
+        std::cerr << "         --height:     height of the frame" << std::endl;
+        std::cerr << "         --iterations: number of passes over all frames (default: 20)" << std::endl;
+        std::cerr << "         --force-isa:  compare only the segmentation kernels of this instruction set (default: all supported)" << std::endl;
+        std::cerr << "         --huge-pages: place frames and masks on huge pages" << std::endl;
+        std::cerr << "         --numa-local: place frames and masks on the NUMA node the benchmark starts on" << std::endl;
+        std::cerr << "         --record:     record the frames like steering --record with every codec into this file, timing the control loop's share" << std::endl;
+        std::cerr << "         --replay:     stream the frames of a recording of --width x --height through segmentation and cone detection" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --frames=recordings/frames --iterations=50" << std::endl;
+        return retCode;
+    }
+
+    // A frame cache determines the size of the frames.
+    std::unique_ptr<FrameCache> cache;
+    if (0 != commandlineArguments.count("cache")) {
+        cache.reset(new FrameCache{commandlineArguments["cache"]});
+        if (!cache->valid()) {
+            return 1;
+        }
+    }
+    const uint32_t WIDTH{cache ? cache->header().width : static_cast<uint32_t>((0 != commandlineArguments.count("width")) ? std::stoi(commandlineArguments["width"]) : 640)};
+    const uint32_t HEIGHT{cache ? cache->header().height : static_cast<uint32_t>((0 != commandlineArguments.count("height")) ? std::stoi(commandlineArguments["height"]) : 480)};
+    const uint32_t ITERATIONS{static_cast<uint32_t>((0 != commandlineArguments.count("iterations")) ? std::stoi(commandlineArguments["iterations"]) : 20)};
+
+    std::vector<cv::Mat> frames = cache ? cachedFrames(*cache) :
+        (0 != commandlineArguments.count("frames")) ? loadFrames(commandlineArguments["frames"], WIDTH, HEIGHT) : syntheticFrames(WIDTH, HEIGHT, 100);
+    if (frames.empty()) {
+        std::cerr << argv[0] << ": No frames to process." << std::endl;
+        return 1;
+    }
+
+    // Same crop zone as the steering microservice; cached frames hold only some rows, so they are cropped at frameRoi.
+    cv::Rect roi{cropZone(static_cast<int>(WIDTH), static_cast<int>(HEIGHT))};
+    const cv::Rect frameRoi{cache ? cache->crop(roi) : roi};
+    if (0 == frameRoi.area()) {
+        std::cerr << argv[0] << ": The frame cache does not hold the rows of the crop zone." << std::endl;
+        return 1;
+    }
+
+    // Frames and masks in a scratch arena like in the microservice; compare runs with and without --huge-pages.
+    // Cached frames stay in the mapping of the frame cache.
+    const size_t frameSize{cache ? 0 : static_cast<size_t>(WIDTH) * HEIGHT * 4};
+    const size_t maskSize{static_cast<size_t>(roi.width) * static_cast<size_t>(roi.height)};
+    ScratchArena arena{frames.size() * (frameSize + 64) + 4 * (maskSize + 64), 0 != commandlineArguments.count("huge-pages"),
+                       0 != commandlineArguments.count("numa-local")};
+    if (!arena.valid()) {
+        return 1;
+    }
+    if (!cache) {
+        for (auto &frame : frames) {
+            cv::Mat placed(static_cast<int>(HEIGHT), static_cast<int>(WIDTH), CV_8UC4, arena.allocate(frameSize));
+            frame.copyTo(placed);
+            frame = placed;
+        }
+    }
+    std::cout << argv[0] << ": Frames and masks (" << arena.backing() << "): " << describe(arena.statistics()) << std::endl;
+    centerPoint = cv::Point(WIDTH / 2, roi.height);
+
+    // Planner with the defaults of the microservice.
+    const GroundProjection ground{intrinsicsFromFieldOfView(WIDTH, HEIGHT, 62.2f), roi, 0.1f, 0.0f};
+    CentrelinePlanner planner{0.12f, 0.6f, 1.0f, 0.2f, 1.5f, static_cast<float>(MAX_ANGLE)};
+
+    std::vector<StageTimings> stages{
+        {"copy", {}}, {"blur", {}}, {"cvtColor", {}}, {"inRange", {}}, {"contours", {}}, {"trackCones", {}}, {"planner", {}}, {"total", {}}};
+    for (auto &stage : stages) {
+        stage.samples.reserve(frames.size() * ITERATIONS);
+    }
+
+    cv::Mat img, imgBlur, imgHSV, frameHSV, frameCropped;
+    for (uint32_t iteration = 0; iteration < ITERATIONS; iteration++) {
+        for (const auto &frame : frames) {
+            const int64_t t0 = cv::getTickCount();
+            img = frame.clone();
+            frameCropped = img(frameRoi);
+            const int64_t t1 = cv::getTickCount();
+            cv::blur(frameCropped, imgBlur, cv::Size(BLUR_KERNEL_SIZE, BLUR_KERNEL_SIZE));
+            const int64_t t2 = cv::getTickCount();
+            cv::cvtColor(imgBlur, imgHSV, cv::COLOR_BGR2HSV);
+            const int64_t t3 = cv::getTickCount();
+            cv::inRange(imgHSV, blueLow, blueHigh, frameHSV);
+            const int64_t t4 = cv::getTickCount();
+            getBlueCones(frameHSV, frameCropped, cv::Scalar(255, 0, 0));
+            const int64_t t5 = cv::getTickCount();
+            cv::inRange(imgHSV, yellowLow, yellowHigh, frameHSV);
+            const int64_t t6 = cv::getTickCount();
+            getYellowCones(frameHSV, frameCropped, cv::Scalar(0, 255, 255));
+            const int64_t t7 = cv::getTickCount();
+            trackCones();
+            const int64_t t8 = cv::getTickCount();
+            planner.plan(ground, blueConeList, yellowConeList);
+            const int64_t t9 = cv::getTickCount();
+
+            stages[0].samples.push_back(toMilliseconds(t0, t1));
+            stages[1].samples.push_back(toMilliseconds(t1, t2));
+            stages[2].samples.push_back(toMilliseconds(t2, t3));
+            stages[3].samples.push_back(toMilliseconds(t3, t4) + toMilliseconds(t5, t6));
+            stages[4].samples.push_back(toMilliseconds(t4, t5) + toMilliseconds(t6, t7));
+            stages[5].samples.push_back(toMilliseconds(t7, t8));
+            stages[6].samples.push_back(toMilliseconds(t8, t9));
+            stages[7].samples.push_back(toMilliseconds(t0, t9));
+        }
+    }
+
+    std::cout << argv[0] << ": " << frames.size() << " frames x " << ITERATIONS << " iterations, " << WIDTH << "x" << HEIGHT << std::endl;
+    printTimings(stages);
+
+    // Compare the segmenters for this geometry, one per instruction set or only
+    // the forced one, against the generic OpenCV path.
+    std::vector<std::string> isas{availableIsas()};
+    if (0 != commandlineArguments.count("force-isa")) {
+        const std::string ISA{commandlineArguments["force-isa"]};
+        if (isas.end() == std::find(isas.begin(), isas.end(), ISA)) {
+            std::cerr << argv[0] << ": Instruction set '" << ISA << "' is not available." << std::endl;
+            return 1;
+        }
+        isas = {ISA};
+    }
+    std::vector<Segmenter> candidates{Segmenter()};
+    for (const auto &isa : isas) {
+        const Segmenter segmenter{selectSegmenter(WIDTH, static_cast<uint32_t>(roi.height), 4, isa)};
+        if (nullptr != segmenter.kernel) {
+            candidates.push_back(segmenter);
+        }
+    }
+    const ColorRange blue{toColorRange(blueLow, blueHigh)};
+    const ColorRange yellow{toColorRange(yellowLow, yellowHigh)};
+    std::vector<StageTimings> segmenters;
+    for (const auto &candidate : candidates) {
+        segmenters.push_back({"segment (" + candidate.name + ", " + candidate.isa + ")", {}});
+    }
+    uint64_t mismatches{0};
+    cv::Mat blueMask(roi.height, roi.width, CV_8UC1, arena.allocate(maskSize));
+    cv::Mat yellowMask(roi.height, roi.width, CV_8UC1, arena.allocate(maskSize));
+    cv::Mat blueReference(roi.height, roi.width, CV_8UC1, arena.allocate(maskSize));
+    cv::Mat yellowReference(roi.height, roi.width, CV_8UC1, arena.allocate(maskSize));
+    cv::Mat difference;
+    for (uint32_t iteration = 0; iteration < ITERATIONS; iteration++) {
+        for (const auto &frame : frames) {
+            for (size_t i = 0; i < candidates.size(); i++) {
+                cv::Mat &blueOut = (0 == i) ? blueReference : blueMask;
+                cv::Mat &yellowOut = (0 == i) ? yellowReference : yellowMask;
+                const int64_t t0 = cv::getTickCount();
+                const MaskCounts counts = candidates[i].segment(frame, frameRoi, blue, yellow, blueOut, yellowOut);
+                const int64_t t1 = cv::getTickCount();
+                segmenters[i].samples.push_back(toMilliseconds(t0, t1));
+
+                if ((0 != i) && (0 == iteration)) {
+                    cv::absdiff(blueMask, blueReference, difference);
+                    mismatches += static_cast<uint64_t>(cv::countNonZero(difference));
+                    cv::absdiff(yellowMask, yellowReference, difference);
+                    mismatches += static_cast<uint64_t>(cv::countNonZero(difference));
+                    mismatches += (counts.blue != static_cast<uint32_t>(cv::countNonZero(blueReference))) ? 1 : 0;
+                    mismatches += (counts.yellow != static_cast<uint32_t>(cv::countNonZero(yellowReference))) ? 1 : 0;
+                }
+            }
+        }
+    }
+    printTimings(segmenters);
+    std::cout << "Mask pixels and counts differing from the generic segmenter: " << mismatches << std::endl;
+
+    // Incremental segmentation of the frames in order against a full segmentation of each.
+    {
+        IncrementalSegmenter incremental{candidates.back(), frameRoi};
+        StageTimings timings{"segment (incremental, " + candidates.back().isa + ")", {}};
+        uint64_t differing{0};
+        for (const auto &frame : frames) {
+            const int64_t t0 = cv::getTickCount();
+            incremental.segment(frame, blue, yellow, blueMask, yellowMask);
+            const int64_t t1 = cv::getTickCount();
+            timings.samples.push_back(toMilliseconds(t0, t1));
+            candidates.back().segment(frame, frameRoi, blue, yellow, blueReference, yellowReference);
+            cv::absdiff(blueMask, blueReference, difference);
+            differing += static_cast<uint64_t>(cv::countNonZero(difference));
+            cv::absdiff(yellowMask, yellowReference, difference);
+            differing += static_cast<uint64_t>(cv::countNonZero(difference));
+        }
+        printTimings({timings});
+        std::cout << "Incremental segmentation: " << (incremental.skippedFraction() * 100.0) << "% of " << incremental.tiles() << " tiles skipped, "
+                  << (100.0 * static_cast<double>(differing) / (2.0 * static_cast<double>(maskSize) * static_cast<double>(frames.size())))
+                  << "% of the mask pixels differ from a full segmentation." << std::endl;
+    }
+
+    // Packed masks: the bit kernels against the byte masks of the generic
+    // segmenter, and the blobs of the packed masks against the contours.
+    {
+        std::vector<StageTimings> timings;
+        BitMask blueBits, yellowBits;
+        cv::Mat unpacked;
+        uint64_t differing{0};
+        for (const auto &candidate : candidates) {
+            timings.push_back({"segment bits (" + candidate.name + ", " + candidate.isa + ")", {}});
+            for (const auto &frame : frames) {
+                candidates.front().segment(frame, frameRoi, blue, yellow, blueReference, yellowReference);
+                const int64_t t0 = cv::getTickCount();
+                const MaskCounts counts = candidate.segmentBits(frame, frameRoi, blue, yellow, blueBits, yellowBits);
+                const int64_t t1 = cv::getTickCount();
+                timings.back().samples.push_back(toMilliseconds(t0, t1));
+                blueBits.toBytes(unpacked);
+                cv::absdiff(unpacked, blueReference, difference);
+                differing += static_cast<uint64_t>(cv::countNonZero(difference));
+                yellowBits.toBytes(unpacked);
+                cv::absdiff(unpacked, yellowReference, difference);
+                differing += static_cast<uint64_t>(cv::countNonZero(difference));
+                differing += (counts.blue != blueBits.count()) ? 1 : 0;
+                differing += (counts.yellow != yellowBits.count()) ? 1 : 0;
+            }
+        }
+
+        StageTimings contours{"cones (findContours)", {}};
+        StageTimings blobs{"cones (BlobFinder)", {}};
+        BlobFinder blobFinder{roi.width, roi.height};
+        BlobList blobList;
+        std::vector<std::vector<cv::Point>> found;
+        uint64_t differentBoxes{0};
+        for (const auto &frame : frames) {
+            candidates.front().segment(frame, frameRoi, blue, yellow, blueReference, yellowReference);
+            candidates.front().segmentBits(frame, frameRoi, blue, yellow, blueBits, yellowBits);
+            for (int color = 0; color < 2; color++) {
+                (0 == color ? blueReference : yellowReference).copyTo(blueMask);
+                const int64_t t0 = cv::getTickCount();
+                cv::findContours(blueMask, found, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point());
+                std::vector<cv::Rect> boxes;
+                for (const auto &contour : found) {
+                    boxes.push_back(cv::boundingRect(contour));
+                }
+                const int64_t t1 = cv::getTickCount();
+                blobFinder.find(0 == color ? blueBits : yellowBits, blobList);
+                const int64_t t2 = cv::getTickCount();
+                contours.samples.push_back(toMilliseconds(t0, t1));
+                blobs.samples.push_back(toMilliseconds(t1, t2));
+
+                // Blobs inside holes of other blobs have no external contour.
+                for (uint32_t i = 0; i < blobList.count; i++) {
+                    const cv::Rect &box = blobList.blobs[i].box;
+                    const bool nested{boxes.end() == std::find(boxes.begin(), boxes.end(), box)};
+                    differentBoxes += nested ? 1 : 0;
+                }
+                differentBoxes += (boxes.size() > blobList.count) ? (boxes.size() - blobList.count) : 0;
+            }
+        }
+        timings.push_back(contours);
+        timings.push_back(blobs);
+        printTimings(timings);
+        std::cout << "Packed mask pixels and counts differing from the generic segmenter: " << differing << std::endl;
+        std::cout << "Blob boxes without a matching contour (nested blobs or dropped beyond " << BlobList::CAPACITY << "): " << differentBoxes << std::endl;
+        mismatches += differing;
+    }
+
+    // Cones from the projections of the packed masks against getBlueCones and
+    // getYellowCones on the contours of the byte masks; neither path draws, so
+    // both timings are detection only.
+    {
+        StageTimings segmentBytes{"segment (" + candidates.back().name + ", " + candidates.back().isa + ")", {}};
+        StageTimings contourCones{"cones (findContours)", {}};
+        StageTimings segmentProjected{"segment bits + projections (" + candidates.back().isa + ")", {}};
+        StageTimings projectedCones{"cones (projections)", {}};
+        BitMask blueBits, yellowBits;
+        ConeBandFinder blueBands{roi.width, roi.height}, yellowBands{roi.width, roi.height};
+        BlobList blueBlobs, yellowBlobs;
+        auto sorted = [](const ConeList &cones) {
+            std::vector<cv::Rect> boxes(cones.boxes, cones.boxes + cones.count);
+            std::sort(boxes.begin(), boxes.end(), [](const cv::Rect &a, const cv::Rect &b) {
+                return (a.y != b.y) ? (a.y < b.y) : (a.x < b.x);
+            });
+            return boxes;
+        };
+        uint64_t sameCone{0}, sameList{0};
+        for (const auto &frame : frames) {
+            const int64_t t0 = cv::getTickCount();
+            const MaskCounts counts = candidates.back().segment(frame, frameRoi, blue, yellow, blueMask, yellowMask);
+            const int64_t t1 = cv::getTickCount();
+            const bool blueFound{(0 != counts.blue) && getBlueCones(blueMask, cv::Mat(), cv::Scalar(255, 0, 0))};
+            const bool yellowFound{(0 != counts.yellow) && getYellowCones(yellowMask, cv::Mat(), cv::Scalar(0, 255, 255))};
+            const int64_t t2 = cv::getTickCount();
+            const cv::Point contourBlue{blueCone}, contourYellow{yellowCone};
+            const std::vector<cv::Rect> contourBlueList{sorted(blueConeList)}, contourYellowList{sorted(yellowConeList)};
+
+            const int64_t t3 = cv::getTickCount();
+            const MaskCounts bitCounts = candidates.back().segmentBits(frame, frameRoi, blue, yellow, blueBits, yellowBits,
+                                                                        blueBands.projections(), yellowBands.projections());
+            const int64_t t4 = cv::getTickCount();
+            bool blueProjected{false}, yellowProjected{false};
+            if (0 != bitCounts.blue) {
+                blueBands.find(blueBits, blueBlobs, MIN_BLUE_CONE_AREA);
+                blueProjected = getBlueCones(blueBlobs, cv::Mat(), cv::Scalar(255, 0, 0));
+            }
+            if (0 != bitCounts.yellow) {
+                yellowBands.find(yellowBits, yellowBlobs, MIN_YELLOW_CONE_AREA);
+                yellowProjected = getYellowCones(yellowBlobs, cv::Mat(), cv::Scalar(0, 255, 255));
+            }
+            const int64_t t5 = cv::getTickCount();
+            segmentBytes.samples.push_back(toMilliseconds(t0, t1));
+            contourCones.samples.push_back(toMilliseconds(t1, t2));
+            segmentProjected.samples.push_back(toMilliseconds(t3, t4));
+            projectedCones.samples.push_back(toMilliseconds(t4, t5));
+
+            sameCone += ((blueFound == blueProjected) && (!blueFound || (contourBlue == blueCone)) &&
+                         (yellowFound == yellowProjected) && (!yellowFound || (contourYellow == yellowCone))) ? 1 : 0;
+            sameList += ((!blueFound || (contourBlueList == sorted(blueConeList))) &&
+                         (!yellowFound || (contourYellowList == sorted(yellowConeList)))) ? 1 : 0;
+        }
+        printTimings({segmentBytes, contourCones, segmentProjected, projectedCones});
+        std::cout << "Cones from projections: tracked cones agree in " << sameCone << " and cone lists in " << sameList << " of " << frames.size()
+                  << " frames; blobs traced for " << (blueBands.fallbacks() + yellowBands.fallbacks()) << " of "
+                  << (blueBands.masks() + yellowBands.masks()) << " masks." << std::endl;
+
+        // More specks than fit into a BlobList above three cones at the bottom:
+        // the specks are too small for cones and must not push them out of the list.
+        cv::Mat specks(roi.height, roi.width, CV_8UC1, cv::Scalar(0));
+        const int perRow{(roi.width - 2) / 6};
+        for (int i = 0; i < 2 * static_cast<int>(BlobList::CAPACITY); i++) {
+            const cv::Point corner(2 + (i % perRow) * 6, 2 + (i / perRow) * 6);
+            cv::rectangle(specks, corner, corner + cv::Point(1, 1), cv::Scalar(255), -1);
+        }
+        for (int k = 0; k < 3; k++) {
+            const cv::Point corner((k + 1) * roi.width / 4, roi.height - 14 - 8 * k);
+            cv::rectangle(specks, corner, corner + cv::Point(9, 11), cv::Scalar(255), -1);
+        }
+        BitMask speckBits;
+        speckBits.fromBytes(specks);
+        speckBits.project(blueBands.projections()->rows, blueBands.projections()->columns);
+        speckBits.project(yellowBands.projections()->rows, yellowBands.projections()->columns);
+        BlobFinder speckFinder{roi.width, roi.height};
+        uint64_t speckDiffering{0};
+        getBlueCones(specks.clone(), cv::Mat(), cv::Scalar(255, 0, 0));
+        getYellowCones(specks.clone(), cv::Mat(), cv::Scalar(0, 255, 255));
+        const cv::Point contourBlue{blueCone}, contourYellow{yellowCone};
+        const std::vector<cv::Rect> contourBlueList{sorted(blueConeList)}, contourYellowList{sorted(yellowConeList)};
+        for (int path = 0; path < 2; path++) {
+            if (0 == path) {
+                speckFinder.find(speckBits, blueBlobs, MIN_BLUE_CONE_AREA);
+                speckFinder.find(speckBits, yellowBlobs, MIN_YELLOW_CONE_AREA);
+            } else {
+                blueBands.find(speckBits, blueBlobs, MIN_BLUE_CONE_AREA);
+                yellowBands.find(speckBits, yellowBlobs, MIN_YELLOW_CONE_AREA);
+            }
+            getBlueCones(blueBlobs, cv::Mat(), cv::Scalar(255, 0, 0));
+            getYellowCones(yellowBlobs, cv::Mat(), cv::Scalar(0, 255, 255));
+            speckDiffering += ((contourBlue != blueCone) || (contourBlueList != sorted(blueConeList))) ? 1 : 0;
+            speckDiffering += ((contourYellow != yellowCone) || (contourYellowList != sorted(yellowConeList))) ? 1 : 0;
+        }
+        std::cout << "Cones below " << 2 * BlobList::CAPACITY << " specks differing from findContours (blobs, projections): " << speckDiffering
+                  << std::endl;
+        mismatches += speckDiffering;
+    }
+
+    // The part of recording that runs in the control loop, copying the rows and queueing them, and the size of the
+    // recorded frames for every codec; frames are paced at 30 Hz so that the encoders run like in the microservice.
+    if (0 != commandlineArguments.count("record")) {
+        const cv::Range rows{recordedRows(roi, static_cast<int>(HEIGHT))};
+        const double rawBytes{static_cast<double>(WIDTH) * rows.size() * 4};
+        std::vector<StageTimings> timings;
+        // The recorder addresses rows of full frames; cached rows are placed into one before the timed part.
+        cv::Mat staged;
+        if (cache) {
+            staged = cv::Mat(static_cast<int>(HEIGHT), static_cast<int>(WIDTH), CV_8UC4, cv::Scalar(0, 0, 0, 0));
+        }
+        for (const std::string name : {"png", "jpeg", "lz4"}) {
+            FrameCodec codec{FrameCodec::PNG};
+            parseFrameCodec(name, codec);
+            StageTimings record{"record " + name + " (snapshot + commit)", {}};
+            uint64_t dropped{0}, bytes{0};
+            {
+                Recorder recorder{commandlineArguments["record"], static_cast<int>(WIDTH), rows.start, rows.size(), codec};
+                if (!recorder.valid()) {
+                    return 1;
+                }
+                int64_t sampleTimeStamp{0};
+                for (const auto &frame : frames) {
+                    if (cache) {
+                        frame.copyTo(staged.rowRange(static_cast<int>(cache->header().firstRow),
+                                                     static_cast<int>(cache->header().firstRow) + frame.rows));
+                    }
+                    const int64_t t0 = cv::getTickCount();
+                    Recorder::Frame *snapshot{recorder.snapshot(cache ? staged : frame)};
+                    if (nullptr != snapshot) {
+                        recorder.commit(snapshot, sampleTimeStamp);
+                    }
+                    const int64_t t1 = cv::getTickCount();
+                    record.samples.push_back(toMilliseconds(t0, t1));
+                    sampleTimeStamp += 33333;
+                    std::this_thread::sleep_for(std::chrono::microseconds(33333));
+                }
+                dropped = recorder.droppedFrames();
+            }
+            // The recording is complete once the recorder is destroyed.
+            bytes = static_cast<uint64_t>(std::ifstream(commandlineArguments["record"], std::ios::binary | std::ios::ate).tellg());
+            timings.push_back(record);
+            const uint64_t recorded{frames.size() - dropped};
+            std::cout << name << ": " << dropped << " of " << frames.size() << " frames dropped, "
+                      << std::fixed << std::setprecision(1) << ((0 != recorded) ? bytes / 1024.0 / recorded : 0.0) << " kB per recorded frame ("
+                      << ((0 != bytes) ? rawBytes * recorded / bytes : 0.0) << ":1, "
+                      << ((0 != recorded) ? bytes * 30.0 / recorded / (1 << 20) : 0.0) << " MiB/s at 30 Hz)" << std::endl;
+        }
+        printTimings(timings);
+    }
+
+    // Frames of a recording streamed through the ReplayDecoder into segmentation and cone detection as fast as
+    // possible, decoding on one thread and on one per core.
+    if (0 != commandlineArguments.count("replay")) {
+        Recording recording{commandlineArguments["replay"]};
+        if (!recording.valid()) {
+            std::cerr << argv[0] << ": " << commandlineArguments["replay"] << " contains no Envelopes." << std::endl;
+            return 1;
+        }
+        for (const uint32_t workers : {1U, std::max(std::thread::hardware_concurrency(), 1U)}) {
+            StageTimings wait{"replay wait (" + std::to_string(workers) + " decoders)", {}};
+            StageTimings pipeline{"replay segment + cones (" + std::to_string(workers) + " decoders)", {}};
+            const int64_t start = cv::getTickCount();
+            ReplayDecoder decoder{recording, recording.index(), static_cast<int>(WIDTH), static_cast<int>(HEIGHT), workers};
+            uint64_t replayed{0};
+            int64_t t0 = cv::getTickCount();
+            for (const ReplayDecoder::Item *item = decoder.next(); nullptr != item; item = decoder.next()) {
+                if (!item->decoded) {
+                    t0 = cv::getTickCount();
+                    continue;
+                }
+                const int64_t t1 = cv::getTickCount();
+                const MaskCounts counts = candidates.back().segment(item->image, roi, blue, yellow, blueMask, yellowMask);
+                if (0 != counts.blue) {
+                    getBlueCones(blueMask, cv::Mat(), cv::Scalar(255, 0, 0));
+                }
+                if (0 != counts.yellow) {
+                    getYellowCones(yellowMask, cv::Mat(), cv::Scalar(0, 255, 255));
+                }
+                const int64_t t2 = cv::getTickCount();
+                wait.samples.push_back(toMilliseconds(t0, t1));
+                pipeline.samples.push_back(toMilliseconds(t1, t2));
+                replayed++;
+                t0 = cv::getTickCount();
+            }
+            const double seconds{toMilliseconds(start, cv::getTickCount()) / 1000.0};
+            printTimings({wait, pipeline});
+            std::cout << "Replay with " << workers << " decoders: " << replayed << " frames in " << std::fixed << std::setprecision(2) << seconds
+                      << " s (" << ((0.0 < seconds) ? replayed / seconds : 0.0) << " frames/s), waited for " << decoder.stalls() << " frames" << std::endl;
+        }
+    }
+
+    if (0 != mismatches) {
+        retCode = 1;
+    }
+    return retCode;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing
+#include "cluon-complete.hpp"
+// Cone detection for the size of the blur
+#include "cone-detection.hpp"
+// Memory-mapped frame caches and recordings
+#include "frame-cache.hpp"
+#include "recording.hpp"
+
+// Library's
+#include <cmath>
+#include <iostream>
+#include <string>
+
+int32_t main(int32_t argc, char **argv)
+{
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if ((0 == commandlineArguments.count("cache")) ||
+        ((0 != commandlineArguments.count("rec")) && ((0 == commandlineArguments.count("width")) || (0 == commandlineArguments.count("height"))))) {
+        std::cerr << argv[0] << " decodes the frames of a recording of steering --record into a frame cache that is used without decoding." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --cache=<file> [--rec=<file> --width=<width> --height=<height> [--workers=<n>]]" << std::endl;
+        std::cerr << "         --cache:   frame cache to write, or to describe if --rec is omitted" << std::endl;
+        std::cerr << "         --rec:     recording to decode" << std::endl;
+        std::cerr << "         --width:   width of the recorded frames" << std::endl;
+        std::cerr << "         --height:  height of the recorded frames" << std::endl;
+        std::cerr << "         --workers: decoding threads (default: one per core)" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --rec=recordings/lap.rec --cache=recordings/lap.cache --width=640 --height=480" << std::endl;
+        return 1;
+    }
+    const std::string CACHE{commandlineArguments["cache"]};
+
+    if (0 != commandlineArguments.count("rec")) {
+        const std::string REC{commandlineArguments["rec"]};
+        const int WIDTH{std::stoi(commandlineArguments["width"])};
+        const int HEIGHT{std::stoi(commandlineArguments["height"])};
+        const uint32_t WORKERS{static_cast<uint32_t>((0 != commandlineArguments.count("workers")) ? std::stoi(commandlineArguments["workers"]) : 0)};
+        Recording recording{REC};
+        if (!recording.valid()) {
+            std::cerr << argv[0] << ": " << REC << " contains no Envelopes." << std::endl;
+            return 1;
+        }
+        // The rows steering --record keeps: the crop zone of the microservice and the border of the blur.
+        const cv::Range rows{recordedRows(cropZone(WIDTH, HEIGHT), HEIGHT)};
+
+        const cluon::data::TimeStamp BEFORE{cluon::time::now()};
+        const int64_t frames{writeFrameCache(CACHE, recording, WIDTH, HEIGHT, rows.start, rows.size(), WORKERS)};
+        const cluon::data::TimeStamp AFTER{cluon::time::now()};
+        if (frames < 0) {
+            return 1;
+        }
+        std::cout << REC << ": " << frames << " frames cached in " << cluon::time::deltaInMicroseconds(AFTER, BEFORE) / 1000.0 << " ms" << std::endl;
+    }
+
+    FrameCache cache{CACHE};
+    if (!cache.valid()) {
+        return 1;
+    }
+    const FrameCacheHeader &header{cache.header()};
+    uint64_t groundTruth{0}, recorded{0};
+    for (size_t i = 0; i < cache.size(); i++) {
+        groundTruth += std::isnan(cache.entry(i).groundSteering) ? 0 : 1;
+        recorded += std::isnan(cache.entry(i).recordedSteering) ? 0 : 1;
+    }
+    std::cout << CACHE << ": " << cache.size() << " frames of " << header.width << "x" << header.height << ", rows " << header.firstRow
+              << " to " << (header.firstRow + header.rows) << "; " << groundTruth << " with ground truth steering, " << recorded
+              << " with recorded steering" << std::endl;
+    if (0 != cache.size()) {
+        std::cout << "From " << cache.entry(0).sampleTimeStamp << " to " << cache.entry(cache.size() - 1).sampleTimeStamp << " us" << std::endl;
+    }
+    return 0;
+}
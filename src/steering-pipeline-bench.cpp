@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing and cluon::NotifyingPipeline
+#include "cluon-complete.hpp"
+// Lock-free bounded pipeline
+#include "mpsc-pipeline.hpp"
+
+#include <sys/resource.h>
+
+// Library's
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Entry as produced by a receiver: who sent it, in which order and when.
+struct Entry {
+    int64_t enqueued{0};
+    uint32_t producer{0};
+    uint32_t sequence{0};
+};
+
+int64_t nowInNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t voluntaryContextSwitches()
+{
+    struct rusage usage {};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<int64_t>(usage.ru_nvcsw);
+}
+
+// Consumer side: checks the order per producer and sums up the latencies.
+class Consumer {
+   public:
+    explicit Consumer(uint32_t producers)
+        : m_next(producers, 0)
+    {
+    }
+
+    void operator()(Entry &&entry)
+    {
+        m_latency += nowInNanoseconds() - entry.enqueued;
+        m_outOfOrder += (entry.sequence != m_next[entry.producer]) ? 1 : 0;
+        m_next[entry.producer] = entry.sequence + 1;
+        m_received.fetch_add(1, std::memory_order_release);
+    }
+
+    std::vector<uint32_t> m_next;
+    int64_t m_latency{0};
+    uint32_t m_outOfOrder{0};
+    std::atomic<uint32_t> m_received{0};
+};
+
+struct Result {
+    double seconds{0};
+    int64_t contextSwitches{0};
+    uint64_t full{0};
+};
+
+/**
+ * Runs the producers; each adds count entries in bursts of burst entries
+ * with pause microseconds between bursts (0 = no pause). ADD returns false
+ * if the entry could not be added and is retried then.
+ */
+template <typename ADD>
+Result produce(uint32_t producers, uint32_t count, uint32_t burst, uint32_t pause, Consumer &consumer, ADD add)
+{
+    Result result;
+    std::atomic<uint64_t> full{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++) {
+        threads.emplace_back([p, count, burst, pause, &add, &full, &start]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            for (uint32_t i = 0; i < count;) {
+                for (uint32_t b = 0; (b < burst) && (i < count); b++, i++) {
+                    Entry entry;
+                    entry.producer = p;
+                    entry.sequence = i;
+                    entry.enqueued = nowInNanoseconds();
+                    while (!add(Entry(entry))) {
+                        full++;
+                        std::this_thread::yield();
+                    }
+                }
+                if (0 < pause) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(pause));
+                }
+            }
+        });
+    }
+    const int64_t contextSwitchesBefore{voluntaryContextSwitches()};
+    const auto before{std::chrono::steady_clock::now()};
+    start.store(true);
+    for (auto &t : threads) {
+        t.join();
+    }
+    while (consumer.m_received.load(std::memory_order_acquire) < producers * count) {
+        std::this_thread::yield();
+    }
+    const auto after{std::chrono::steady_clock::now()};
+    result.seconds = std::chrono::duration<double>(after - before).count();
+    result.contextSwitches = voluntaryContextSwitches() - contextSwitchesBefore;
+    result.full = full.load();
+    return result;
+}
+
+void print(const std::string &name, uint32_t producers, uint32_t count, const Result &result, const Consumer &consumer, uint64_t parked)
+{
+    const double entries{static_cast<double>(producers) * count};
+    std::cout << name << ";" << producers << ";" << entries / result.seconds / 1e6 << ";"
+              << static_cast<double>(consumer.m_latency) / entries / 1000.0 << ";"
+              << static_cast<double>(result.contextSwitches) / entries << ";" << result.full << ";" << parked << ";"
+              << consumer.m_outOfOrder << std::endl;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char **argv)
+{
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " compares cluon::NotifyingPipeline with MPSCPipeline for several producer threads." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--count=<entries>] [--burst=<entries>] [--pause=<us>] [--capacity=<slots>] [--producers=<n>]" << std::endl;
+        std::cerr << "         --count:     entries per producer (default: 200000)" << std::endl;
+        std::cerr << "         --burst:     entries added back to back (default: 64)" << std::endl;
+        std::cerr << "         --pause:     microseconds between bursts; 0 adds as fast as possible (default: 0)" << std::endl;
+        std::cerr << "         --capacity:  slots of MPSCPipeline (default: 1024)" << std::endl;
+        std::cerr << "         --producers: run only this number of producers instead of 1, 2, 4 and 8" << std::endl;
+        return 1;
+    }
+    const uint32_t COUNT{(0 != commandlineArguments.count("count")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["count"])) : 200000};
+    const uint32_t BURST{(0 != commandlineArguments.count("burst")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["burst"])) : 64};
+    const uint32_t PAUSE{(0 != commandlineArguments.count("pause")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["pause"])) : 0};
+    const uint32_t CAPACITY{(0 != commandlineArguments.count("capacity")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["capacity"])) : 1024};
+    std::vector<uint32_t> producerCounts{1, 2, 4, 8};
+    if (0 != commandlineArguments.count("producers")) {
+        producerCounts = {static_cast<uint32_t>(std::stoi(commandlineArguments["producers"]))};
+    }
+
+    uint32_t outOfOrder{0};
+    std::cout << "pipeline;producers;Mentries/s;latency (us);context switches/entry;retries when full;parked;out of order" << std::endl;
+    for (uint32_t producers : producerCounts) {
+        {
+            Consumer consumer{producers};
+            cluon::NotifyingPipeline<Entry> pipeline{[&consumer](Entry &&entry) { consumer(std::move(entry)); }};
+            // Like cluon::UDPReceiver: add, then notify the consumer.
+            const Result result{produce(producers, COUNT, BURST, PAUSE, consumer, [&pipeline](Entry &&entry) {
+                pipeline.add(std::move(entry));
+                pipeline.notifyAll();
+                return true;
+            })};
+            print("cluon::NotifyingPipeline", producers, COUNT, result, consumer, 0);
+            outOfOrder += consumer.m_outOfOrder;
+        }
+        {
+            Consumer consumer{producers};
+            MPSCPipeline<Entry> pipeline{[&consumer](Entry &&entry) { consumer(std::move(entry)); }, CAPACITY};
+            const Result result{produce(producers, COUNT, BURST, PAUSE, consumer, [&pipeline](Entry &&entry) { return pipeline.add(std::move(entry)); })};
+            print("MPSCPipeline", producers, COUNT, result, consumer, pipeline.parked());
+            outOfOrder += consumer.m_outOfOrder;
+        }
+    }
+    return (0 == outOfOrder) ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing and cluon::Player
+#include "cluon-complete.hpp"
+// Memory-mapped .rec files with a flat index
+#include "recording.hpp"
+
+// Library's
+#include <iostream>
+#include <map>
+#include <string>
+
+int32_t main(int32_t argc, char **argv)
+{
+    int32_t retCode{0};
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 == commandlineArguments.count("rec")) {
+        std::cerr << argv[0] << " indexes a .rec file and stores the index as <file>.idx for fast loading." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --rec=<file> [--no-index-file] [--compare-player]" << std::endl;
+        std::cerr << "         --rec:            recording to index" << std::endl;
+        std::cerr << "         --no-index-file:  neither load nor store <file>.idx" << std::endl;
+        std::cerr << "         --compare-player: also index the file with cluon::Player and compare both" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --rec=recordings/lap.rec" << std::endl;
+        return 1;
+    }
+    const std::string REC{commandlineArguments["rec"]};
+
+    const cluon::data::TimeStamp BEFORE{cluon::time::now()};
+    Recording recording{REC, 0 == commandlineArguments.count("no-index-file")};
+    const cluon::data::TimeStamp AFTER{cluon::time::now()};
+    if (!recording.valid()) {
+        std::cerr << argv[0] << ": " << REC << " contains no Envelopes." << std::endl;
+        return 1;
+    }
+
+    std::map<int32_t, uint32_t> entriesPerDataType;
+    for (const auto &entry : recording.index()) {
+        entriesPerDataType[entry.dataType]++;
+    }
+    std::cout << REC << ": " << recording.index().size() << " entries, index "
+              << (recording.indexFromFile() ? "loaded" : "built") << " in "
+              << cluon::time::deltaInMicroseconds(AFTER, BEFORE) / 1000.0 << " ms" << std::endl;
+    std::cout << "dataType;entries" << std::endl;
+    for (const auto &e : entriesPerDataType) {
+        std::cout << e.first << ";" << e.second << std::endl;
+    }
+
+    if (0 != commandlineArguments.count("compare-player")) {
+        const cluon::data::TimeStamp PLAYER_BEFORE{cluon::time::now()};
+        cluon::Player player{REC, false /* no rewind */, false /* no threading */};
+        const cluon::data::TimeStamp PLAYER_AFTER{cluon::time::now()};
+        std::cout << "cluon::Player: " << player.totalNumberOfEnvelopesInRecFile() << " entries, index built in "
+                  << cluon::time::deltaInMicroseconds(PLAYER_AFTER, PLAYER_BEFORE) / 1000.0 << " ms" << std::endl;
+
+        // Both indices must replay the same Envelopes in the same order.
+        uint32_t mismatches{0};
+        size_t i{0};
+        while (player.hasMoreData()) {
+            auto next = player.getNextEnvelopeToBeReplayed();
+            if (!next.first) {
+                continue;
+            }
+            EnvelopeView view;
+            if ((i >= recording.index().size()) ||
+                !recording.envelope(recording.index()[i], view) ||
+                (cluon::time::toMicroseconds(next.second.sampleTimeStamp()) != view.sampleTimeStamp) ||
+                (next.second.dataType() != view.dataType) ||
+                (next.second.senderStamp() != view.senderStamp) ||
+                (next.second.serializedData() != std::string(view.serializedData, view.serializedDataSize))) {
+                mismatches++;
+            }
+            i++;
+        }
+        mismatches += static_cast<uint32_t>((i > recording.index().size()) ? 0 : recording.index().size() - i);
+        std::cout << "Entries differing from cluon::Player: " << mismatches << std::endl;
+        retCode = (0 == mismatches) ? 0 : 1;
+    }
+    return retCode;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing and cluon::SharedMemory
+#include "cluon-complete.hpp"
+// Frame slots with sequence numbers
+#include "frame-ring.hpp"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Library's
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string NAME{"steering-ring-bench"};
+
+int64_t nowInNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// What the consumer process reports back through a pipe.
+struct ConsumerResult {
+    uint64_t processed{0};
+    uint64_t torn{0};       // Frames overwritten while being processed.
+    uint64_t corrupt{0};    // Frames with mixed contents that were not detected.
+};
+
+/**
+ * Works on a frame for work microseconds like the segmentation does on the
+ * crop zone; every byte of a frame carries its frame number, so a frame with
+ * different first and last bytes was overwritten meanwhile.
+ */
+bool process(const char *data, size_t size, uint32_t work)
+{
+    const int64_t until{nowInNanoseconds() + static_cast<int64_t>(work) * 1000};
+    volatile uint32_t sum{0};
+    for (size_t i = 0; nowInNanoseconds() < until; i = (i + 4096) % size) {
+        sum = sum + static_cast<uint8_t>(data[i]);
+    }
+    return data[0] == data[size - 1];
+}
+
+// Consumer process for the single frame: waits, locks and works on the frame in place.
+ConsumerResult consumeSingle(uint32_t count, size_t frameSize, uint32_t work)
+{
+    ConsumerResult result;
+    cluon::SharedMemory sharedMemory{NAME};
+    uint64_t last{0};
+    while (last < count) {
+        sharedMemory.wait();
+        sharedMemory.lock();
+        uint64_t frame{0};
+        std::memcpy(&frame, sharedMemory.data(), sizeof(frame));
+        if (frame != last) {
+            result.corrupt += process(sharedMemory.data() + sizeof(frame), frameSize, work) ? 0 : 1;
+            result.processed++;
+            last = frame;
+        }
+        sharedMemory.unlock();
+    }
+    return result;
+}
+
+// Consumer process for the ring: waits and works on the newest slot without locking.
+ConsumerResult consumeRing(uint32_t count, size_t frameSize, uint32_t work)
+{
+    ConsumerResult result;
+    cluon::SharedMemory sharedMemory{NAME};
+    FrameRing ring{sharedMemory};
+    uint64_t last{0};
+    while (ring.valid() && (last < count)) {
+        sharedMemory.wait();
+        FrameSlot slot;
+        if (ring.acquireLatest(slot) && (slot.frame != last)) {
+            const bool consistent{process(slot.data, std::min(slot.size, frameSize), work)};
+            if (!ring.stillValid(slot)) {
+                result.torn++;
+            } else {
+                result.corrupt += consistent ? 0 : 1;
+                result.processed++;
+            }
+            last = slot.frame;
+        }
+    }
+    return result;
+}
+
+struct ProducerResult {
+    std::vector<int64_t> writes{};    // Time per frame from starting to write to notifying.
+    ConsumerResult consumer{};
+};
+
+/**
+ * Produces frames every period microseconds while a consumer process works
+ * on them until it saw count frames.
+ */
+template <typename CONSUME, typename WRITE>
+ProducerResult produce(uint32_t count, uint32_t period, CONSUME consume, WRITE write)
+{
+    ProducerResult result;
+    int fds[2]{-1, -1};
+    if (0 != ::pipe(fds)) {
+        return result;
+    }
+    const pid_t consumer{::fork()};
+    if (0 == consumer) {
+        ::close(fds[0]);
+        const ConsumerResult consumed{consume()};
+        const ssize_t written{::write(fds[1], &consumed, sizeof(consumed))};
+        ::_exit((sizeof(consumed) == static_cast<size_t>(written)) ? 0 : 1);
+    }
+    ::close(fds[1]);
+    // The consumer needs a moment to attach.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (uint64_t frame = 1; 0 == ::waitpid(consumer, nullptr, WNOHANG); frame++) {
+        const int64_t before{nowInNanoseconds()};
+        write(frame);
+        if (frame <= count) {
+            result.writes.push_back(nowInNanoseconds() - before);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(period));
+    }
+    if (sizeof(result.consumer) != static_cast<size_t>(::read(fds[0], &result.consumer, sizeof(result.consumer)))) {
+        std::cerr << "No result from the consumer process." << std::endl;
+    }
+    ::close(fds[0]);
+    return result;
+}
+
+void print(const std::string &name, ProducerResult &result)
+{
+    std::sort(result.writes.begin(), result.writes.end());
+    const size_t n{result.writes.size()};
+    auto percentile = [&result, n](double p) {
+        return (0 < n) ? static_cast<double>(result.writes[std::min(n - 1, static_cast<size_t>(p * static_cast<double>(n)))]) / 1000.0 : 0.0;
+    };
+    std::cout << name << ";" << n << ";" << percentile(0.5) << ";" << percentile(0.99) << ";" << percentile(1.0) << ";"
+              << result.consumer.processed << ";" << result.consumer.torn << ";" << result.consumer.corrupt << std::endl;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char **argv)
+{
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " compares how long a producer process needs to write a frame while a consumer process works on frames: one frame behind SharedMemory::lock() against a FrameRing." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--width=<pixels>] [--height=<pixels>] [--count=<frames>] [--period=<us>] [--work=<us>] [--slots=<n>]" << std::endl;
+        std::cerr << "         --width, --height: frame geometry, 4 bytes per pixel (default: 640x480)" << std::endl;
+        std::cerr << "         --count:  frames to produce (default: 500)" << std::endl;
+        std::cerr << "         --period: microseconds between frames (default: 10000)" << std::endl;
+        std::cerr << "         --work:   microseconds the consumer works on a frame (default: 5000)" << std::endl;
+        std::cerr << "         --slots:  slots of the FrameRing (default: 3)" << std::endl;
+        return 1;
+    }
+    const uint32_t WIDTH{(0 != commandlineArguments.count("width")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["width"])) : 640};
+    const uint32_t HEIGHT{(0 != commandlineArguments.count("height")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["height"])) : 480};
+    const uint32_t COUNT{(0 != commandlineArguments.count("count")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["count"])) : 500};
+    const uint32_t PERIOD{(0 != commandlineArguments.count("period")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["period"])) : 10000};
+    const uint32_t WORK{(0 != commandlineArguments.count("work")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["work"])) : 5000};
+    const uint32_t SLOTS{(0 != commandlineArguments.count("slots")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["slots"])) : 3};
+    const size_t FRAME_SIZE{static_cast<size_t>(WIDTH) * HEIGHT * 4};
+
+    // cluon::SharedMemory logs every attach and detach.
+    std::clog.setstate(std::ios::failbit);
+    std::cout << "transport;frames;write p50 (us);write p99 (us);write max (us);processed;torn;corrupt" << std::endl;
+    {
+        // The frame number precedes the pixels.
+        cluon::SharedMemory sharedMemory{NAME, static_cast<uint32_t>(sizeof(uint64_t) + FRAME_SIZE)};
+        ProducerResult result{produce(
+            COUNT, PERIOD, [COUNT, FRAME_SIZE, WORK]() { return consumeSingle(COUNT, FRAME_SIZE, WORK); },
+            [&sharedMemory, FRAME_SIZE](uint64_t frame) {
+                sharedMemory.lock();
+                std::memcpy(sharedMemory.data(), &frame, sizeof(frame));
+                std::memset(sharedMemory.data() + sizeof(frame), static_cast<int>(frame & 0xFF), FRAME_SIZE);
+                sharedMemory.unlock();
+                sharedMemory.notifyAll();
+            })};
+        print("SharedMemory lock", result);
+    }
+    {
+        cluon::SharedMemory sharedMemory{NAME, static_cast<uint32_t>(FrameRing::size(SLOTS, static_cast<uint32_t>(FRAME_SIZE)))};
+        FrameRing ring{sharedMemory, SLOTS, static_cast<uint32_t>(FRAME_SIZE)};
+        ProducerResult result{produce(
+            COUNT, PERIOD, [COUNT, FRAME_SIZE, WORK]() { return consumeRing(COUNT, FRAME_SIZE, WORK); },
+            [&ring, FRAME_SIZE](uint64_t frame) {
+                std::memset(ring.beginWrite(), static_cast<int>(frame & 0xFF), FRAME_SIZE);
+                ring.endWrite(FRAME_SIZE, static_cast<int64_t>(frame));
+            })};
+        print("FrameRing " + std::to_string(SLOTS) + " slots", result);
+    }
+    return 0;
+}
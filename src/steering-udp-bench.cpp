@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing, UDPSender and UDPReceiver
+#include "cluon-complete.hpp"
+// Batched UDP receive with kernel time stamps
+#include "udp-batch-receiver.hpp"
+
+#include <sys/resource.h>
+
+// Library's
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Voluntary context switches of all threads but the calling one, i.e. the wake-ups of the receiving threads.
+int64_t contextSwitchesOfOtherThreads()
+{
+    struct rusage process {}, self {};
+    ::getrusage(RUSAGE_SELF, &process);
+    ::getrusage(RUSAGE_THREAD, &self);
+    return static_cast<int64_t>(process.ru_nvcsw) - static_cast<int64_t>(self.ru_nvcsw);
+}
+
+struct Result {
+    uint32_t received{0};
+    int64_t contextSwitches{0};
+    double latency{0};    // Mean time from sending to the delegate in microseconds.
+};
+
+// Sends count datagrams in bursts and waits until they arrived or the receiver stays idle for 200 ms.
+template <typename RECEIVED>
+Result sendBursts(cluon::UDPSender &sender, uint32_t count, uint32_t burst, uint32_t size, RECEIVED received, std::atomic<int64_t> &latencySum)
+{
+    Result result;
+    std::string payload(size, 'x');
+    const int64_t contextSwitchesBefore{contextSwitchesOfOtherThreads()};
+    for (uint32_t sent = 0; sent < count;) {
+        for (uint32_t i = 0; (i < burst) && (sent < count); i++, sent++) {
+            // The first bytes carry the sending time for the latency.
+            const int64_t now{cluon::time::toMicroseconds(cluon::time::now())};
+            payload.replace(0, sizeof(now), reinterpret_cast<const char *>(&now), sizeof(now));
+            sender.send(std::string(payload));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint32_t last{0};
+    for (uint32_t idle = 0; (received() < count) && (idle < 200); idle++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        idle = (received() != last) ? 0 : idle;
+        last = received();
+    }
+    result.contextSwitches = contextSwitchesOfOtherThreads() - contextSwitchesBefore;
+    result.received = received();
+    result.latency = (0 < result.received) ? static_cast<double>(latencySum.load()) / result.received : 0;
+    return result;
+}
+
+int64_t latencyOf(const char *data, size_t size)
+{
+    int64_t sent{0};
+    if (size >= sizeof(sent)) {
+        std::memcpy(&sent, data, sizeof(sent));
+    }
+    return cluon::time::toMicroseconds(cluon::time::now()) - sent;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char **argv)
+{
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " compares cluon::UDPReceiver with UDPBatchReceiver for bursts of datagrams over loopback multicast." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--cid=<OD4 session>] [--count=<datagrams>] [--burst=<datagrams>] [--size=<bytes>] [--batch=<datagrams>] [--coalescing=<us>]" << std::endl;
+        std::cerr << "         --cid:   multicast group 225.0.0.<cid> to use (default: 250)" << std::endl;
+        std::cerr << "         --count: datagrams to send per receiver (default: 100000)" << std::endl;
+        std::cerr << "         --burst: datagrams sent back to back before pausing 1 ms (default: 64)" << std::endl;
+        std::cerr << "         --size:  bytes per datagram (default: 32, about a GroundSteeringRequest)" << std::endl;
+        std::cerr << "         --batch: datagrams per recvmmsg call (default: 32)" << std::endl;
+        std::cerr << "         --coalescing: microseconds to let a burst arrive after a partial batch (default: 100)" << std::endl;
+        return 1;
+    }
+    const std::string ADDRESS{"225.0.0." + ((0 != commandlineArguments.count("cid")) ? commandlineArguments["cid"] : std::string("250"))};
+    const uint16_t PORT{12175};
+    const uint32_t COUNT{(0 != commandlineArguments.count("count")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["count"])) : 100000};
+    const uint32_t BURST{(0 != commandlineArguments.count("burst")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["burst"])) : 64};
+    const uint32_t SIZE{(0 != commandlineArguments.count("size")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["size"])) : 32};
+    const uint32_t BATCH{(0 != commandlineArguments.count("batch")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["batch"])) : 32};
+    const std::chrono::microseconds COALESCING{(0 != commandlineArguments.count("coalescing")) ? std::stoi(commandlineArguments["coalescing"]) : 100};
+
+    cluon::UDPSender sender{ADDRESS, PORT};
+    std::cout << "receiver;datagrams;received;context switches;context switches/datagram;recvmmsg calls;datagrams/call;latency (us)" << std::endl;
+
+    {
+        std::atomic<uint32_t> received{0};
+        std::atomic<int64_t> latencySum{0};
+        cluon::UDPReceiver receiver{ADDRESS, PORT, [&received, &latencySum](std::string &&data, std::string &&, std::chrono::system_clock::time_point &&) {
+                                        latencySum += latencyOf(data.data(), data.size());
+                                        received++;
+                                    }};
+        const Result result{sendBursts(sender, COUNT, BURST, SIZE, [&received]() { return received.load(); }, latencySum)};
+        std::cout << "cluon::UDPReceiver;" << COUNT << ";" << result.received << ";" << result.contextSwitches << ";"
+                  << static_cast<double>(result.contextSwitches) / std::max<uint32_t>(result.received, 1) << ";-;-;" << result.latency << std::endl;
+    }
+    {
+        std::atomic<uint32_t> received{0};
+        std::atomic<int64_t> latencySum{0};
+        UDPBatchReceiver receiver{ADDRESS, PORT, [&received, &latencySum](const UDPDatagram &datagram) {
+                                      latencySum += latencyOf(datagram.data, datagram.size);
+                                      received++;
+                                  },
+                                  0, BATCH, COALESCING};
+        const UDPReceiveStatistics before{receiver.statistics()};
+        const Result result{sendBursts(sender, COUNT, BURST, SIZE, [&received]() { return received.load(); }, latencySum)};
+        const UDPReceiveStatistics after{receiver.statistics()};
+        const uint64_t batches{after.batches - before.batches};
+        std::cout << "UDPBatchReceiver;" << COUNT << ";" << result.received << ";" << result.contextSwitches << ";"
+                  << static_cast<double>(result.contextSwitches) / std::max<uint32_t>(result.received, 1) << ";"
+                  << (after.syscalls - before.syscalls) << ";" << static_cast<double>(after.datagrams - before.datagrams) / std::max<uint64_t>(batches, 1) << ";"
+                  << result.latency << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line parsing and cluon::SharedMemory
+#include "cluon-complete.hpp"
+// Event loop and the bridge of frame notifications to it, as used by the microservice
+#include "event-loop.hpp"
+#include "frame-notifier.hpp"
+// Futex generation counter
+#include "frame-signal.hpp"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Library's
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// What the producer writes into the shared memory before notifying.
+struct Stamp {
+    int64_t notified{0};    // steady_clock in nanoseconds; the same clock in every process.
+    uint32_t sequence{0};
+};
+
+const std::string NAME{"steering-wakeup-bench"};
+
+int64_t nowInNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Producer process: writes a stamp every period and notifies through the
+ * shared memory or the signal until it is terminated; stamps past count
+ * only release a consumer that missed the last frame.
+ */
+void produce(bool useSignal, uint32_t period)
+{
+    cluon::SharedMemory sharedMemory{NAME};
+    FrameSignal signal{NAME, false};
+    for (uint32_t sequence = 1;; sequence++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(period));
+        sharedMemory.lock();
+        Stamp *stamp{reinterpret_cast<Stamp *>(sharedMemory.data())};
+        stamp->sequence = sequence;
+        stamp->notified = nowInNanoseconds();
+        sharedMemory.unlock();
+        if (useSignal) {
+            signal.notifyAll();
+        } else {
+            sharedMemory.notifyAll();
+        }
+    }
+}
+
+struct Result {
+    std::vector<int64_t> latencies{};
+    uint32_t missed{0};
+    uint64_t spun{0};
+    uint64_t slept{0};
+};
+
+/**
+ * Consumer: waits for count frames the way the microservice does, through a
+ * FrameNotifier and an EventLoop, and measures the time from notifying to the
+ * frame's callback on the thread of the loop.
+ */
+Result consume(cluon::SharedMemory &sharedMemory, FrameSignal *signal, uint32_t count)
+{
+    Result result;
+    result.latencies.reserve(count);
+    uint32_t lastSequence{0};
+    EventLoop loop;
+    {
+        FrameNotifier frames{sharedMemory, signal};
+        loop.addReadable(frames.fd(), [&]() {
+            if (0 == frames.acknowledge()) {
+                return;
+            }
+            const int64_t woken{nowInNanoseconds()};
+            sharedMemory.lock();
+            const Stamp stamp{*reinterpret_cast<Stamp *>(sharedMemory.data())};
+            sharedMemory.unlock();
+            if (stamp.sequence <= lastSequence) {
+                return;
+            }
+            result.missed += stamp.sequence - lastSequence - 1;
+            lastSequence = stamp.sequence;
+            result.latencies.push_back(woken - stamp.notified);
+            if (lastSequence >= count) {
+                loop.stop();
+            }
+        });
+        loop.run();
+    }
+    // The counters belong to the bridge thread, which has ended with the notifier.
+    if (nullptr != signal) {
+        result.spun = signal->spun();
+        result.slept = signal->slept();
+    }
+    return result;
+}
+
+void print(const std::string &name, Result &result)
+{
+    std::sort(result.latencies.begin(), result.latencies.end());
+    const size_t n{result.latencies.size()};
+    double mean{0};
+    for (int64_t latency : result.latencies) {
+        mean += static_cast<double>(latency) / 1000.0;
+    }
+    mean /= static_cast<double>(std::max<size_t>(n, 1));
+    auto percentile = [&result, n](double p) {
+        return (0 < n) ? static_cast<double>(result.latencies[std::min(n - 1, static_cast<size_t>(p * static_cast<double>(n)))]) / 1000.0 : 0.0;
+    };
+    std::cout << name << ";" << n << ";" << mean << ";" << percentile(0.5) << ";" << percentile(0.99) << ";"
+              << ((0 < n) ? static_cast<double>(result.latencies[n - 1]) / 1000.0 : 0.0) << ";" << result.missed << ";"
+              << result.spun << ";" << result.slept << std::endl;
+}
+
+// Runs the producer in a child process for one notification mechanism.
+Result run(bool posix, bool useSignal, uint32_t spins, uint32_t count, uint32_t period)
+{
+    ::setenv("CLUON_SHAREDMEMORY_POSIX", posix ? "1" : "0", 1);
+    cluon::SharedMemory sharedMemory{NAME, sizeof(Stamp)};
+    FrameSignal signal{NAME, true, spins};
+    const pid_t producer{::fork()};
+    if (0 == producer) {
+        produce(useSignal, period);
+        ::_exit(0);
+    }
+    Result result{consume(sharedMemory, useSignal ? &signal : nullptr, count)};
+    ::kill(producer, SIGKILL);
+    ::waitpid(producer, nullptr, 0);
+    return result;
+}
+
+} // namespace
+
+int32_t main(int32_t argc, char **argv)
+{
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help")) {
+        std::cerr << argv[0] << " measures the wake-up latency from a producer process notifying a new frame to the consumer's event loop calling back for it." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--count=<frames>] [--period=<us>] [--spins=<polls>]" << std::endl;
+        std::cerr << "         --count:  frames per mechanism (default: 2000)" << std::endl;
+        std::cerr << "         --period: microseconds between frames (default: 1000)" << std::endl;
+        std::cerr << "         --spins:  polls of the generation counter before sleeping (default: 4000)" << std::endl;
+        return 1;
+    }
+    const uint32_t COUNT{(0 != commandlineArguments.count("count")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["count"])) : 2000};
+    const uint32_t PERIOD{(0 != commandlineArguments.count("period")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["period"])) : 1000};
+    const uint32_t SPINS{(0 != commandlineArguments.count("spins")) ? static_cast<uint32_t>(std::stoi(commandlineArguments["spins"])) : 4000};
+
+    // cluon::SharedMemory logs every attach and detach.
+    std::clog.setstate(std::ios::failbit);
+    std::cout << "mechanism;frames;mean (us);p50 (us);p99 (us);max (us);missed;spun;slept" << std::endl;
+    {
+        Result result{run(false, false, 0, COUNT, PERIOD)};
+        print("SharedMemory SysV semop", result);
+    }
+    {
+        Result result{run(true, false, 0, COUNT, PERIOD)};
+        print("SharedMemory POSIX pthread_cond", result);
+    }
+    {
+        Result result{run(true, true, 0, COUNT, PERIOD)};
+        print("FrameSignal futex", result);
+    }
+    // FrameSignal does not spin on single core machines.
+    if (1 < std::thread::hardware_concurrency()) {
+        Result result{run(true, true, SPINS, COUNT, PERIOD)};
+        print("FrameSignal spin+futex", result);
+    }
+    return 0;
+}
@@ -19,6 +19,31 @@
 #include "cluon-complete.hpp"
 // Include the OpenDLV Standard Message Set that contains messages that are usually exchanged for automotive or robotic applications
 #include "opendlv-standard-message-set.hpp"
+// Cone detection and steering logic shared with the benchmark
+#include "cone-detection.hpp"
+// Blur, HSV conversion and thresholding of the crop zone
+#include "segmentation.hpp"
+#include "incremental-segmentation.hpp"
+#include "cone-bands.hpp"
+// OD4 session and message decoding without intermediate copies
+#include "od4-view-session.hpp"
+#include "proto-view.hpp"
+// Single-threaded waiting on frames, datagrams and timers
+#include "event-loop.hpp"
+#include "frame-notifier.hpp"
+#include "frame-signal.hpp"
+#include "frame-ring.hpp"
+#include "frame-sidecar.hpp"
+// Huge page and NUMA-local scratch buffers
+#include "scratch-arena.hpp"
+// Detected cones as opendlv.logic.perception messages, located on the ground
+#include "ground-projection.hpp"
+#include "perception-objects.hpp"
+// Path through gates of blue and yellow cones
+#include "centreline-planner.hpp"
+// Recording of the consumed inputs and their replay
+#include "recorder.hpp"
+#include "replay-decoder.hpp"
 
 // Include the GUI and image processing header files from OpenCV
 #include <opencv2/highgui/highgui.hpp>
@@ -28,326 +53,250 @@
 #include <string>
 #include <sstream>
 #include <ctime>
+#include <cstring>
 #include <algorithm>
+#include <vector>
 
-// Color thresholds
-cv::Scalar yellowLow = cv::Scalar(17, 89, 128);
-cv::Scalar yellowHigh = cv::Scalar(35, 175, 216);
-// cv::Scalar blueLow = cv::Scalar(109, 96, 27);
-// cv::Scalar blueHigh = cv::Scalar(120, 189, 86);
-cv::Scalar blueLow = cv::Scalar(70, 43, 34);
-cv::Scalar blueHigh = cv::Scalar(120, 255, 255);
-
-int hLow = 0, hHigh = 179, sLow = 0, sHigh = 255, vLow = 0, vHigh = 255;
-
-// Constants
-const double MAX_ANGLE = 0.290888;                      // Max steering angle for car
-const double ANGLE_MARGIN = MAX_ANGLE * 0.05;           // Angle margin
-const double TURN_VAL =  0.12316760378897237;           // Turning value found through linear regression
-const int DIST_THRESHOLD = 32;                          // Threshold for distances from cone pos to car
-
-// Vector of vectors to store points of the 'cones' in HSV filter img.
-std::vector<std::vector<cv::Point>> blueContours;
-std::vector<std::vector<cv::Point>> yellowContours;
-cv::Point centerPoint, blueCone, yellowCone, blueConePrev, yellowConePrev;
-
-// Variables
-double groundSteeringRequest = 0.0;
-double average = 0.0;
-double steeringAngle = 0.0;
-double correct = 0.0, total = 0.0, ourLeft = 0, hisLeft = 0, ourRight = 0, hisRight = 0, avgLeft = 0.0, avgRight = 0.0;
-bool blueInFrame = false, yellowInFrame = false;
-bool foundBlueConeOnce = false, foundYellowConeOnce = false, blueOnLeft = false, yellowOnLeft = false;
-
-// Calculates the average accuracy of our steering angle
-double steeringAccuracy()
-{
-    // Check if the steering is outside of the 50% margin
-    if (!(steeringAngle < groundSteeringRequest * 0.5 || steeringAngle > groundSteeringRequest * 1.5))
-    {
-        correct++;
-    }
-    if (steeringAngle > 0) {
-        ourLeft++;
-    } else if (steeringAngle < 0) {
-        ourRight++;
-    }
-    if (groundSteeringRequest > 0) {
-        hisLeft++;
-    } else if (groundSteeringRequest < 0) {
-        hisRight++;
-    }
-    total++;
-    average = (correct / total) * 100;
-    avgLeft = (ourLeft / hisLeft) * 100;
-    avgRight = (ourRight / hisRight) * 100;
-    return average;
-}
-
-// Returns distance of object (from center)
-double getDistance(cv::Point pos1, cv::Point pos2)
-{           
-    return sqrt(pow(pos2.x - pos1.x, 2) + pow(pos2.y - pos1.y, 2));
-}
-
-// 1 left, -1 for right
-bool steer(std::string dir, double intensity)
-{
-    int a = dir == "Left" ? 1 : -1;
-    switch (a)
-    {
-    case -1:
-        // Check if we had been turning left, if so reset angle to 0
-        if (steeringAngle > 0)
-        {
-            steeringAngle = 0;
-        }
-        break;
-    case 1:
-        // Check if we had been turning right, if so reset angle to 0
-        if (steeringAngle < 0)
-        {
-            steeringAngle = 0;
-        }
-        break;
-    default:
-        return false;
-    }
-    steeringAngle = a * TURN_VAL * (1 + intensity);
-    if (steeringAngle <= -MAX_ANGLE) {
-        steeringAngle = -MAX_ANGLE;
-    } else if (steeringAngle >= MAX_ANGLE) {
-        steeringAngle = MAX_ANGLE;
-    }
-    return true;
-}
-
-double trackCones()
-{
-    // If both are in frame return 0
-    if (blueInFrame && yellowInFrame) {
-        steeringAngle = 0;
-    } else {
-        double intensity;
-        // If yellow is on the left side
-        // Car is turning clockwise
-        if (yellowOnLeft) {
-            // If only yellow in frame
-            if (yellowInFrame) {
-                intensity = (yellowCone.x / centerPoint.x);
-                // Car is turning counterclockwise
-                if (yellowCone.x > yellowConePrev.x) {
-                    steer("Right", intensity);
-                } else {
-                    steeringAngle = 0;
-                }
-            }
-            else {
-                // This is where more logic is needed
-                // TODO: This is where more logic is needed
-                if (blueInFrame) {
-                    intensity = (centerPoint.x / blueCone.x);
-                    if (blueCone.y == blueConePrev.y) {
-                        // The car has not moved
-                        steeringAngle = 0;
-                    } else if (blueCone.y < blueConePrev.y) {
-                        // New cone targeted
-                    } else {
-                        // Current targeted cone moving closer
-                        steer("Left", intensity);
-                    }
-                }
-            }
-        // If blue is on the left side
-        // Car is turning clockwise
-        } else if (blueOnLeft) {
-            // If only blue in frame
-            if (blueInFrame) {
-                intensity = (blueCone.x / centerPoint.x);
-                if (blueCone.x > blueConePrev.x) {
-                    steer("Right", intensity);
-                } else {
-                    steeringAngle = 0;
-                }
-            } else {
-                // Car is turning counterclockwise
-                // TODO: This is where more logic is needed
-                if (yellowInFrame) {
-                    intensity = (centerPoint.x / yellowCone.x);
-                    if (yellowCone.y == yellowConePrev.y) {
-                        // The car has not moved
-                        steeringAngle = 0;
-                    } else if (yellowCone.y < yellowConePrev.y) {
-                        // New cone targeted
-                    } else {
-                        // Current targeted cone moving closer
-                        steer("Left", intensity);
-                    }
-                }
-            }
-        // If none are in frame return 0
-        } else {
-            steeringAngle = 0;
-        }
-    }
-    // Update prev cone pos's
-    blueConePrev = blueCone;
-    yellowConePrev = yellowCone;
-    // std::cout << steeringAngle
-    //         << ";" << groundSteeringRequest
-    //         << std::endl;
-    steeringAccuracy();
-    return steeringAngle;
-}
-
-// Method for filtering and creating rectangle around BLUE cones
-bool getBlueCones(cv::Mat detectImage, cv::Mat drawImage, cv::Scalar color)
-{
-    blueInFrame = false;
-    cv::Rect prevBox(cv::Point(0, 0), cv::Size(0, 0));
-    cv::findContours(detectImage, blueContours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point());
-    if (blueContours.size() > 0)
-    {
-        blueInFrame = true;
-        for (size_t i = 0; i < blueContours.size(); i++)
-        {
-            cv::Rect bBox = cv::boundingRect(blueContours[i]);
-            // Add some restriction to rectangle size to avoid
-            // duplicate 2x2 rectangles appearing on the same cone
-            if (bBox.area() > 50)
-            {
-                // Only draw a new rect at the closest (bottom-most) cone
-                if (bBox.y > prevBox.y)
-                {
-                    cv::rectangle(drawImage, bBox.tl(), bBox.br(), color, 2);
-                    cv::putText(
-                        drawImage,
-                        "(" + std::to_string(bBox.x + (bBox.width / 2)) +
-                            "," + std::to_string(bBox.y + (bBox.height / 2)) + ")",
-                        cv::Point(bBox.x, bBox.y - 25),
-                        5, 1,
-                        cv::Scalar(0, 0, 255), 1);
-                }
-                prevBox = bBox;
-            }
-        }
-        blueCone = cv::Point(prevBox.x + prevBox.width / 2, prevBox.y + prevBox.height / 2);
-        if(!foundBlueConeOnce) {
-            foundBlueConeOnce = true;
-            blueConePrev = blueCone;
-            if (blueCone.x < centerPoint.x) {
-                blueOnLeft = true;
-                yellowOnLeft = false;
-            }
-        }
-        return true;
-    }
-    return false;
-}
-
-// Method for filtering and creating rectangle around YELLOW cones
-bool getYellowCones(cv::Mat detectImage, cv::Mat drawImage, cv::Scalar color)
-{
-    yellowInFrame = false;
-    cv::Rect prevBox(cv::Point(0, 0), cv::Size(0, 0));
-    cv::findContours(detectImage, yellowContours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE, cv::Point());
-    if (yellowContours.size() > 0)
-    {
-        yellowInFrame = true;
-        for (size_t i = 0; i < yellowContours.size(); i++)
-        {
-            cv::Rect bBox = cv::boundingRect(yellowContours[i]);
-            // Add some restriction to rectangle size to avoid
-            // duplicate 2x2 rectangles appearing on the same cone
-            if (bBox.area() > 30)
-            {
-                // Only draw a new rect at the closest (bottom-most) cone
-                if (bBox.y > prevBox.y)
-                {
-                    cv::rectangle(drawImage, bBox.tl(), bBox.br(), color, 2);
-                    cv::putText(
-                        drawImage,
-                        "(" + std::to_string(bBox.x + (bBox.width / 2)) +
-                            "," + std::to_string(bBox.y + (bBox.height / 2)) + ")",
-                        cv::Point(bBox.x, bBox.y - 25),
-                        5, 1,
-                        cv::Scalar(0, 0, 255), 1);
-                }
-                prevBox = bBox;
-            }
-        }
-        yellowCone = cv::Point(prevBox.x + prevBox.width / 2, prevBox.y + prevBox.height / 2);
-        if(!foundYellowConeOnce) {
-            foundYellowConeOnce = true;
-            yellowConePrev = yellowCone;
-            if (yellowCone.x < centerPoint.x) {
-                blueOnLeft = false;
-                yellowOnLeft = true;
-            }
-        }
-        return true;
-    }
-    return false;
-}
+#include <unistd.h>
 
 int32_t main(int32_t argc, char **argv)
 {
     int32_t retCode{1};
     // Parse the command line parameters as we require the user to specify some mandatory information on startup.
     auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-    if ((0 == commandlineArguments.count("cid")) ||
-        (0 == commandlineArguments.count("name")) ||
+    if (((0 == commandlineArguments.count("cid")) && (0 == commandlineArguments.count("replay"))) ||
+        ((0 == commandlineArguments.count("name")) && (0 == commandlineArguments.count("replay"))) ||
         (0 == commandlineArguments.count("width")) ||
         (0 == commandlineArguments.count("height")))
     {
         std::cerr << argv[0] << " attaches to a shared memory area containing an ARGB image." << std::endl;
-        std::cerr << "Usage:   " << argv[0] << " --cid=<OD4 session> --name=<name of shared memory area> [--verbose]" << std::endl;
-        std::cerr << "         --cid:    CID of the OD4Session to send and receive messages" << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --cid=<OD4 session> --name=<name of shared memory area> [--force-isa=<isa>] [--incremental|--bit-masks|--projections] [--ring] [--huge-pages] [--numa-local] [--fov=<degrees>|--intrinsics=<fx,fy,cx,cy>] [--camera-height=<m>] [--camera-pitch=<degrees>] [--planner [--wheelbase=<m>] [--look-ahead=<m>] [--preview=<m>]] [--record=<file.rec> [--record-codec=png|jpeg|lz4] [--record-encoders=<n>]|--replay=<file.rec> [--replay-workers=<n>]] [--verbose]" << std::endl;
+        std::cerr << "         --cid:    CID of the OD4Session to send and receive messages; not used by --replay" << std::endl;
         std::cerr << "         --name:   name of the shared memory area to attach" << std::endl;
-        std::cerr << "         --width:  width of the frame" << std::endl;
-        std::cerr << "         --height: height of the frame" << std::endl;
+        std::cerr << "         --width:  width of the frame; checked against the producer's frame metadata if it publishes any" << std::endl;
+        std::cerr << "         --height: height of the frame; checked likewise" << std::endl;
+        std::cerr << "         --force-isa: instruction set of the segmentation kernels (e.g. scalar, sse2, avx2, neon); the best one if omitted" << std::endl;
+        std::cerr << "         --incremental: only segment the tiles of the crop zone that changed since the previous frame" << std::endl;
+        std::cerr << "         --bit-masks: segment into masks with one bit per pixel and find the cones with bit scans instead of contours" << std::endl;
+        std::cerr << "         --projections: like --bit-masks, but find the cones from the row and column projections of the masks if they are unambiguous" << std::endl;
+        std::cerr << "         --ring:   the shared memory area holds a FrameRing with several frame slots instead of a single frame" << std::endl;
+        std::cerr << "         --huge-pages: back the scratch buffers with huge pages and advise them for the shared memory" << std::endl;
+        std::cerr << "         --numa-local: allocate the scratch buffers on the NUMA node the microservice starts on (pin it with taskset/numactl)" << std::endl;
+        std::cerr << "         --fov:    horizontal field of view of the camera for the directions of the detected cones (default: 62.2)" << std::endl;
+        std::cerr << "         --intrinsics: focal lengths and principal point of the camera in pixels instead of --fov" << std::endl;
+        std::cerr << "         --camera-height: height of the camera above the ground for the distances of the detected cones (default: 0.1)" << std::endl;
+        std::cerr << "         --camera-pitch:  angle the camera is tilted downwards (default: 0)" << std::endl;
+        std::cerr << "         --planner:    steer along a centreline fitted through gates of blue and yellow cones (pure pursuit)" << std::endl;
+        std::cerr << "         --wheelbase:  distance between the axles for pure pursuit (default: 0.12)" << std::endl;
+        std::cerr << "         --look-ahead: distance of the aim point on the centreline (default: 0.6)" << std::endl;
+        std::cerr << "         --preview:    distance of the preview point on the centreline (default: 1.0)" << std::endl;
+        std::cerr << "         --record: record the consumed frames and messages and the computed steering angles into a .rec file" << std::endl;
+        std::cerr << "         --record-codec: compression of the recorded frames; png and lz4 are lossless, jpeg is smallest (default: png)" << std::endl;
+        std::cerr << "         --record-encoders: threads that compress the recorded frames (default: 2)" << std::endl;
+        std::cerr << "         --replay: process a recording of --record instead of the shared memory and the OD4 session and compare the steering angles; nothing is sent" << std::endl;
+        std::cerr << "         --replay-workers: threads that decode the frames of the replay ahead of the pipeline (default: one per core)" << std::endl;
         std::cerr << "Example: " << argv[0] << " --cid=253 --name=img --width=640 --height=480 --verbose" << std::endl;
     }
     else
     {
         // Extract the values from the command line parameters
-        const std::string NAME{commandlineArguments["name"]};
+        const std::string REPLAY{(0 != commandlineArguments.count("replay")) ? commandlineArguments["replay"] : ""};
+        // A replay writes the recorded frames into a shared memory area of its own.
+        const std::string NAME{REPLAY.empty() ? commandlineArguments["name"] : "steering-replay-" + std::to_string(::getpid())};
         const uint32_t WIDTH{static_cast<uint32_t>(std::stoi(commandlineArguments["width"]))};
         const uint32_t HEIGHT{static_cast<uint32_t>(std::stoi(commandlineArguments["height"]))};
         const bool VERBOSE{commandlineArguments.count("verbose") != 0};
+        const bool INCREMENTAL{commandlineArguments.count("incremental") != 0};
+        const bool PROJECTIONS{commandlineArguments.count("projections") != 0};
+        const bool BIT_MASKS{(commandlineArguments.count("bit-masks") != 0) || PROJECTIONS};
+        const bool RING{(commandlineArguments.count("ring") != 0) && REPLAY.empty()};
+        const bool HUGE_PAGES{commandlineArguments.count("huge-pages") != 0};
+        const bool NUMA_LOCAL{commandlineArguments.count("numa-local") != 0};
+        const float FOV{(0 != commandlineArguments.count("fov")) ? std::stof(commandlineArguments["fov"]) : 62.2f};
+        const float CAMERA_HEIGHT{(0 != commandlineArguments.count("camera-height")) ? std::stof(commandlineArguments["camera-height"]) : 0.1f};
+        const float CAMERA_PITCH{(0 != commandlineArguments.count("camera-pitch")) ? std::stof(commandlineArguments["camera-pitch"]) : 0.0f};
+        const bool PLANNER{commandlineArguments.count("planner") != 0};
+        const float WHEELBASE{(0 != commandlineArguments.count("wheelbase")) ? std::stof(commandlineArguments["wheelbase"]) : 0.12f};
+        const float LOOK_AHEAD{(0 != commandlineArguments.count("look-ahead")) ? std::stof(commandlineArguments["look-ahead"]) : 0.6f};
+        const float PREVIEW{(0 != commandlineArguments.count("preview")) ? std::stof(commandlineArguments["preview"]) : 1.0f};
+        FrameCodec recordCodec{FrameCodec::PNG};
+        if ((0 != commandlineArguments.count("record-codec")) && !parseFrameCodec(commandlineArguments["record-codec"], recordCodec))
+        {
+            std::cerr << argv[0] << ": Unknown codec '" << commandlineArguments["record-codec"] << "'; choose one of png, jpeg, lz4." << std::endl;
+            return retCode;
+        }
+        const uint32_t RECORD_ENCODERS{static_cast<uint32_t>((0 != commandlineArguments.count("record-encoders")) ? std::stoi(commandlineArguments["record-encoders"]) : 2)};
+        const uint32_t REPLAY_WORKERS{static_cast<uint32_t>((0 != commandlineArguments.count("replay-workers")) ? std::stoi(commandlineArguments["replay-workers"]) : 0)};
+        const std::string ISA{(0 != commandlineArguments.count("force-isa")) ? commandlineArguments["force-isa"] : ""};
+        const std::vector<std::string> ISAS{availableIsas()};
+        if (!ISA.empty() && (ISAS.end() == std::find(ISAS.begin(), ISAS.end(), ISA)))
+        {
+            std::cerr << argv[0] << ": Instruction set '" << ISA << "' is not available; choose one of:";
+            for (const auto &isa : ISAS)
+            {
+                std::cerr << " " << isa;
+            }
+            std::cerr << std::endl;
+            return retCode;
+        }
 
         // Attach to the shared memory.
-        std::unique_ptr<cluon::SharedMemory> sharedMemory{new cluon::SharedMemory{NAME}};
+        std::unique_ptr<cluon::SharedMemory> sharedMemory{REPLAY.empty() ? new cluon::SharedMemory{NAME} : new cluon::SharedMemory{NAME, WIDTH * HEIGHT * 4}};
         if (sharedMemory && sharedMemory->valid())
         {
             std::clog << argv[0] << ": Attached to shared memory '" << sharedMemory->name() << " (" << sharedMemory->size() << " bytes)." << std::endl;
 
+            // Frames in the slots of a ring are read without locking the shared memory.
+            std::unique_ptr<FrameRing> ring;
+            uint64_t lastRingFrame{0}, tornFrames{0};
+            if (RING)
+            {
+                ring.reset(new FrameRing{*sharedMemory});
+                if (!ring->valid() || (ring->slotSize() < WIDTH * HEIGHT * 4))
+                {
+                    std::cerr << argv[0] << ": Shared memory '" << sharedMemory->name() << "' holds no frame ring for " << WIDTH << "x" << HEIGHT << " frames." << std::endl;
+                    return retCode;
+                }
+                std::clog << argv[0] << ": Reading frames from a ring of " << ring->slots() << " slots." << std::endl;
+            }
+
+            // Producers that publish frame metadata get their geometry checked and their frames counted.
+            FrameSidecar sidecar{NAME, false};
+            FrameStatistics frameStatistics;
+            uint64_t rejectedFrames{0};
+            auto geometryMatches = [&](const FrameMetadata &metadata) {
+                return (metadata.width == WIDTH) && (metadata.height == HEIGHT) && (4 == metadata.bytesPerPixel) &&
+                       (metadata.size <= sharedMemory->size()) && (WIDTH * HEIGHT * 4 <= metadata.size);
+            };
+            FrameMetadata metadata;
+            if (sidecar.read(metadata))
+            {
+                if (!geometryMatches(metadata))
+                {
+                    std::cerr << argv[0] << ": The producer publishes " << metadata.width << "x" << metadata.height << " frames with " << metadata.bytesPerPixel
+                              << " bytes per pixel in " << metadata.size << " bytes, but " << WIDTH << "x" << HEIGHT << " frames with 4 bytes per pixel were given." << std::endl;
+                    return retCode;
+                }
+                std::clog << argv[0] << ": Frame geometry confirmed by '" << sidecar.name() << "'." << std::endl;
+            }
+
+            // Frames, OD4 datagrams and timers are all waited for on this thread.
+            EventLoop loop;
+
             // Interface to a running OpenDaVINCI session where network messages are exchanged.
-            // The instance od4 allows you to send and receive messages.
-            cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+            // The instance od4 allows you to send and receive messages; they arrive through the loop.
+            // A replay stays off the network so that old detections never reach a running car.
+            std::unique_ptr<OD4ViewSession> od4{REPLAY.empty() ? new OD4ViewSession{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"])), &loop} : nullptr};
 
             opendlv::proxy::GroundSteeringRequest gsr;
             std::mutex gsrMutex;
-            auto onGroundSteeringRequest = [&gsr, &gsrMutex](cluon::data::Envelope &&env) {
-                // The envelope data structure provide further details, such as sampleTimePoint as shown in this test case:
-                // https://github.com/chrberger/libcluon/blob/master/libcluon/testsuites/TestEnvelopeConverter.cpp#L31-L40
-                std::lock_guard<std::mutex> lck(gsrMutex);
-                gsr = cluon::extractMessage<opendlv::proxy::GroundSteeringRequest>(std::move(env));
+            std::unique_ptr<Recorder> recorder;
+            auto onGroundSteeringRequest = [&gsr, &gsrMutex, &recorder](const EnvelopeView &env) {
+                if (recorder)
+                {
+                    recorder->add(env);
+                }
+                // The envelope view provides further details, such as sampleTimeStamp in microseconds.
+                // The payload is decoded straight from the received datagram.
+                opendlv::proxy::GroundSteeringRequest request;
+                if (decodeMessage(env, request))
+                {
+                    std::lock_guard<std::mutex> lck(gsrMutex);
+                    gsr = request;
+                }
                 // std::cout << "groundSteering = " << gsr.groundSteering() << std::endl;
-            }; 
+            };
 
-            od4.dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), onGroundSteeringRequest);
+            // A replay only consumes the recorded messages.
+            if (od4)
+            {
+                od4->dataTrigger(opendlv::proxy::GroundSteeringRequest::ID(), onGroundSteeringRequest);
+            }
 
             // Crop zone for image
-            cv::Rect roi(
-                0,             // x pos
-                HEIGHT / 2,    // y pos
-                WIDTH - 1,     // rect width
-                (HEIGHT / 5)); // rect height
+            cv::Rect roi{cropZone(static_cast<int>(WIDTH), static_cast<int>(HEIGHT))};
 
             // OpenCV data structure to hold an image.
-            cv::Mat img, imgFrame, imgBlur, imgHSV, frameHSV, frameCropped, hsvDebug;
+            cv::Mat img, imgBlur, imgHSV, blueMask, yellowMask, frameCropped, hsvDebug;
             centerPoint = cv::Point(WIDTH / 2, roi.height);
+            // The frame buffer and the masks are mapped once, optionally on huge pages and on this NUMA node;
+            // OpenCV keeps using them as long as size and type stay the same.
+            const size_t maskSize{static_cast<size_t>(roi.width) * static_cast<size_t>(roi.height)};
+            ScratchArena arena{HEIGHT * WIDTH * 4 + 2 * maskSize + 3 * 64, HUGE_PAGES, NUMA_LOCAL};
+            if (!arena.valid())
+            {
+                return retCode;
+            }
+            // The frame is only copied for the debug window; otherwise the cone markers are drawn into this (zeroed) buffer.
+            img = cv::Mat(HEIGHT, WIDTH, CV_8UC4, arena.allocate(HEIGHT * WIDTH * 4));
+            blueMask = cv::Mat(roi.height, roi.width, CV_8UC1, arena.allocate(maskSize));
+            yellowMask = cv::Mat(roi.height, roi.width, CV_8UC1, arena.allocate(maskSize));
+            std::clog << argv[0] << ": Scratch buffers (" << arena.backing() << "): " << describe(arena.statistics()) << "." << std::endl;
+            if (HUGE_PAGES)
+            {
+                adviseHugePages(sharedMemory->data(), sharedMemory->size());
+                std::clog << argv[0] << ": Shared memory: " << describe(pageStatistics(sharedMemory->data(), sharedMemory->size())) << "." << std::endl;
+            }
+
+            // Every pixel of the crop zone is mapped to the ground once, so that cones are located in metres by a lookup.
+            CameraIntrinsics intrinsics{intrinsicsFromFieldOfView(WIDTH, HEIGHT, FOV)};
+            if ((0 != commandlineArguments.count("intrinsics")) && !parseIntrinsics(commandlineArguments["intrinsics"], intrinsics))
+            {
+                std::cerr << argv[0] << ": --intrinsics expects fx,fy,cx,cy in pixels." << std::endl;
+                return retCode;
+            }
+            const GroundProjection ground{intrinsics, roi, CAMERA_HEIGHT, CAMERA_PITCH};
+            // The detected cones are published once per frame; their directions are looked up per column and row.
+            const PerceptionObjects perceptionObjects{intrinsics, WIDTH, HEIGHT, ground};
+            std::unique_ptr<OD4SendBatch> objects{new OD4SendBatch};
+            CentrelinePlanner planner{WHEELBASE, LOOK_AHEAD, PREVIEW, 0.2f, 1.5f, static_cast<float>(MAX_ANGLE)};
+
+            // Pick the segmentation kernel for this frame geometry once.
+            const Segmenter segmenter{selectSegmenter(WIDTH, static_cast<uint32_t>(roi.height), 4, ISA)};
+            std::clog << argv[0] << ": Using segmenter " << segmenter.name << " (" << segmenter.isa << ")." << std::endl;
+            // Tiles that did not change keep their masks from the previous frames.
+            IncrementalSegmenter incremental{segmenter, roi};
+            // Packed masks are an eighth of the byte masks; their blobs are found per run of set bits.
+            BitMask blueBits{roi.width, roi.height}, yellowBits{roi.width, roi.height};
+            BlobFinder blobFinder{roi.width, roi.height};
+            BlobList blueBlobs, yellowBlobs;
+            // The projections are taken while segmenting; blobs are only traced if they are ambiguous.
+            ConeBandFinder blueBands{roi.width, roi.height}, yellowBands{roi.width, roi.height};
+            auto findBlobs = [&](const BitMask &bits, ConeBandFinder &bands, BlobList &blobs, int minimumArea) {
+                if (PROJECTIONS)
+                {
+                    bands.find(bits, blobs, minimumArea);
+                }
+                else
+                {
+                    blobFinder.find(bits, blobs, minimumArea);
+                }
+            };
+            if (BIT_MASKS && INCREMENTAL)
+            {
+                std::clog << argv[0] << ": --incremental is ignored with --bit-masks and --projections." << std::endl;
+            }
+            auto segment = [&](const cv::Mat &frame) {
+                if (BIT_MASKS)
+                {
+                    return segmenter.segmentBits(frame, roi, toColorRange(blueLow, blueHigh), toColorRange(yellowLow, yellowHigh), blueBits, yellowBits,
+                                                 PROJECTIONS ? blueBands.projections() : nullptr, PROJECTIONS ? yellowBands.projections() : nullptr);
+                }
+                return INCREMENTAL ? incremental.segment(frame, toColorRange(blueLow, blueHigh), toColorRange(yellowLow, yellowHigh), blueMask, yellowMask)
+                                   : segmenter.segment(frame, roi, toColorRange(blueLow, blueHigh), toColorRange(yellowLow, yellowHigh), blueMask, yellowMask);
+            };
+
+            // Only the rows that the segmentation reads are recorded: the crop zone and the border of the blur.
+            if (0 != commandlineArguments.count("record"))
+            {
+                const cv::Range rows{recordedRows(roi, static_cast<int>(HEIGHT))};
+                recorder.reset(new Recorder{commandlineArguments["record"], static_cast<int>(WIDTH), rows.start, rows.size(), recordCodec, RECORD_ENCODERS});
+                if (!recorder->valid())
+                {
+                    return retCode;
+                }
+                std::clog << argv[0] << ": Recording rows " << rows.start << " to " << rows.end << " of every frame into " << commandlineArguments["record"] << "." << std::endl;
+            }
 
             if (VERBOSE)
             {
@@ -360,29 +309,85 @@ int32_t main(int32_t argc, char **argv)
                 cv::createTrackbar("Val - high", "HSV Debugger", &vHigh, 255);
             }
 
-            // Endless loop; end the program by pressing Ctrl-C.
-            while (od4.isRunning())
-            {
-                // Wait for a notification of a new frame.
-                sharedMemory->wait();
-
+            // Called for every new frame in the shared memory.
+            auto onFrame = [&]() {
                 // Performance reading start
                 uint64_t startFrame = cv::getTickCount();
-
-                // Lock the shared memory.
-                sharedMemory->lock();
+                const int64_t frameStarted{cluon::time::toMicroseconds(cluon::time::now())};
+                uint64_t frameNumber{0};
+                int64_t frameCompleted{0};
+
+                MaskCounts maskCounts;
+                std::pair<bool, cluon::data::TimeStamp> timestampFromImage;
+                Recorder::Frame *snapshot{nullptr};
+                if (ring)
                 {
-                    // Copy the pixels from the shared memory into our own data structure.
-                    cv::Mat wrapped(HEIGHT, WIDTH, CV_8UC4, sharedMemory->data());
-                    cv::Mat cropWrapped(HEIGHT, WIDTH, CV_8UC1, sharedMemory->data());
-                    imgFrame = cropWrapped.clone();
-                    img = wrapped.clone();
+                    // Work on the newest slot in place; a frame that the producer started to overwrite meanwhile is dropped.
+                    FrameSlot slot;
+                    if (!ring->acquireLatest(slot) || (slot.frame == lastRingFrame))
+                    {
+                        return;
+                    }
+                    lastRingFrame = slot.frame;
+                    cv::Mat wrapped(HEIGHT, WIDTH, CV_8UC4, const_cast<char *>(slot.data));
+                    maskCounts = segment(wrapped);
+                    snapshot = recorder ? recorder->snapshot(wrapped) : nullptr;
+                    if (VERBOSE)
+                    {
+                        wrapped.copyTo(img);
+                    }
+                    if (!ring->stillValid(slot))
+                    {
+                        tornFrames++;
+                        if (nullptr != snapshot)
+                        {
+                            recorder->discard(snapshot);
+                        }
+                        // The masks and the references of the tiles may stem from different writes.
+                        incremental.invalidate();
+                        return;
+                    }
+                    timestampFromImage = std::make_pair(true, cluon::time::fromMicroseconds(slot.timeStamp));
+                    frameNumber = slot.frame;
+                    frameCompleted = slot.completed;
+                }
+                else
+                {
+                    // Lock the shared memory.
+                    sharedMemory->lock();
+                    // The producer publishes the metadata of a frame before unlocking it.
+                    if (sidecar.read(metadata))
+                    {
+                        if (!geometryMatches(metadata))
+                        {
+                            rejectedFrames++;
+                            sharedMemory->unlock();
+                            return;
+                        }
+                        frameNumber = metadata.frame;
+                        frameCompleted = metadata.completed;
+                    }
+                    {
+                        // Blur, convert BGR -> HSV and threshold both cone colors straight from the shared memory.
+                        cv::Mat wrapped(HEIGHT, WIDTH, CV_8UC4, sharedMemory->data());
+                        maskCounts = segment(wrapped);
+                        snapshot = recorder ? recorder->snapshot(wrapped) : nullptr;
+                        if (VERBOSE)
+                        {
+                            // Copy the pixels from the shared memory into our own data structure.
+                            wrapped.copyTo(img);
+                        }
+                    }
+                    // TODO: Here, you can add some code to check the sampleTimePoint when the current frame was captured.
+                    timestampFromImage = sharedMemory->getTimeStamp();
+                    sharedMemory->unlock();
+                }
+                if (nullptr != snapshot)
+                {
+                    recorder->commit(snapshot, cluon::time::toMicroseconds(timestampFromImage.second));
                 }
-                // TODO: Here, you can add some code to check the sampleTimePoint when the current frame was captured.
-                std::pair<bool, cluon::data::TimeStamp> timestampFromImage = sharedMemory->getTimeStamp();
                 std::string timestamp = std::to_string(cluon::time::toMicroseconds(timestampFromImage.second));
                 std::cout << "Group 1;" << timestamp << ";" << steeringAngle << std::endl; 
-                sharedMemory->unlock();
 
                 cluon::data::TimeStamp ts = cluon::time::now();
                 uint32_t seconds = ts.seconds();
@@ -427,24 +432,96 @@ int32_t main(int32_t argc, char **argv)
                 // Cropped image frame
                 frameCropped = img(roi);
 
-                // Blur the input stream
-                cv::blur(frameCropped, imgBlur, cv::Size(7, 7));
-
-                // Convert BGR -> HSV
-                cv::cvtColor(imgBlur, imgHSV, cv::COLOR_BGR2HSV);
+                // The HSV image is only needed for the debug window
+                if (VERBOSE)
+                {
+                    cv::blur(frameCropped, imgBlur, cv::Size(BLUR_KERNEL_SIZE, BLUR_KERNEL_SIZE));
+                    cv::cvtColor(imgBlur, imgHSV, cv::COLOR_BGR2HSV);
+                }
 
                 // ----> Call 2x method here <-----
-                cv::inRange(imgHSV, blueLow, blueHigh, frameHSV);
-                getBlueCones(frameHSV, frameCropped, cv::Scalar(255, 0, 0));
-
-                cv::inRange(imgHSV, yellowLow, yellowHigh, frameHSV);
-                getYellowCones(frameHSV, frameCropped, cv::Scalar(0, 255, 255));
+                // Empty masks contain no contours; skip the search.
+                if ((0 != maskCounts.blue) && BIT_MASKS)
+                {
+                    findBlobs(blueBits, blueBands, blueBlobs, MIN_BLUE_CONE_AREA);
+                    getBlueCones(blueBlobs, VERBOSE ? frameCropped : cv::Mat(), cv::Scalar(255, 0, 0));
+                }
+                else if (0 != maskCounts.blue)
+                {
+                    getBlueCones(blueMask, frameCropped, cv::Scalar(255, 0, 0));
+                }
+                else
+                {
+                    blueContours.clear();
+                    blueConeList.count = 0;
+                    blueInFrame = false;
+                }
+                if ((0 != maskCounts.yellow) && BIT_MASKS)
+                {
+                    findBlobs(yellowBits, yellowBands, yellowBlobs, MIN_YELLOW_CONE_AREA);
+                    getYellowCones(yellowBlobs, VERBOSE ? frameCropped : cv::Mat(), cv::Scalar(0, 255, 255));
+                }
+                else if (0 != maskCounts.yellow)
+                {
+                    getYellowCones(yellowMask, frameCropped, cv::Scalar(0, 255, 255));
+                }
+                else
+                {
+                    yellowContours.clear();
+                    yellowConeList.count = 0;
+                    yellowInFrame = false;
+                }
                 // ----> Call 2x method here <-----
 
-                trackCones();
+                const int64_t sampled{cluon::time::toMicroseconds(timestampFromImage.second)};
+                const PlannedPath *path{PLANNER ? &planner.plan(ground, blueConeList, yellowConeList) : nullptr};
+                if ((nullptr != path) && path->valid)
+                {
+                    steeringAngle = path->steeringAngle;
+                    blueConePrev = blueCone;
+                    yellowConePrev = yellowCone;
+                    steeringAccuracy();
+
+                    opendlv::logic::action::AimPoint aimPoint;
+                    aimPoint.azimuthAngle(path->aim.bearing).zenithAngle(0.0f).distance(path->aim.distance);
+                    opendlv::logic::action::PreviewPoint previewPoint;
+                    previewPoint.azimuthAngle(path->preview.bearing).zenithAngle(0.0f).distance(path->preview.distance);
+                    objects->add(aimPoint, sampled);
+                    objects->add(previewPoint, sampled);
+                }
+                else
+                {
+                    // Without a path, e.g. before the sides of the colours are known, steer towards single cones.
+                    trackCones();
+                }
+                if (recorder)
+                {
+                    recorder->addSteering(static_cast<float>(steeringAngle), sampled);
+                }
+
+                // All cones of the frame leave with one system call.
+                if (0 < (blueConeList.count + yellowConeList.count))
+                {
+                    const uint32_t nextObjectId{perceptionObjects.add(*objects, blueConeList, OBJECT_TYPE_BLUE_CONE, roi.tl(), 0, sampled)};
+                    perceptionObjects.add(*objects, yellowConeList, OBJECT_TYPE_YELLOW_CONE, roi.tl(), nextObjectId, sampled);
+                }
+                if (od4 && (0 < objects->count()))
+                {
+                    od4->send(*objects);
+                }
 
                 // Performance reading end
                 uint64_t endFrame = cv::getTickCount();
+                if (0 < frameNumber)
+                {
+                    const int64_t frameFinished{cluon::time::toMicroseconds(cluon::time::now())};
+                    frameStatistics.add(frameNumber, frameCompleted, frameStarted, frameFinished);
+                    if (VERBOSE)
+                    {
+                        std::clog << "Frame " << frameNumber << ": " << (frameStarted - frameCompleted) << " us until processing, "
+                                  << (frameFinished - frameCompleted) << " us until steering; " << frameStatistics.dropped() << " dropped so far." << std::endl;
+                    }
+                }
                 std::string calcSpeed = std::to_string(((endFrame - startFrame) / cv::getTickFrequency()) * 1000);
 
                 // Average correct values converted to string
@@ -485,6 +562,118 @@ int32_t main(int32_t argc, char **argv)
                     // cv::imshow("Image Crop - Debug", frameCropped);
                     cv::waitKey(1);
                 }
+            };
+
+            // Wait for notifications of new frames; frames replaced before they were processed are skipped.
+            // Producers that publish a generation counter next to the frame wake us through a futex instead.
+            FrameSignal frameSignal{NAME, false};
+            if (frameSignal.valid())
+            {
+                std::clog << argv[0] << ": Waiting for frames on '" << frameSignal.name() << "'." << std::endl;
+            }
+            FrameNotifier frames{*sharedMemory, &frameSignal};
+            loop.addReadable(frames.fd(), [&frames, &onFrame]() {
+                if (0 < frames.acknowledge())
+                {
+                    onFrame();
+                }
+            });
+
+            // Endless loop; end the program by pressing Ctrl-C.
+            loop.addTimer(std::chrono::milliseconds(100), [&od4, &loop](uint64_t) {
+                if (od4 && !od4->isRunning())
+                {
+                    loop.stop();
+                }
+            });
+            if (REPLAY.empty())
+            {
+                loop.run();
+            }
+            else
+            {
+                // Feed the recording in the order it was consumed through the same paths as live frames and messages.
+                Recording recording{REPLAY};
+                if (!recording.valid())
+                {
+                    std::cerr << argv[0] << ": " << REPLAY << " contains no Envelopes." << std::endl;
+                    return retCode;
+                }
+                uint64_t replayedFrames{0}, comparedAngles{0}, differingAngles{0};
+                cv::Mat replayFrame(HEIGHT, WIDTH, CV_8UC4, sharedMemory->data());
+                ReplayDecoder decoder{recording, recordedOrder(recording), static_cast<int>(WIDTH), static_cast<int>(HEIGHT), REPLAY_WORKERS};
+                for (const ReplayDecoder::Item *item = decoder.next(); nullptr != item; item = decoder.next())
+                {
+                    const EnvelopeView &env{item->envelope};
+                    if (item->frame)
+                    {
+                        if (item->decoded)
+                        {
+                            sharedMemory->lock();
+                            for (int y = item->decodedRows.y; y < item->decodedRows.y + item->decodedRows.height; y++)
+                            {
+                                std::memcpy(replayFrame.ptr<uint8_t>(y), item->image.ptr<uint8_t>(y), static_cast<size_t>(WIDTH) * 4);
+                            }
+                            sharedMemory->setTimeStamp(cluon::time::fromMicroseconds(env.sampleTimeStamp));
+                            sharedMemory->unlock();
+                            onFrame();
+                            replayedFrames++;
+                        }
+                    }
+                    else if ((opendlv::proxy::GroundSteeringRequest::ID() == env.dataType) && (RECORDED_STEERING_SENDER_STAMP == env.senderStamp))
+                    {
+                        // Steering angle computed when the frame before was recorded.
+                        opendlv::proxy::GroundSteeringRequest recorded;
+                        if (decodeMessage(env, recorded))
+                        {
+                            // A bit-exact replay computes the very same float.
+                            const float recordedAngle{recorded.groundSteering()};
+                            const float replayedAngle{static_cast<float>(steeringAngle)};
+                            uint32_t recordedBits, replayedBits;
+                            std::memcpy(&recordedBits, &recordedAngle, sizeof(recordedBits));
+                            std::memcpy(&replayedBits, &replayedAngle, sizeof(replayedBits));
+                            comparedAngles++;
+                            differingAngles += (recordedBits != replayedBits) ? 1 : 0;
+                        }
+                    }
+                    else if (opendlv::proxy::GroundSteeringRequest::ID() == env.dataType)
+                    {
+                        onGroundSteeringRequest(env);
+                    }
+                }
+                std::clog << argv[0] << ": Frames were decoded on " << decoder.workers() << " threads; the replay waited for " << decoder.stalls() << " of them." << std::endl;
+                std::clog << argv[0] << ": Replayed " << replayedFrames << " frames; " << differingAngles << " of " << comparedAngles
+                          << " steering angles differ from the recording." << std::endl;
+            }
+            if (INCREMENTAL && !BIT_MASKS)
+            {
+                std::clog << argv[0] << ": " << (incremental.skippedFraction() * 100.0) << "% of " << incremental.tiles() << " tiles were not segmented again." << std::endl;
+            }
+            if (PROJECTIONS)
+            {
+                std::clog << argv[0] << ": Blobs were traced for " << (blueBands.fallbacks() + yellowBands.fallbacks()) << " of "
+                          << (blueBands.masks() + yellowBands.masks()) << " masks with ambiguous projections." << std::endl;
+            }
+            if (ring)
+            {
+                std::clog << argv[0] << ": " << tornFrames << " frames were overwritten while being processed." << std::endl;
+            }
+            if (recorder)
+            {
+                std::clog << argv[0] << ": " << recorder->droppedFrames() << " frames and " << recorder->droppedEnvelopes()
+                          << " messages were not recorded because the recorder fell behind; " << (recorder->frameBytes() >> 20)
+                          << " MiB of compressed frames were written." << std::endl;
+            }
+            if (0 < frameStatistics.processed())
+            {
+                std::clog << argv[0] << ": " << frameStatistics.processed() << " frames processed, " << frameStatistics.dropped() << " dropped, "
+                          << rejectedFrames << " rejected for their geometry; latency from the producer " << frameStatistics.meanWakeUpLatency()
+                          << " us (max " << frameStatistics.maxWakeUpLatency() << " us) until processing, " << frameStatistics.meanTotalLatency()
+                          << " us (max " << frameStatistics.maxTotalLatency() << " us) until steering." << std::endl;
+            }
+            else
+            {
+                std::clog << argv[0] << ": " << frames.missed() << " frame notifications were missed." << std::endl;
             }
         }
         retCode = 0;
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "udp-batch-receiver.hpp"
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+namespace {
+
+// Largest UDP payload over IPv4.
+constexpr size_t SLOT_SIZE{65507};
+
+// Room for one SCM_TIMESTAMPNS control message per datagram.
+constexpr size_t CONTROL_SIZE{CMSG_SPACE(sizeof(struct timespec))};
+
+int64_t realtimeNow()
+{
+    struct timespec now {};
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000 * 1000 * 1000 + now.tv_nsec;
+}
+
+} // namespace
+
+UDPBatchReceiver::UDPBatchReceiver(const std::string &address, uint16_t port, Delegate delegate, uint16_t localSendFromPort,
+                                   uint32_t batchSize, std::chrono::microseconds coalescing, bool ownThread)
+    : m_localSendFromPort{localSendFromPort}
+    , m_delegate{std::move(delegate)}
+    , m_batchSize{std::max<uint32_t>(batchSize, 1)}
+    , m_coalescing{coalescing}
+{
+    struct sockaddr_in receiveFromAddress {};
+    receiveFromAddress.sin_family = AF_INET;
+    receiveFromAddress.sin_port = htons(port);
+    if ((0 == port) || (1 != ::inet_pton(AF_INET, address.c_str(), &receiveFromAddress.sin_addr))) {
+        std::cerr << "[UDPBatchReceiver] Invalid address " << address << ":" << port << std::endl;
+        return;
+    }
+    const uint32_t firstOctet{ntohl(receiveFromAddress.sin_addr.s_addr) >> 24};
+    const uint32_t lastOctet{ntohl(receiveFromAddress.sin_addr.s_addr) & 0xFF};
+    m_isMulticast = (224 < firstOctet) && (firstOctet <= 239) && (1 <= lastOctet);
+
+    m_socket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket < 0) {
+        closeSocket(errno);
+        return;
+    }
+
+    // Allow reusing of ports by multiple receivers with same address/port.
+    int yes{1};
+    if (0 > ::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))) {
+        closeSocket(errno);
+        return;
+    }
+    // Kernel time stamps are delivered as control messages with every datagram.
+    if (0 > ::setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMPNS, &yes, sizeof(yes))) {
+        std::cerr << "[UDPBatchReceiver] SO_TIMESTAMPNS not available; using the time of reception instead." << std::endl;
+    }
+    int recvBuffer{26214400};
+    if (0 > ::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &recvBuffer, sizeof(recvBuffer))) {
+        std::cerr << "[UDPBatchReceiver] Error while trying to set SO_RCVBUF to " << recvBuffer << ": " << ::strerror(errno) << std::endl;
+    }
+    // recvmmsg() blocks until the first datagram arrives; the timeout lets the thread check for shutdown with 50Hz.
+    struct timeval timeout {};
+    timeout.tv_usec = 20 * 1000;
+    if (0 > ::setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) {
+        closeSocket(errno);
+        return;
+    }
+    if (0 > ::bind(m_socket, reinterpret_cast<struct sockaddr *>(&receiveFromAddress), sizeof(receiveFromAddress))) {
+        closeSocket(errno);
+        return;
+    }
+    if (m_isMulticast) {
+        m_mreq.imr_multiaddr = receiveFromAddress.sin_addr;
+        m_mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (0 > ::setsockopt(m_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &m_mreq, sizeof(m_mreq))) {
+            closeSocket(errno);
+            return;
+        }
+    }
+    collectLocalAddresses();
+
+    m_slots.resize(m_batchSize * SLOT_SIZE);
+    m_messages.resize(m_batchSize);
+    m_iovecs.resize(m_batchSize);
+    m_addresses.resize(m_batchSize);
+    m_controls.resize(m_batchSize * CONTROL_SIZE);
+
+    resetSlots(m_batchSize);
+    m_readFromSocketThreadRunning.store(true);
+    if (ownThread) {
+        m_readFromSocketThread = std::thread(&UDPBatchReceiver::readFromSocket, this);
+    }
+}
+
+UDPBatchReceiver::~UDPBatchReceiver()
+{
+    m_readFromSocketThreadRunning.store(false);
+    if (m_readFromSocketThread.joinable()) {
+        m_readFromSocketThread.join();
+    }
+    closeSocket(0);
+}
+
+bool UDPBatchReceiver::isRunning() const
+{
+    return m_readFromSocketThreadRunning.load();
+}
+
+int UDPBatchReceiver::socket() const
+{
+    return m_socket;
+}
+
+void UDPBatchReceiver::receive()
+{
+    // Level-triggered event loops call again if more datagrams arrive
+    // meanwhile, so a partial batch ends the call.
+    int64_t lastReceived{0};
+    while (m_readFromSocketThreadRunning.load() && (static_cast<uint32_t>(receiveBatch(MSG_DONTWAIT, lastReceived)) == m_batchSize)) {}
+}
+
+UDPReceiveStatistics UDPBatchReceiver::statistics() const
+{
+    UDPReceiveStatistics retVal;
+    retVal.datagrams = m_datagrams.load(std::memory_order_relaxed);
+    retVal.batches = m_batches.load(std::memory_order_relaxed);
+    retVal.syscalls = m_syscalls.load(std::memory_order_relaxed);
+    return retVal;
+}
+
+void UDPBatchReceiver::closeSocket(int errorCode)
+{
+    if (0 != errorCode) {
+        std::cerr << "[UDPBatchReceiver] Failed to perform socket operation: " << ::strerror(errorCode) << " (" << errorCode << ")" << std::endl;
+    }
+    if (!(m_socket < 0)) {
+        if (m_isMulticast) {
+            ::setsockopt(m_socket, IPPROTO_IP, IP_DROP_MEMBERSHIP, &m_mreq, sizeof(m_mreq));
+        }
+        ::shutdown(m_socket, SHUT_RDWR);
+        ::close(m_socket);
+    }
+    m_socket = -1;
+}
+
+void UDPBatchReceiver::collectLocalAddresses()
+{
+    // Datagrams from these addresses and m_localSendFromPort were sent by ourselves.
+    struct ifaddrs *interfaceAddress{nullptr};
+    if (0 == ::getifaddrs(&interfaceAddress)) {
+        for (struct ifaddrs *it = interfaceAddress; nullptr != it; it = it->ifa_next) {
+            if ((nullptr != it->ifa_addr) && (AF_INET == it->ifa_addr->sa_family)) {
+                m_localAddresses.push_back(reinterpret_cast<struct sockaddr_in *>(it->ifa_addr)->sin_addr.s_addr);
+            }
+        }
+        ::freeifaddrs(interfaceAddress);
+    }
+}
+
+void UDPBatchReceiver::resetSlots(uint32_t count)
+{
+    // recvmmsg() overwrites the lengths and flags of the messages it filled.
+    for (uint32_t i = 0; i < count; i++) {
+        m_iovecs[i].iov_base = m_slots.data() + i * SLOT_SIZE;
+        m_iovecs[i].iov_len = SLOT_SIZE;
+        struct msghdr &header = m_messages[i].msg_hdr;
+        header.msg_name = &m_addresses[i];
+        header.msg_namelen = sizeof(struct sockaddr_in);
+        header.msg_iov = &m_iovecs[i];
+        header.msg_iovlen = 1;
+        header.msg_control = m_controls.data() + i * CONTROL_SIZE;
+        header.msg_controllen = CONTROL_SIZE;
+        header.msg_flags = 0;
+        m_messages[i].msg_len = 0;
+    }
+}
+
+void UDPBatchReceiver::readFromSocket()
+{
+    bool wait{true};
+    int64_t lastReceived{0};
+    while (m_readFromSocketThreadRunning.load()) {
+        const int64_t previousReceived{lastReceived};
+        const int received{receiveBatch(wait ? MSG_WAITFORONE : MSG_DONTWAIT, lastReceived)};
+
+        // A full batch means that more datagrams are queued. Otherwise, when the
+        // datagrams arrive closer together than the coalescing window (i.e. a
+        // burst is in progress), the rest of the burst gets the window to arrive
+        // before it is collected without blocking.
+        const bool burst{(1 < received) || ((lastReceived - previousReceived) < m_coalescing.count() * 1000)};
+        if (0 >= received) {
+            wait = true;
+        } else if (static_cast<uint32_t>(received) == m_batchSize) {
+            wait = false;
+        } else if ((0 < m_coalescing.count()) && burst) {
+            std::this_thread::sleep_for(m_coalescing);
+            wait = false;
+        } else {
+            wait = true;
+        }
+    }
+}
+
+int UDPBatchReceiver::receiveBatch(int flags, int64_t &lastReceived)
+{
+    const int received = ::recvmmsg(m_socket, m_messages.data(), m_batchSize, flags, nullptr);
+    m_syscalls.fetch_add(1, std::memory_order_relaxed);
+    if (0 >= received) {
+        if ((0 > received) && (EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno)) {
+            std::cerr << "[UDPBatchReceiver] recvmmsg failed: " << ::strerror(errno) << std::endl;
+            m_readFromSocketThreadRunning.store(false);
+        }
+        return 0;
+    }
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t fallbackTimeStamp{0};
+    for (int i = 0; i < received; i++) {
+        struct msghdr &header = m_messages[i].msg_hdr;
+        UDPDatagram datagram;
+        datagram.data = static_cast<const char *>(m_iovecs[i].iov_base);
+        datagram.size = m_messages[i].msg_len;
+        datagram.fromAddress = m_addresses[i].sin_addr.s_addr;
+        datagram.fromPort = ntohs(m_addresses[i].sin_port);
+
+        const bool sentFromUs = (0 != m_localSendFromPort) && (m_localSendFromPort == datagram.fromPort) &&
+                                (m_localAddresses.end() != std::find(m_localAddresses.begin(), m_localAddresses.end(), datagram.fromAddress));
+        if (sentFromUs || (0 == datagram.size) || (0 != (header.msg_flags & MSG_TRUNC))) {
+            continue;
+        }
+
+        for (struct cmsghdr *control = CMSG_FIRSTHDR(&header); nullptr != control;
+             control = CMSG_NXTHDR(&header, control)) {
+            if ((SOL_SOCKET == control->cmsg_level) && (SCM_TIMESTAMPNS == control->cmsg_type)) {
+                struct timespec timeStamp {};
+                std::memcpy(&timeStamp, CMSG_DATA(control), sizeof(timeStamp));
+                datagram.received = static_cast<int64_t>(timeStamp.tv_sec) * 1000 * 1000 * 1000 + timeStamp.tv_nsec;
+            }
+        }
+        if (0 == datagram.received) {
+            // Without kernel time stamps, all datagrams of a batch share the time of reception.
+            fallbackTimeStamp = (0 == fallbackTimeStamp) ? realtimeNow() : fallbackTimeStamp;
+            datagram.received = fallbackTimeStamp;
+        }
+
+        lastReceived = datagram.received;
+        m_datagrams.fetch_add(1, std::memory_order_relaxed);
+        if (nullptr != m_delegate) {
+            m_delegate(datagram);
+        }
+    }
+    resetSlots(static_cast<uint32_t>(received));
+    return received;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UDP_BATCH_RECEIVER_HPP
+#define UDP_BATCH_RECEIVER_HPP
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Received datagram; data points into a slot of the receiver and is only
+ * valid during the call of the delegate.
+ */
+struct UDPDatagram {
+    const char *data{nullptr};
+    size_t size{0};
+    int64_t received{0};    // Kernel receive time stamp in nanoseconds since the epoch.
+    uint32_t fromAddress{0};    // IPv4 address in network byte order.
+    uint16_t fromPort{0};
+};
+
+// Counters of a UDPBatchReceiver.
+struct UDPReceiveStatistics {
+    uint64_t datagrams{0};
+    uint64_t batches{0};     // recvmmsg calls that returned datagrams.
+    uint64_t syscalls{0};    // All recvmmsg calls including the ones that timed out or found nothing.
+};
+
+/**
+ * UDP receiver for Linux like cluon::UDPReceiver (unicast or multicast in
+ * [225.0.0.1, 239.255.255.255]), which waits in select() and then calls
+ * recvfrom() and ioctl(SIOCGSTAMP) per datagram and copies every datagram
+ * into a std::string for a NotifyingPipeline. This receiver pulls up to
+ * batchSize datagrams per recvmmsg() call into preallocated slots that are
+ * reused for every batch, takes the receive time stamps from the kernel
+ * (SO_TIMESTAMPNS) and calls the delegate for each datagram directly on its
+ * receiving thread, so the delegate must be quick.
+ *
+ * The receiving thread is fast enough to wake up for almost every datagram
+ * of a burst. While datagrams arrive closer together than a coalescing
+ * window, it therefore sleeps for the window after a partial batch and then
+ * collects whatever arrived meanwhile without blocking; this trades up to one
+ * window of latency for the rest of a burst against one wake-up per window.
+ * Isolated datagrams are still delivered as soon as they arrive.
+ *
+ * Without an own thread, the receiver leaves the waiting to an event loop
+ * (event-loop.hpp): it polls socket() and calls receive() when the socket
+ * is readable, which collects all queued datagrams without blocking and
+ * calls the delegate on the thread of the event loop.
+ */
+class UDPBatchReceiver {
+   private:
+    UDPBatchReceiver(const UDPBatchReceiver &) = delete;
+    UDPBatchReceiver(UDPBatchReceiver &&) = delete;
+    UDPBatchReceiver &operator=(const UDPBatchReceiver &) = delete;
+    UDPBatchReceiver &operator=(UDPBatchReceiver &&) = delete;
+
+   public:
+    typedef std::function<void(const UDPDatagram &datagram)> Delegate;
+
+    /**
+     * @param address Address to receive from.
+     * @param port Port to receive from.
+     * @param delegate Function to call for every datagram.
+     * @param localSendFromPort Port of a local sender whose datagrams are ignored (0 = none).
+     * @param batchSize Maximum number of datagrams per recvmmsg() call.
+     * @param coalescing Time to let a burst arrive after a partial batch (0 = wait for every datagram); only with an own thread.
+     * @param ownThread false to receive from an event loop through socket() and receive() instead.
+     */
+    UDPBatchReceiver(const std::string &address, uint16_t port, Delegate delegate, uint16_t localSendFromPort = 0,
+                     uint32_t batchSize = 32, std::chrono::microseconds coalescing = std::chrono::microseconds(0), bool ownThread = true);
+    ~UDPBatchReceiver();
+
+    bool isRunning() const;
+
+    // File descriptor to poll for readability when the receiver has no own thread.
+    int socket() const;
+
+    // Calls the delegate for all queued datagrams without blocking.
+    void receive();
+
+    UDPReceiveStatistics statistics() const;
+
+   private:
+    void closeSocket(int errorCode);
+    void resetSlots(uint32_t count);
+    void readFromSocket();
+    int receiveBatch(int flags, int64_t &lastReceived);
+    void collectLocalAddresses();
+
+   private:
+    int m_socket{-1};
+    bool m_isMulticast{false};
+    struct ip_mreq m_mreq {};
+    uint16_t m_localSendFromPort{0};
+    std::vector<uint32_t> m_localAddresses{};
+    Delegate m_delegate{nullptr};
+
+    // Slots, message headers and control buffers for recvmmsg(); allocated once.
+    uint32_t m_batchSize{0};
+    std::chrono::microseconds m_coalescing{0};
+    std::vector<char> m_slots{};
+    std::vector<struct mmsghdr> m_messages{};
+    std::vector<struct iovec> m_iovecs{};
+    std::vector<struct sockaddr_in> m_addresses{};
+    std::vector<char> m_controls{};
+
+    std::atomic<uint64_t> m_datagrams{0};
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_syscalls{0};
+
+    std::atomic<bool> m_readFromSocketThreadRunning{false};
+    std::thread m_readFromSocketThread{};
+};
+
+#endif